@@ -1058,8 +1058,11 @@ static int test_logic(struct test_state* tstate, int y, int x, int type_idx,
 {
 	struct fpga_device* dev;
 	net_idx_t pinw_nets[MAX_NUM_PINW];
-	int i, lut, latch_logic, rc;
+	int i, lut, latch_logic, savepoint, rc;
 
+	// the journal takes the device and nets away again
+	rc = fpga_journal_begin(tstate->model, &savepoint);
+	if (rc) FAIL(rc);
 	rc = fdev_logic_setconf(tstate->model, y, x, type_idx, logic_cfg);
 	if (rc) FAIL(rc);
 	if (tstate->dry_run) {
@@ -1131,9 +1134,8 @@ static int test_logic(struct test_state* tstate, int y, int x, int type_idx,
 
 	if ((rc = diff_printf(tstate))) FAIL(rc);
 
-	for (i = 0; i < dev->pinw_req_total; i++)
-		fnet_delete(tstate->model, pinw_nets[i]);
-	fdev_delete(tstate->model, y, x, DEV_LOGIC, type_idx);
+	rc = fpga_journal_rollback(tstate->model, savepoint);
+	if (rc) FAIL(rc);
 	return 0;
 fail:
 	return rc;
@@ -2192,8 +2194,10 @@ static void printf_help(const char* argv_0, const char** available_tests)
 		"\n"
 		"Usage: %s [--test=<name>] [--skip=<num>] [--count=<num>]\n"
 		"       %*s [--dry-run] [--diff=<diff executable>]\n"
+		"       %*s [--build-threads=<num>]\n"
 		"Default diff executable: " DEFAULT_DIFF_EXEC "\n"
-		"Output dir: " AUTOTEST_TMP_DIR "\n", argv_0, (int) strlen(argv_0), "");
+		"Output dir: " AUTOTEST_TMP_DIR "\n", argv_0, (int) strlen(argv_0), "",
+		(int) strlen(argv_0), "");
 
 	if (available_tests) {
 		int i = 0;
@@ -2212,7 +2216,7 @@ int main(int argc, char** argv)
 	struct fpga_model model;
 	struct test_state tstate;
 	char param[1024], cmdline_test[1024];
-	int i, param_skip, param_count, rc;
+	int i, param_skip, param_count, param_build_threads, rc;
 	const char* available_tests[] =
 		{ "logic_cfg", "routing_sw", "io_sw", "iob_cfg",
 		  "lut_encoding", "bufg_cfg", "bufio_cfg", "pll_cfg",
@@ -2278,6 +2282,10 @@ int main(int argc, char** argv)
 			tstate.dry_run = 1;
 			continue;
 		}
+		if (sscanf(argv[i], "--build-threads=%i", &param_build_threads) == 1) {
+			fpga_set_build_threads(param_build_threads);
+			continue;
+		}
 		printf_help(argv[0], available_tests);
 		return EINVAL;
 	}
@@ -0,0 +1,812 @@
+//
+// Author: Wolfgang Spraul
+//
+// This is free and unencumbered software released into the public domain.
+// For details see the UNLICENSE file at the root of the source tree.
+//
+
+#include <time.h>
+#include <unistd.h>
+#include "model.h"
+#include "control.h"
+#include "bit.h"
+#include "rr_graph.h"
+#include "router.h"
+#include "lookahead.h"
+
+#define NUM_LOOKUPS	200000
+#define NUM_ENUMS	20000
+#define NUM_MULTI_LOOKUPS	5000
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double time_build(struct fpga_model* model, int idcode,
+	enum xc6_pkg pkg)
+{
+	double start = now();
+
+	if (fpga_build_model(model, idcode, pkg)) {
+		fprintf(stderr, "#E %s:%i model build failed\n",
+			__FILE__, __LINE__);
+		exit(1);
+	}
+	return now() - start;
+}
+
+// Looks up NUM_LOOKUPS switches spread over all tiles and returns
+// the time taken. Fails if a switch cannot be found again.
+static double time_switch_lookup(struct fpga_model* model)
+{
+	struct fpga_tile* tile;
+	int y, x, i, sw_i, num_done;
+	str16_t from_i, to_i;
+	double start;
+
+	start = now();
+	num_done = 0;
+	while (num_done < NUM_LOOKUPS) {
+		for (y = 0; y < model->y_height; y++) {
+			for (x = 0; x < model->x_width; x++) {
+				tile = YX_TILE(model, y, x);
+				if (!tile->num_switches)
+					continue;
+				sw_i = (y*model->x_width + x + num_done) % tile->num_switches;
+				from_i = tile->conn_point_names[SW_FROM_I(tile->switches[sw_i])*2+1];
+				to_i = tile->conn_point_names[SW_TO_I(tile->switches[sw_i])*2+1];
+				i = fpga_switch_lookup(model, y, x, from_i, to_i);
+				if (i == NO_SWITCH
+				    || (tile->switches[i] & ~SWITCH_USED)
+				         != (tile->switches[sw_i] & ~SWITCH_USED)) {
+					fprintf(stderr, "#E %s:%i y%i x%i sw %i found %i\n",
+						__FILE__, __LINE__, y, x, sw_i, i);
+					exit(1);
+				}
+				if (++num_done >= NUM_LOOKUPS)
+					break;
+			}
+			if (num_done >= NUM_LOOKUPS)
+				break;
+		}
+	}
+	return now() - start;
+}
+
+// Looks up NUM_LOOKUPS switches in random tile order, once with
+// fpga_switch_lookup() and once with fpga_switch_lookup_batch().
+static void time_batch_lookup(struct fpga_model* model, double* single,
+	double* batch)
+{
+	struct fpga_tile* tile;
+	struct sw_query* q;
+	int y, x, i, sw_i;
+	double start;
+
+	q = malloc(NUM_LOOKUPS * sizeof(*q));
+	if (!q) {
+		fprintf(stderr, "#E %s:%i out of memory\n", __FILE__, __LINE__);
+		exit(1);
+	}
+	srand(1);
+	i = 0;
+	while (i < NUM_LOOKUPS) {
+		y = rand() % model->y_height;
+		x = rand() % model->x_width;
+		tile = YX_TILE(model, y, x);
+		if (!tile->num_switches)
+			continue;
+		sw_i = rand() % tile->num_switches;
+		q[i].y = y;
+		q[i].x = x;
+		q[i].from = tile->conn_point_names[SW_FROM_I(tile->switches[sw_i])*2+1];
+		q[i].to = tile->conn_point_names[SW_TO_I(tile->switches[sw_i])*2+1];
+		i++;
+	}
+	start = now();
+	for (i = 0; i < NUM_LOOKUPS; i++)
+		fpga_switch_lookup(model, q[i].y, q[i].x, q[i].from, q[i].to);
+	*single = now() - start;
+
+	start = now();
+	fpga_switch_lookup_batch(model, q, NUM_LOOKUPS);
+	*batch = now() - start;
+	for (i = 0; i < NUM_LOOKUPS; i++) {
+		sw_i = fpga_switch_lookup(model, q[i].y, q[i].x,
+			q[i].from, q[i].to);
+		if (q[i].sw != sw_i) {
+			fprintf(stderr, "#E %s:%i batch lookup %i differs\n",
+				__FILE__, __LINE__, i);
+			exit(1);
+		}
+	}
+	free(q);
+}
+
+// Looks up NUM_MULTI_LOOKUPS chains of up to 3 switches, from the
+// from connpt of one switch to the to connpt of another in the same
+// tile, in all tiles with a switchbox.
+static double time_multi_lookup(struct fpga_model* model)
+{
+	struct fpga_tile* tile;
+	struct sw_set set;
+	int y, x, sw_i, num_done;
+	str16_t from_i, to_i;
+	double start;
+
+	start = now();
+	num_done = 0;
+	while (num_done < NUM_MULTI_LOOKUPS) {
+		for (y = 0; y < model->y_height; y++) {
+			for (x = 0; x < model->x_width; x++) {
+				tile = YX_TILE(model, y, x);
+				if (tile->num_switches < 1000)
+					continue;
+				sw_i = (num_done*7) % tile->num_switches;
+				from_i = tile->conn_point_names[SW_FROM_I(tile->switches[sw_i])*2+1];
+				sw_i = (sw_i*13 + 1) % tile->num_switches;
+				to_i = tile->conn_point_names[SW_TO_I(tile->switches[sw_i])*2+1];
+				fpga_multi_switch_lookup(model, y, x, from_i, to_i,
+					/*max_depth*/ 3, NO_NET, &set);
+				if (++num_done >= NUM_MULTI_LOOKUPS)
+					break;
+			}
+			if (num_done >= NUM_MULTI_LOOKUPS)
+				break;
+		}
+	}
+	return now() - start;
+}
+
+// Enumerates the switches from and to NUM_ENUMS connpts spread over
+// all tiles with fpga_switch_first() and fpga_switch_next(), and
+// returns the time taken.
+static double time_switch_enum(struct fpga_model* model)
+{
+	struct fpga_tile* tile;
+	int y, x, connpt_o, from_to, num_done;
+	swidx_t sw;
+	double start;
+
+	start = now();
+	num_done = 0;
+	while (num_done < NUM_ENUMS) {
+		for (y = 0; y < model->y_height; y++) {
+			for (x = 0; x < model->x_width; x++) {
+				tile = YX_TILE(model, y, x);
+				if (!tile->num_switches)
+					continue;
+				connpt_o = (y*model->x_width + x + num_done) % tile->num_conn_point_names;
+				for (from_to = 0; from_to < 2; from_to++) {
+					sw = fpga_switch_first(model, y, x,
+						tile->conn_point_names[connpt_o*2+1], from_to);
+					while (sw != NO_SWITCH)
+						sw = fpga_switch_next(model, y, x, sw, from_to);
+				}
+				if (++num_done >= NUM_ENUMS)
+					break;
+			}
+			if (num_done >= NUM_ENUMS)
+				break;
+		}
+	}
+	return now() - start;
+}
+
+//
+// The bin based string array fpgatools used before the open-addressing
+// one in helper.c, kept here to compare the two. Each bin is a stream
+// of uint32_t index, uint16_t entry len and zero-terminated string.
+//
+
+#define BIN_STR_HEADER	(4+2)
+#define BIN_INCREMENT	32768
+
+struct bin_strarray
+{
+	int highest_index;
+	uint32_t* bin_offsets;
+	uint16_t* index_to_bin;
+	char** bin_strings;
+	int* bin_len;
+	int num_bins;
+};
+
+static void bin_init(struct bin_strarray* array, int highest_index)
+{
+	array->highest_index = highest_index;
+	array->num_bins = highest_index / 64;
+	array->bin_strings = calloc(array->num_bins, sizeof(*array->bin_strings));
+	array->bin_len = calloc(array->num_bins, sizeof(*array->bin_len));
+	array->bin_offsets = calloc(highest_index, sizeof(*array->bin_offsets));
+	array->index_to_bin = calloc(highest_index, sizeof(*array->index_to_bin));
+	if (!array->bin_strings || !array->bin_len
+	    || !array->bin_offsets || !array->index_to_bin) {
+		fprintf(stderr, "#E %s:%i out of memory\n", __FILE__, __LINE__);
+		exit(1);
+	}
+}
+
+static void bin_free(struct bin_strarray* array)
+{
+	int i;
+
+	for (i = 0; i < array->num_bins; i++)
+		free(array->bin_strings[i]);
+	free(array->bin_strings);
+	free(array->bin_len);
+	free(array->bin_offsets);
+	free(array->index_to_bin);
+}
+
+static int bin_find(struct bin_strarray* array, const char* str)
+{
+	int bin, off;
+
+	bin = hash_djb2((const unsigned char*) str) % array->num_bins;
+	if (!array->bin_strings[bin])
+		return STRIDX_NO_ENTRY;
+	for (off = BIN_STR_HEADER; off < array->bin_len[bin];
+	     off += *(uint16_t*)&array->bin_strings[bin][off-2]) {
+		if (!strcmp(&array->bin_strings[bin][off], str))
+			return *(uint32_t*)&array->bin_strings[bin][off-6] + 1;
+	}
+	return STRIDX_NO_ENTRY;
+}
+
+static int bin_add(struct bin_strarray* array, const char* str)
+{
+	int bin, i, idx, len, new_alloclen;
+	uint32_t hash;
+	char* p;
+
+	if ((idx = bin_find(array, str)) != STRIDX_NO_ENTRY)
+		return idx;
+	hash = hash_djb2((const unsigned char*) str);
+	for (i = 0; i < array->highest_index; i++) {
+		idx = (hash % array->highest_index + i) % array->highest_index;
+		if (idx && !array->bin_offsets[idx])
+			break;
+	}
+	if (i >= array->highest_index) {
+		fprintf(stderr, "#E %s:%i all indices full\n", __FILE__, __LINE__);
+		exit(1);
+	}
+	bin = hash % array->num_bins;
+	len = strlen(str);
+	if (!(array->bin_len[bin]%BIN_INCREMENT)
+	    || array->bin_len[bin]%BIN_INCREMENT + BIN_STR_HEADER+len+1 > BIN_INCREMENT) {
+		new_alloclen = ((array->bin_len[bin] + BIN_STR_HEADER+len+1)
+			/ BIN_INCREMENT + 1) * BIN_INCREMENT;
+		array->bin_strings[bin] = realloc(array->bin_strings[bin], new_alloclen);
+		if (!array->bin_strings[bin]) {
+			fprintf(stderr, "#E %s:%i out of memory\n", __FILE__, __LINE__);
+			exit(1);
+		}
+	}
+	p = &array->bin_strings[bin][array->bin_len[bin]];
+	*(uint32_t*)p = idx;
+	*(uint16_t*)(p+4) = BIN_STR_HEADER+len+1;
+	strcpy(p+BIN_STR_HEADER, str);
+	array->index_to_bin[idx] = bin;
+	array->bin_offsets[idx] = array->bin_len[bin]+BIN_STR_HEADER;
+	array->bin_len[bin] += BIN_STR_HEADER+len+1;
+	return idx+1;
+}
+
+// Adds all strings of the model to a new array, then finds
+// NUM_LOOKUPS of them. Either one fails if an index differs
+// from the one the model has.
+static void time_strarray(struct fpga_model* model, int use_bins,
+	double* add_time, double* find_time)
+{
+	struct hashed_strarray arr;
+	struct bin_strarray bins;
+	const char* str;
+	double start;
+	int i, idx, num_done;
+
+	start = now();
+	if (use_bins)
+		bin_init(&bins, model->str.highest_index);
+	else
+		strarray_init(&arr, model->str.highest_index);
+	for (i = 1; i < model->str.highest_index; i++) {
+		if (!(str = strarray_lookup(&model->str, i)))
+			continue;
+		if (use_bins)
+			idx = bin_add(&bins, str);
+		else if (strarray_add(&arr, str, &idx))
+			idx = STRIDX_NO_ENTRY;
+		if (idx != i) {
+			fprintf(stderr, "#E %s:%i %s added as %i instead of %i\n",
+				__FILE__, __LINE__, str, idx, i);
+			exit(1);
+		}
+	}
+	*add_time = now() - start;
+
+	start = now();
+	num_done = 0;
+	while (num_done < NUM_LOOKUPS) {
+		for (i = 1; i < model->str.highest_index
+			    && num_done < NUM_LOOKUPS; i++) {
+			if (!(str = strarray_lookup(&model->str, i)))
+				continue;
+			idx = use_bins ? bin_find(&bins, str)
+				: strarray_find(&arr, str);
+			if (idx != i) {
+				fprintf(stderr, "#E %s:%i %s found as %i instead of %i\n",
+					__FILE__, __LINE__, str, idx, i);
+				exit(1);
+			}
+			num_done++;
+		}
+	}
+	*find_time = now() - start;
+	if (use_bins)
+		bin_free(&bins);
+	else
+		strarray_free(&arr);
+}
+
+// Enables every 16th switch with bits in each routing tile, which
+// still uses far more switches than any real design would.
+static void route_all(struct fpga_model* model)
+{
+	struct sw_query* q;
+	int y, x, i, num_q, q_size, num_sw;
+	void* new_ptr;
+
+	// Not every bitpos pair exists in every tile, the batch
+	// lookup returns NO_SWITCH for those without an error.
+	q = 0;
+	num_q = q_size = 0;
+	for (x = 0; x < model->x_width; x++) {
+		if (!is_atx(X_ROUTING_COL, model, x))
+			continue;
+		for (y = TOP_IO_TILES; y < model->y_height-BOT_IO_TILES; y++) {
+			if (is_aty(Y_ROW_HORIZ_AXSYMM|Y_CHIP_HORIZ_REGS, model, y))
+				continue;
+			for (i = (y+x) % 16; i < model->num_bitpos; i += 16) {
+				if (num_q >= q_size) {
+					q_size = q_size ? q_size*2 : 4096;
+					new_ptr = realloc(q, q_size*sizeof(*q));
+					if (!new_ptr) {
+						fprintf(stderr, "#E %s:%i out of memory\n",
+							__FILE__, __LINE__);
+						exit(1);
+					}
+					q = new_ptr;
+				}
+				q[num_q].y = y;
+				q[num_q].x = x;
+				q[num_q].from = fpga_wire2str_i(model,
+					model->sw_bitpos[i].from);
+				q[num_q].to = fpga_wire2str_i(model,
+					model->sw_bitpos[i].to);
+				num_q++;
+			}
+		}
+	}
+	if (fpga_switch_lookup_batch(model, q, num_q)) {
+		fprintf(stderr, "#E %s:%i batch lookup failed\n",
+			__FILE__, __LINE__);
+		exit(1);
+	}
+	num_sw = 0;
+	for (i = 0; i < num_q; i++) {
+		if (q[i].sw == NO_SWITCH)
+			continue;
+		fpga_switch_enable(model, q[i].y, q[i].x, q[i].sw);
+		num_sw++;
+	}
+	free(q);
+	printf("routed: %i switches\n", num_sw);
+}
+
+// Adds num_nets random nets between logic devices, each from an
+// out pin to 1-4 in pins of devices up to 8 tiles away. No pin is
+// used twice.
+static void gen_design(struct fpga_model* model, int num_nets)
+{
+	struct fpga_tile* tile;
+	struct { int y, x, type_idx; uint32_t used_in; } *devs;
+	int num_devs, y, x, i, j, src, dst, num_sinks, pin, tries;
+	unsigned int seed;
+	net_idx_t net;
+
+	devs = malloc(model->x_width * model->y_height * 2 * sizeof(*devs));
+	if (!devs) {
+		fprintf(stderr, "#E %s:%i out of memory\n", __FILE__, __LINE__);
+		exit(1);
+	}
+	num_devs = 0;
+	for (y = 0; y < model->y_height; y++) {
+		for (x = 0; x < model->x_width; x++) {
+			tile = YX_TILE(model, y, x);
+			for (i = 0; i < tile->num_devs; i++) {
+				if (tile->devs[i].type != DEV_LOGIC)
+					continue;
+				devs[num_devs].y = y;
+				devs[num_devs].x = x;
+				devs[num_devs].type_idx = fdev_typeidx(model, y, x, i);
+				devs[num_devs].used_in = 0;
+				num_devs++;
+			}
+		}
+	}
+	// each device drives LO_A to LO_D once
+	if (num_nets > num_devs*4)
+		num_nets = num_devs*4;
+	seed = 1;
+	for (i = 0; i < num_nets; i++) {
+		src = (i * 7919) % num_devs;
+		fnet_new(model, &net);
+		fnet_add_port(model, net, devs[src].y, devs[src].x, DEV_LOGIC,
+			devs[src].type_idx, LO_A + (i * 7919 / num_devs) % 4);
+		num_sinks = 1 + (seed = seed*1103515245 + 12345) / 65536 % 4;
+		for (j = 0, tries = 0; j < num_sinks && tries < 1000; tries++) {
+			dst = (seed = seed*1103515245 + 12345) / 65536 % num_devs;
+			if (dst == src
+			    || abs(devs[dst].y - devs[src].y) > 8
+			    || abs(devs[dst].x - devs[src].x) > 8)
+				continue;
+			pin = (seed = seed*1103515245 + 12345) / 65536 % 24;
+			if (devs[dst].used_in & (1 << pin))
+				continue;
+			devs[dst].used_in |= 1 << pin;
+			fnet_add_port(model, net, devs[dst].y, devs[dst].x,
+				DEV_LOGIC, devs[dst].type_idx, LI_A1 + pin);
+			j++;
+		}
+	}
+	free(devs);
+}
+
+// Routes generated designs of increasing size on clones of model.
+static void time_route_all(struct fpga_model* model)
+{
+	static const int sizes[] = { 250, 500, 1000, 2000 };
+	struct fpga_model clone;
+	struct route_stats stats;
+	int i;
+
+	for (i = 0; i < sizeof(sizes)/sizeof(*sizes); i++) {
+		if (fpga_clone_model(&clone, model)) {
+			fprintf(stderr, "#E %s:%i clone failed\n",
+				__FILE__, __LINE__);
+			exit(1);
+		}
+		gen_design(&clone, sizes[i]);
+		if (fnet_route_all(&clone, &stats))
+			fprintf(stderr, "#E %s:%i routing %i nets failed\n",
+				__FILE__, __LINE__, sizes[i]);
+		route_print_stats(stdout, &stats);
+		fpga_free_model(&clone);
+	}
+}
+
+// Loads the lookahead tables, then routes the same design with the
+// tile distance and with the lookahead as the A* estimate.
+static void time_route_lookahead(struct fpga_model* model)
+{
+	const struct lookahead* la;
+	struct fpga_model clone;
+	struct route_stats stats;
+	double start;
+	int on;
+
+	start = now();
+	la = la_get(model, /*rrg*/ 0);
+	if (!la) {
+		fprintf(stderr, "#E %s:%i lookahead failed\n",
+			__FILE__, __LINE__);
+		exit(1);
+	}
+	printf("lookahead loaded in %.3fs\n", now() - start);
+	la_print_stats(stdout, la);
+	for (on = 0; on <= 1; on++) {
+		if (fpga_clone_model(&clone, model)) {
+			fprintf(stderr, "#E %s:%i clone failed\n",
+				__FILE__, __LINE__);
+			exit(1);
+		}
+		gen_design(&clone, 2000);
+		fnet_set_route_lookahead(on);
+		if (fnet_route_all(&clone, &stats))
+			fprintf(stderr, "#E %s:%i routing failed\n",
+				__FILE__, __LINE__);
+		printf("%s: ", on ? "lookahead" : "distance");
+		route_print_stats(stdout, &stats);
+		fpga_free_model(&clone);
+	}
+}
+
+// Routes the same design serially and on 1 to all cpus. make
+// test_route checks that the parallel routings are identical.
+static void time_route_threads(struct fpga_model* model)
+{
+	struct fpga_model clone;
+	struct route_stats stats;
+	int num_cpus, num_threads, last;
+	double one_thread;
+
+	num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (num_cpus < 2)
+		num_cpus = 2;
+	if (num_cpus > ROUTE_MAX_THREADS)
+		num_cpus = ROUTE_MAX_THREADS;
+	one_thread = 0;
+	for (num_threads = 0, last = 0; !last;
+	     num_threads = num_threads ? num_threads*2 : 1) {
+		if (num_threads >= num_cpus) {
+			num_threads = num_cpus;
+			last = 1;
+		}
+		if (fpga_clone_model(&clone, model)) {
+			fprintf(stderr, "#E %s:%i clone failed\n",
+				__FILE__, __LINE__);
+			exit(1);
+		}
+		gen_design(&clone, 2000);
+		fnet_set_route_threads(num_threads);
+		if (fnet_route_all(&clone, &stats))
+			fprintf(stderr, "#E %s:%i routing failed\n",
+				__FILE__, __LINE__);
+		fpga_free_model(&clone);
+		if (!num_threads) {
+			route_print_stats(stdout, &stats);
+			continue;
+		}
+		if (num_threads == 1)
+			one_thread = stats.seconds;
+		printf("%2i threads: %.3fs %.2fx, ", num_threads, stats.seconds,
+			one_thread / stats.seconds);
+		route_print_stats(stdout, &stats);
+	}
+	fnet_set_route_threads(0);
+}
+
+// Routes a design, then routes the nets of one device at a time
+// again in a route session.
+static void time_route_dirty(struct fpga_model* model)
+{
+	struct fpga_model clone;
+	struct route_session* sess;
+	struct route_stats stats;
+	struct fpga_net* net;
+	int i, num_nets, num_changes;
+	double open_time, start;
+
+	if (fpga_clone_model(&clone, model)) {
+		fprintf(stderr, "#E %s:%i clone failed\n", __FILE__, __LINE__);
+		exit(1);
+	}
+	gen_design(&clone, 2000);
+	if (fnet_route_all(&clone, &stats))
+		fprintf(stderr, "#E %s:%i routing failed\n", __FILE__, __LINE__);
+	open_time = now();
+	if (route_open(&sess, &clone)) {
+		fprintf(stderr, "#E %s:%i route_open() failed\n",
+			__FILE__, __LINE__);
+		exit(1);
+	}
+	open_time = now() - open_time;
+	num_nets = num_changes = 0;
+	start = now();
+	for (i = 0; i < clone.highest_used_net; i += 20) {
+		// the device of the first in pin
+		net = &clone.nets[i];
+		if (net->len < 2 || !(net->el[1].idx & NET_IDX_IS_PINW))
+			continue;
+		route_dirty_dev(sess, net->el[1].y, net->el[1].x, DEV_LOGIC,
+			fdev_typeidx(&clone, net->el[1].y, net->el[1].x,
+			net->el[1].dev_idx));
+		if (route_dirty(sess, &stats))
+			fprintf(stderr, "#E %s:%i rerouting failed\n",
+				__FILE__, __LINE__);
+		num_nets += stats.num_nets;
+		num_changes++;
+	}
+	printf("route session: open %.3fs, %i changes with %.1f nets "
+		"in %.2fms each\n", open_time, num_changes,
+		(double) num_nets / num_changes,
+		(now() - start) * 1000 / num_changes);
+	route_close(sess);
+	fpga_free_model(&clone);
+}
+
+// Maps the names of all used switches to wires, like
+// write_model() does for each of them.
+static double time_str2wire(struct fpga_model* model)
+{
+	struct fpga_tile* tile;
+	int i, j, num_wires;
+	uint32_t sw;
+	double start;
+
+	start = now();
+	num_wires = 0;
+	for (i = 0; i < model->x_width * model->y_height; i++) {
+		tile = &model->tiles[i];
+		for (j = 0; j < tile->num_switches; j++) {
+			sw = tile->switches[j];
+			if (!(sw & SWITCH_USED))
+				continue;
+			num_wires += fpga_str2wire(strarray_lookup(&model->str,
+				tile->conn_point_names[SW_FROM_I(sw)*2+1])) != NO_WIRE;
+			num_wires += fpga_str2wire(strarray_lookup(&model->str,
+				tile->conn_point_names[SW_TO_I(sw)*2+1])) != NO_WIRE;
+		}
+	}
+	if (!num_wires) {
+		fprintf(stderr, "#E %s:%i no wires\n", __FILE__, __LINE__);
+		exit(1);
+	}
+	return now() - start;
+}
+
+static double time_write_model(struct fpga_model* model)
+{
+	struct fpga_bits bits;
+	double start;
+
+	bits.len = IOB_DATA_START + IOB_DATA_LEN;
+	bits.d = calloc(bits.len, /*elsize*/ 1);
+	if (!bits.d) {
+		fprintf(stderr, "#E %s:%i out of memory\n", __FILE__, __LINE__);
+		exit(1);
+	}
+	start = now();
+	if (write_model(&bits, model)) {
+		fprintf(stderr, "#E %s:%i write_model failed\n",
+			__FILE__, __LINE__);
+		exit(1);
+	}
+	start = now() - start;
+	free(bits.d);
+	return start;
+}
+
+static void print_swbox_stats(struct fpga_model* model)
+{
+	struct fpga_tile* tile;
+	struct swbox_template* tmpl;
+	int i, num_sw_shared, num_connpt_shared;
+	double all_bytes, bytes;
+
+	num_sw_shared = num_connpt_shared = 0;
+	all_bytes = bytes = 0;
+	for (i = 0; i < model->x_width * model->y_height; i++) {
+		tile = &model->tiles[i];
+		all_bytes += tile->num_switches*sizeof(*tile->switches)
+			+ tile->num_conn_point_names*2*sizeof(*tile->conn_point_names)
+			+ tile->connpt_hash_size*sizeof(*tile->connpt_hash);
+		if (tile->flags & TF_SHARED_SWITCHES)
+			num_sw_shared++;
+		else
+			bytes += tile->num_switches*sizeof(*tile->switches);
+		if (tile->flags & TF_SHARED_CONNPTS)
+			num_connpt_shared++;
+		else
+			bytes += tile->num_conn_point_names*2*sizeof(*tile->conn_point_names)
+				+ tile->connpt_hash_size*sizeof(*tile->connpt_hash);
+	}
+	for (i = 0; i < model->num_swbox_templates[SWBOX_SWITCHES]; i++) {
+		tmpl = &model->swbox_templates[SWBOX_SWITCHES][i];
+		bytes += tmpl->num*sizeof(*tile->switches);
+	}
+	for (i = 0; i < model->num_swbox_templates[SWBOX_CONNPTS]; i++) {
+		tmpl = &model->swbox_templates[SWBOX_CONNPTS][i];
+		bytes += tmpl->num*2*sizeof(*tile->conn_point_names)
+			+ tmpl->connpt_hash_size*sizeof(*tmpl->connpt_hash);
+	}
+	printf("switches: %i tiles share %i templates\n", num_sw_shared,
+		model->num_swbox_templates[SWBOX_SWITCHES]);
+	printf("connpts:  %i tiles share %i templates\n", num_connpt_shared,
+		model->num_swbox_templates[SWBOX_CONNPTS]);
+	printf("switchbox memory: %.1f MB instead of %.1f MB\n",
+		bytes/(1024*1024), all_bytes/(1024*1024));
+}
+
+static void print_result(const char* what, double before, double after)
+{
+	printf("%-24s %10.4fs %10.4fs %8.2fx\n", what, before, after,
+		after > 0 ? before / after : 0);
+}
+
+// The connpt and switch indices, switch closures and wire table are
+// compiled in. To compare against the paths without them, build the
+// libs with CFLAGS="-DNO_CONNPT_INDEX -DNO_SWITCH_INDEX
+// -DNO_SWITCH_CLOSURES -DNO_WIRE_TABLE" and run again.
+static void print_time(const char* what, double t)
+{
+	printf("%-24s %10.4fs\n", what, t);
+}
+
+int main(int argc, char** argv)
+{
+	struct fpga_model model, clone;
+	struct rr_graph rrg;
+	double build_tables, build_proc, lookup, enum_time, clone_time;
+	double add_bins, add_oa, find_bins, find_oa, write_time, str2wire;
+	double rrg_time, multi, lookup_single, lookup_batch;
+	int i, idcode;
+	enum xc6_pkg pkg;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--help")) {
+			printf( "\n%s\n\n"
+				"Usage: %s [--part=xc6slx9]\n"
+				"       %*s [--build-threads=<num>]\n"
+				"       %*s [--help]\n\n",
+				*argv, *argv, (int) strlen(*argv), "",
+				(int) strlen(*argv), "");
+			return 1;
+		}
+	}
+	idcode = cmdline_part(argc, argv);
+	pkg = cmdline_package(argc, argv);
+	fpga_set_build_threads(cmdline_build_threads(argc, argv));
+	// always measure a real build
+	unsetenv(FPGA_MODEL_CACHE_ENV);
+	unsetenv(FPGA_MODEL_TABLES_ENV);
+	build_tables = time_build(&model, idcode, pkg);
+	time_strarray(&model, /*use_bins*/ 1, &add_bins, &find_bins);
+	time_strarray(&model, /*use_bins*/ 0, &add_oa, &find_oa);
+	printf("strings: %i\n", strarray_used_slots(&model.str));
+	time_route_lookahead(&model);
+	time_route_all(&model);
+	time_route_threads(&model);
+	time_route_dirty(&model);
+	fpga_free_model(&model);
+	setenv(FPGA_MODEL_TABLES_ENV, "0", 1);
+
+	build_proc = time_build(&model, idcode, pkg);
+	lookup = time_switch_lookup(&model);
+	enum_time = time_switch_enum(&model);
+	multi = time_multi_lookup(&model);
+	time_batch_lookup(&model, &lookup_single, &lookup_batch);
+	print_swbox_stats(&model);
+	rrg_time = now();
+	if (rrg_build(&rrg, &model)) {
+		fprintf(stderr, "#E %s:%i routing graph failed\n",
+			__FILE__, __LINE__);
+		exit(1);
+	}
+	rrg_time = now() - rrg_time;
+	rrg_print_stats(stdout, &rrg);
+	printf("build routing graph: %.4fs\n", rrg_time);
+	rrg_free(&rrg);
+	route_all(&model);
+	str2wire = time_str2wire(&model);
+	write_time = time_write_model(&model);
+	clone_time = now();
+	if (fpga_clone_model(&clone, &model)) {
+		fprintf(stderr, "#E %s:%i clone failed\n", __FILE__, __LINE__);
+		exit(1);
+	}
+	fpga_free_model(&clone);
+	clone_time = now() - clone_time;
+	printf("clone and free model: %.4fs\n", clone_time);
+	printf("build from static tables: %.4fs\n", build_tables);
+	fpga_free_model(&model);
+
+	print_time("build model", build_proc);
+	print_time("fpga_switch_lookup", lookup);
+	print_time("fpga_switch_first/next", enum_time);
+	print_time("fpga_multi_switch_lookup", multi);
+	print_time("fpga_str2wire", str2wire);
+	print_time("write_model", write_time);
+	printf("%-24s %11s %11s %9s\n", "", "single", "batch", "speedup");
+	print_result("fpga_switch_lookup", lookup_single, lookup_batch);
+	printf("%-24s %11s %11s %9s\n", "", "bins", "open addr", "speedup");
+	print_result("strarray_add", add_bins, add_oa);
+	print_result("strarray_find", find_bins, find_oa);
+	return 0;
+}
@@ -15,8 +15,10 @@ static void help_exit(int argc, char **argv)
 		"\n"
 		"%s - bitstream to floorplan\n"
 		"Usage: %s [--help] [--verbose] [--bit-header] [--bit-regs] [--bit-crc]\n"
-		"       %*s [--no-model] [--no-fp-header] <bitstream_file>\n"
-		"\n", argv[0], argv[0], (int) strlen(argv[0]), "");
+		"       %*s [--no-model] [--no-fp-header] [--build-threads=<num>]\n"
+		"       %*s <bitstream_file>\n"
+		"\n", argv[0], argv[0], (int) strlen(argv[0]), "",
+		(int) strlen(argv[0]), "");
 	exit(EXIT_SUCCESS);
 }
 
@@ -52,6 +54,8 @@ int main(int argc, char** argv)
 			pull_model = 0;
 		else if (!strcmp(argv[file_arg], "--no-fp-header"))
 			fp_header = 0;
+		else if (!strncmp(argv[file_arg], "--build-threads=", 16))
+			fpga_set_build_threads(atoi(&argv[file_arg][16]));
 		else break;
 		file_arg++;
 	}
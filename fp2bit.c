@@ -15,12 +15,25 @@ int main(int argc, char** argv)
 	FILE *fbits = 0, *fp = 0;
 	int rc = -1;
 
+	while (argc > 1) {
+		if (!strncmp(argv[1], "--build-threads=", 16))
+			fpga_set_build_threads(atoi(&argv[1][16]));
+		else if (!strcmp(argv[1], "--lazy-build"))
+			fpga_set_lazy_build(1);
+		else
+			break;
+		// drop the option, keep the program name in argv[0]
+		argv[1] = argv[0];
+		argc--;
+		argv++;
+	}
 	if (argc != 2 && argc != 3) {
 		fprintf(stderr,
 			"\n"
 			"%s - floorplan to bitstream\n"
-			"Usage: %s <floorplan_file|- for stdin> [<bits_file>]\n"
-			"\n", argv[0], argv[0]);
+			"Usage: %s [--build-threads=<num>] [--lazy-build]\n"
+			"       %*s <floorplan_file|- for stdin> [<bits_file>]\n"
+			"\n", argv[0], argv[0], (int) strlen(argv[0]), "");
 		goto fail;
 	}
 
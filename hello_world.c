@@ -33,6 +33,8 @@ int main(int argc, char** argv)
 	struct fpgadev_logic logic_cfg;
 	net_idx_t inA_net, inB_net, out_net;
 
+	fpga_set_build_threads(cmdline_build_threads(argc, argv));
+	fpga_set_lazy_build(cmdline_lazy_build(argc, argv));
 	fpga_build_model(&model, XC6SLX9, TQG144);
 
 	fpga_find_iob(&model, "P45", &iob_inA_y, &iob_inA_x,
@@ -33,11 +33,11 @@ int main(int argc, char** argv)
 		goto xout;
 	}
 
-	if (strarray_init(&search_arr, STRIDX_1M)) {
+	if (strarray_init(&search_arr, STRIDX_GROW)) {
 		fprintf(stderr, "Out of memory in %s:%i\n", __FILE__, __LINE__);
 		goto xout;
 	}
-	if (strarray_init(&replace_arr, STRIDX_1M)) {
+	if (strarray_init(&replace_arr, STRIDX_GROW)) {
 		fprintf(stderr, "Out of memory in %s:%i\n", __FILE__, __LINE__);
 		goto xout;
 	}
@@ -40,6 +40,8 @@ int main(int argc, char** argv)
 	if (!(param_led_pin = cmdline_strvar(argc, argv, "led_pin")))
 		param_led_pin = "IO_L48P_D7_2";
 
+	fpga_set_build_threads(cmdline_build_threads(argc, argv));
+	fpga_set_lazy_build(cmdline_lazy_build(argc, argv));
 	fpga_build_model(&model, cmdline_part(argc, argv),
 		cmdline_package(argc, argv));
 
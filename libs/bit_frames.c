@@ -94,6 +94,8 @@ struct extract_state
 	// model, stored here for later processing into nets.
 	int num_yx_pos;
 	struct sw_yxpos *yx_pos;
+	// routing switch queries of one tile, num_bitpos entries
+	struct sw_query *sw_q;
 };
 
 static int find_es_switch(struct extract_state* es, int y, int x, swidx_t sw)
@@ -1678,19 +1680,25 @@ static int extract_routing_switches(struct extract_state* es, int y, int x)
 {
 	struct fpga_tile* tile;
 	swidx_t sw_idx;
-	str16_t from_str, to_str;
-	int i, is_set, rc;
+	int i, num_q, is_set, rc;
 
 	RC_CHECK(es->model);
 	tile = YX_TILE(es->model, y, x);
 
+	// collect the set bits first, then resolve all
+	// switches of the tile in one batch
+	num_q = 0;
 	for (i = 0; i < es->model->num_bitpos; i++) {
 		rc = bitpos_is_set(es, y, x, &es->model->sw_bitpos[i], &is_set);
 		if (rc) RC_FAIL(es->model, rc);
 		if (!is_set) continue;
 
-		from_str = fpga_wire2str_yx(es->model, es->model->sw_bitpos[i].from, y, x);
-		to_str = fpga_wire2str_yx(es->model, es->model->sw_bitpos[i].to, y, x);
+		es->sw_q[num_q].y = y;
+		es->sw_q[num_q].x = x;
+		es->sw_q[num_q].from = fpga_wire2str_yx(es->model,
+			es->model->sw_bitpos[i].from, y, x);
+		es->sw_q[num_q].to = fpga_wire2str_yx(es->model,
+			es->model->sw_bitpos[i].to, y, x);
 #ifdef DBG_EXTRACT_ROUTING_SW
 		fprintf(stderr, "#D %s:%i y%i x%i (r%i ma%i v64_%02i mi%i) "
 			"from %s to %s bidir %i "
@@ -1700,14 +1708,24 @@ static int extract_routing_switches(struct extract_state* es, int y, int x)
 			es->model->x_major[x],
 			regular_row_pos(y, es->model),
 			es->model->sw_bitpos[i].minor,
-			strarray_lookup(&es->model->str, from_str),
-			strarray_lookup(&es->model->str, to_str),
+			strarray_lookup(&es->model->str, es->sw_q[num_q].from),
+			strarray_lookup(&es->model->str, es->sw_q[num_q].to),
 			es->model->sw_bitpos[i].bidir,
 			es->model->sw_bitpos[i].two_bits_o,
 			es->model->sw_bitpos[i].two_bits_val,
 			es->model->sw_bitpos[i].one_bit_o);
 #endif
-		sw_idx = fpga_switch_lookup(es->model, y, x, from_str, to_str);
+		num_q++;
+		rc = bitpos_clear_bits(es, y, x, &es->model->sw_bitpos[i]);
+		if (rc) RC_FAIL(es->model, rc);
+	}
+	if (!num_q)
+		RC_RETURN(es->model);
+	rc = fpga_switch_lookup_batch(es->model, es->sw_q, num_q);
+	if (rc) RC_FAIL(es->model, rc);
+
+	for (i = 0; i < num_q; i++) {
+		sw_idx = es->sw_q[i].sw;
 		if (sw_idx == NO_SWITCH) RC_FAIL(es->model, EINVAL);
 		// todo: es->model->sw_bitpos[i].bidir handling
 
@@ -1723,8 +1741,6 @@ static int extract_routing_switches(struct extract_state* es, int y, int x)
 		es->yx_pos[es->num_yx_pos].x = x;
 		es->yx_pos[es->num_yx_pos].idx = sw_idx;
 		es->num_yx_pos++;
-		rc = bitpos_clear_bits(es, y, x, &es->model->sw_bitpos[i]);
-		if (rc) RC_FAIL(es->model, rc);
 	}
 	RC_RETURN(es->model);
 }
@@ -2306,6 +2322,13 @@ static int construct_extract_state(struct extract_state* es,
 	es->model = model;
 	es->yx_pos = malloc(MAX_YX_SWITCHES * sizeof(*es->yx_pos));
 	if (!es->yx_pos) { HERE(); return ENOMEM; }
+	es->sw_q = malloc(model->num_bitpos * sizeof(*es->sw_q));
+	if (!es->sw_q && model->num_bitpos) {
+		free(es->yx_pos);
+		es->yx_pos = 0;
+		HERE();
+		return ENOMEM;
+	}
 	return 0;
 }
 
@@ -2313,6 +2336,8 @@ static void destruct_extract_state(struct extract_state *es)
 {
 	free(es->yx_pos);
 	es->yx_pos = 0;
+	free(es->sw_q);
+	es->sw_q = 0;
 }
 
 static int extract_bscan(struct extract_state *es)
@@ -2396,6 +2421,7 @@ int extract_model(struct fpga_model* model, struct fpga_bits* bits)
 	int i, rc;
 
 	RC_CHECK(model);
+	MATERIALIZE_ALL(model);
 	rc = construct_extract_state(&es, model);
 	if (rc) RC_FAIL(model, rc);
 	es.bits = bits;
@@ -5,6 +5,7 @@
 // For details see the UNLICENSE file at the root of the source tree.
 //
 
+#include <pthread.h>
 #include "model.h"
 #include "control.h"
  
@@ -288,8 +289,8 @@ const char* fdev_pinw_idx2str(int devtype, pinw_idx_t idx)
 const char* fdev_logic_pinstr(pinw_idx_t idx, int ld1_type)
 {
  	enum { NUM_BUFS = 16, BUF_SIZE = 16 };
-	static char buf[NUM_BUFS][BUF_SIZE];
-	static int last_buf = 0;
+	static __thread char buf[NUM_BUFS][BUF_SIZE];
+	static __thread int last_buf = 0;
 
 	last_buf = (last_buf+1)%NUM_BUFS;
 	if (ld1_type == LOGIC_M)
@@ -400,6 +401,551 @@ static void add_req_outpin(struct fpga_device* dev, pinw_idx_t pinw_i)
 	dev->pinw_req_total++;
 }
 
+//
+// switch owners
+//
+
+struct sw_owner
+{
+	int tile; // y*x_width+x
+	swidx_t swidx;
+	net_idx_t net_i; // NO_NET for an empty slot
+};
+
+#define SW_OWNERS_MIN	1024
+#define SW_OWNER_HASH(tile, swidx, size) \
+	((((uint32_t) (tile) << 16 | (swidx)) * 2654435761U \
+	 ^ (((uint32_t) (tile) << 16 | (swidx)) * 2654435761U) >> 15) & ((size)-1))
+
+static int sw_owner_slot(struct fpga_model* model, int tile, swidx_t swidx)
+{
+	struct sw_owner* slot;
+	int i, mask;
+
+	mask = model->sw_owners_size-1;
+	for (i = SW_OWNER_HASH(tile, swidx, model->sw_owners_size);
+	     model->sw_owners[i].net_i; i = (i+1) & mask) {
+		slot = &model->sw_owners[i];
+		if (slot->tile == tile && slot->swidx == swidx)
+			return i;
+	}
+	return -1 - i; // the empty slot it would go into
+}
+
+net_idx_t fpga_switch_net(struct fpga_model* model, int y, int x,
+	swidx_t swidx)
+{
+	uint64_t* bits;
+	int tile, i;
+
+	tile = y*model->x_width + x;
+	bits = model->net_sw_bits ? model->net_sw_bits[tile] : 0;
+	if (!bits || !(bits[swidx/64] & (1ULL << (swidx%64))))
+		return NO_NET;
+	i = sw_owner_slot(model, tile, swidx);
+	if (i < 0) { HERE(); return NO_NET; }
+	return model->sw_owners[i].net_i;
+}
+
+static int sw_owners_grow(struct fpga_model* model)
+{
+	struct sw_owner* old_owners, *old;
+	int old_size, i, j;
+
+	old_owners = model->sw_owners;
+	old_size = model->sw_owners_size;
+	model->sw_owners_size = old_size ? old_size*2 : SW_OWNERS_MIN;
+	model->sw_owners = calloc(model->sw_owners_size,
+		sizeof(*model->sw_owners));
+	if (!model->sw_owners) {
+		model->sw_owners = old_owners;
+		model->sw_owners_size = old_size;
+		return ENOMEM;
+	}
+	for (i = 0; i < old_size; i++) {
+		old = &old_owners[i];
+		if (!old->net_i) continue;
+		j = -1 - sw_owner_slot(model, old->tile, old->swidx);
+		model->sw_owners[j] = *old;
+	}
+	free(old_owners);
+	return 0;
+}
+
+static void sw_owner_set(struct fpga_model* model, int y, int x,
+	swidx_t swidx, net_idx_t net_i)
+{
+	struct fpga_tile* tile_p;
+	int tile, i;
+
+	tile = y*model->x_width + x;
+	if (!model->net_sw_bits) {
+		model->net_sw_bits = calloc(model->x_width * model->y_height,
+			sizeof(*model->net_sw_bits));
+		if (!model->net_sw_bits) { RC_SET(model, ENOMEM); return; }
+	}
+	if (!model->net_sw_bits[tile]) {
+		tile_p = YX_TILE(model, y, x);
+		model->net_sw_bits[tile] = calloc(
+			(tile_p->num_switches+63)/64, sizeof(uint64_t));
+		if (!model->net_sw_bits[tile]) { RC_SET(model, ENOMEM); return; }
+	}
+	// at most half full
+	if ((model->num_sw_owners+1)*2 > model->sw_owners_size
+	    && sw_owners_grow(model)) {
+		RC_SET(model, ENOMEM);
+		return;
+	}
+	i = sw_owner_slot(model, tile, swidx);
+	if (i < 0) {
+		i = -1 - i;
+		model->sw_owners[i].tile = tile;
+		model->sw_owners[i].swidx = swidx;
+		model->num_sw_owners++;
+	}
+	model->sw_owners[i].net_i = net_i;
+	model->net_sw_bits[tile][swidx/64] |= 1ULL << (swidx%64);
+}
+
+static void sw_owner_clear(struct fpga_model* model, int y, int x,
+	swidx_t swidx)
+{
+	struct sw_owner* slot;
+	int tile, i, j, home, mask;
+
+	if (fpga_switch_net(model, y, x, swidx) == NO_NET)
+		return;
+	tile = y*model->x_width + x;
+	i = sw_owner_slot(model, tile, swidx);
+	// Move later slots of the probe sequence up into the hole,
+	// unless their home slot lies after the hole.
+	mask = model->sw_owners_size-1;
+	for (j = (i+1) & mask; model->sw_owners[j].net_i; j = (j+1) & mask) {
+		slot = &model->sw_owners[j];
+		home = SW_OWNER_HASH(slot->tile, slot->swidx,
+			model->sw_owners_size);
+		if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+			continue;
+		model->sw_owners[i] = *slot;
+		i = j;
+	}
+	model->sw_owners[i].net_i = NO_NET;
+	model->num_sw_owners--;
+	model->net_sw_bits[tile][swidx/64] &= ~(1ULL << (swidx%64));
+}
+
+// Adds or removes the switches of a net to and from the owners.
+static void net_sw_owners(struct fpga_model* model, net_idx_t net_i,
+	int add)
+{
+	struct net_el* el;
+	int i;
+
+	for (i = 0; i < model->nets[net_i-1].len; i++) {
+		el = &model->nets[net_i-1].el[i];
+		if (el->idx & NET_IDX_IS_PINW)
+			continue;
+		if (add)
+			sw_owner_set(model, el->y, el->x, el->idx, net_i);
+		else if (fpga_switch_net(model, el->y, el->x, el->idx) == net_i)
+			sw_owner_clear(model, el->y, el->x, el->idx);
+	}
+}
+
+static void sw_owners_free(struct fpga_model* model)
+{
+	int i;
+
+	if (model->net_sw_bits) {
+		for (i = 0; i < model->x_width * model->y_height; i++)
+			free(model->net_sw_bits[i]);
+		free(model->net_sw_bits);
+		model->net_sw_bits = 0;
+	}
+	free(model->sw_owners);
+	model->sw_owners = 0;
+	model->sw_owners_size = 0;
+	model->num_sw_owners = 0;
+}
+
+//
+// net element pool
+//
+
+// The el arrays of the nets hold NET_EL_MIN << class elements and
+// are cut from chunks of at least NET_EL_CHUNK elements. Arrays that
+// are given back go into a free list per class, linked through their
+// first bytes. The chunks are only freed by fnet_free_all().
+
+#define NET_EL_MIN	8
+#define NET_EL_CLASSES	24
+#define NET_EL_CHUNK	8192
+
+struct net_el_chunk
+{
+	struct net_el_chunk* next;
+	int size, used; // in elements
+	// followed by size struct net_el
+};
+
+struct net_pool
+{
+	struct net_el_chunk* chunks;
+	void* free[NET_EL_CLASSES];
+};
+
+static int net_el_class(int len)
+{
+	int cls;
+
+	for (cls = 0; cls < NET_EL_CLASSES-1 && (NET_EL_MIN << cls) < len; cls++);
+	return cls;
+}
+
+static void net_el_free(struct fpga_model* model, struct net_el* el, int cls)
+{
+	*(void**) el = model->net_pool->free[cls];
+	model->net_pool->free[cls] = el;
+}
+
+static struct net_el* net_el_alloc(struct fpga_model* model, int cls)
+{
+	struct net_pool* pool;
+	struct net_el_chunk* chunk;
+	struct net_el* el;
+	int size, chunk_size, tail_cls;
+
+	if (!model->net_pool) {
+		model->net_pool = calloc(1, sizeof(*model->net_pool));
+		if (!model->net_pool) { RC_SET(model, ENOMEM); return 0; }
+	}
+	pool = model->net_pool;
+	if (pool->free[cls]) {
+		el = pool->free[cls];
+		pool->free[cls] = *(void**) el;
+		return el;
+	}
+	size = NET_EL_MIN << cls;
+	chunk = pool->chunks;
+	if (!chunk || chunk->size - chunk->used < size) {
+		// the tail of the last chunk goes into the free lists
+		while (chunk && chunk->size - chunk->used >= NET_EL_MIN) {
+			tail_cls = net_el_class(chunk->size - chunk->used);
+			if ((NET_EL_MIN << tail_cls) > chunk->size - chunk->used)
+				tail_cls--;
+			net_el_free(model, (struct net_el*) (chunk+1)
+				+ chunk->used, tail_cls);
+			chunk->used += NET_EL_MIN << tail_cls;
+		}
+		chunk_size = size > NET_EL_CHUNK ? size : NET_EL_CHUNK;
+		chunk = malloc(sizeof(*chunk) + chunk_size*sizeof(*el));
+		if (!chunk) { RC_SET(model, ENOMEM); return 0; }
+		chunk->size = chunk_size;
+		chunk->used = 0;
+		chunk->next = pool->chunks;
+		pool->chunks = chunk;
+	}
+	el = (struct net_el*) (chunk+1) + chunk->used;
+	chunk->used += size;
+	return el;
+}
+
+static void net_pool_free(struct fpga_model* model)
+{
+	struct net_el_chunk* next;
+
+	if (!model->net_pool)
+		return;
+	while (model->net_pool->chunks) {
+		next = model->net_pool->chunks->next;
+		free(model->net_pool->chunks);
+		model->net_pool->chunks = next;
+	}
+	free(model->net_pool);
+	model->net_pool = 0;
+}
+
+// Makes room for len elements in net, keeping the ones it has.
+static int net_reserve(struct fpga_model* model, struct fpga_net* net,
+	int len)
+{
+	struct net_el* el;
+	int cls;
+
+	RC_CHECK(model);
+	if (len <= net->size)
+		return 0;
+	RC_ASSERT(model, len <= (NET_EL_MIN << (NET_EL_CLASSES-1)));
+	cls = net_el_class(len);
+	el = net_el_alloc(model, cls);
+	if (!el) RC_RETURN(model);
+	if (net->len)
+		memcpy(el, net->el, net->len*sizeof(*el));
+	if (net->size)
+		net_el_free(model, net->el, net_el_class(net->size));
+	net->el = el;
+	net->size = NET_EL_MIN << cls;
+	return 0;
+}
+
+static void net_release(struct fpga_model* model, struct fpga_net* net)
+{
+	if (net->size)
+		net_el_free(model, net->el, net_el_class(net->size));
+	net->el = 0;
+	net->size = 0;
+	net->len = 0;
+}
+
+#define FREE_NETS_INCREMENT 64
+
+static void free_net_push(struct fpga_model* model, net_idx_t net_idx)
+{
+	void* new_ptr;
+
+	if (model->num_free_nets >= model->free_nets_size) {
+		new_ptr = realloc(model->free_nets, (model->free_nets_size
+			+ FREE_NETS_INCREMENT)*sizeof(*model->free_nets));
+		if (!new_ptr) { RC_SET(model, ENOMEM); return; }
+		model->free_nets = new_ptr;
+		model->free_nets_size += FREE_NETS_INCREMENT;
+	}
+	model->free_nets[model->num_free_nets++] = net_idx;
+}
+
+//
+// journal
+//
+
+enum { JRNL_SWITCH = 1, JRNL_NET, JRNL_DEV };
+
+struct journal_entry
+{
+	int type;
+	int y, x;
+	int idx; // swidx, net_i or dev_idx
+	int val; // used bit or highest_used_net
+	// JRNL_NET: struct fpga_net followed by its len elements
+	// JRNL_DEV: struct fpga_device followed by pinw_req_total
+	//           pinw_idx_t of pinw_req_for_cfg
+	void* data;
+};
+
+#define JOURNAL_INCREMENT 256
+
+static struct journal_entry* journal_add(struct fpga_model* model,
+	int type, int y, int x, int idx)
+{
+	struct journal_entry* last;
+
+	if (!model->journal_depth)
+		return 0;
+	if (type != JRNL_SWITCH && model->journal_len > model->journal_mark) {
+		// the entry before holds the older state already
+		last = &model->journal[model->journal_len-1];
+		if (last->type == type && last->y == y && last->x == x
+		    && last->idx == idx)
+			return 0;
+	}
+	if (!(model->journal_len % JOURNAL_INCREMENT)) {
+		void* new_ptr = realloc(model->journal,
+			(model->journal_len+JOURNAL_INCREMENT)*sizeof(*model->journal));
+		if (!new_ptr) {
+			model->journal_lost = 1;
+			RC_SET(model, ENOMEM);
+			return 0;
+		}
+		model->journal = new_ptr;
+	}
+	last = &model->journal[model->journal_len++];
+	last->type = type;
+	last->y = y;
+	last->x = x;
+	last->idx = idx;
+	last->val = 0;
+	last->data = 0;
+	return last;
+}
+
+static void journal_switch(struct fpga_model* model, int y, int x,
+	swidx_t swidx)
+{
+	struct journal_entry* e;
+
+	e = journal_add(model, JRNL_SWITCH, y, x, swidx);
+	if (e)
+		e->val = (YX_TILE(model, y, x)->switches[swidx] & SWITCH_USED) != 0;
+}
+
+// Must be called before fnet_useidx() so that highest_used_net
+// is recorded unchanged.
+static void journal_net(struct fpga_model* model, net_idx_t net_i)
+{
+	struct journal_entry* e;
+	struct fpga_net* net;
+	int len;
+
+	e = journal_add(model, JRNL_NET, 0, 0, net_i);
+	if (!e) return;
+	e->val = model->highest_used_net;
+	len = (net_i-1 < model->nets_array_size) ? model->nets[net_i-1].len : 0;
+	net = malloc(sizeof(*net) + len*sizeof(*net->el));
+	if (!net) {
+		model->journal_len--;
+		model->journal_lost = 1;
+		RC_SET(model, ENOMEM);
+		return;
+	}
+	net->len = len;
+	net->size = len;
+	net->el = (struct net_el*) (net+1);
+	net->is_deleted = (net_i-1 < model->nets_array_size)
+		&& model->nets[net_i-1].is_deleted;
+	if (len)
+		memcpy(net->el, model->nets[net_i-1].el, len*sizeof(*net->el));
+	e->data = net;
+}
+
+static void journal_dev(struct fpga_model* model, int y, int x,
+	struct fpga_device* dev)
+{
+	struct journal_entry* e;
+	struct fpga_device* copy;
+
+	e = journal_add(model, JRNL_DEV, y, x,
+		dev - YX_TILE(model, y, x)->devs);
+	if (!e) return;
+	copy = malloc(sizeof(*copy)
+		+ dev->pinw_req_total*sizeof(*dev->pinw_req_for_cfg));
+	if (!copy) {
+		model->journal_len--;
+		model->journal_lost = 1;
+		RC_SET(model, ENOMEM);
+		return;
+	}
+	*copy = *dev;
+	if (dev->pinw_req_total)
+		memcpy(copy+1, dev->pinw_req_for_cfg,
+			dev->pinw_req_total*sizeof(*dev->pinw_req_for_cfg));
+	e->data = copy;
+}
+
+static void journal_undo(struct fpga_model* model, struct journal_entry* e)
+{
+	struct fpga_tile* tile;
+	struct fpga_device* dev, *saved;
+	struct fpga_net* net;
+	pinw_idx_t* req;
+
+	tile = YX_TILE(model, e->y, e->x);
+	if (e->type == JRNL_SWITCH) {
+		if (tile_unshare_switches(tile)) {
+			RC_SET(model, ENOMEM);
+			return;
+		}
+		if (e->val && !(tile->switches[e->idx] & SWITCH_USED)) {
+			tile->switches[e->idx] |= SWITCH_USED;
+			tile->num_used_switches++;
+		} else if (!e->val && (tile->switches[e->idx] & SWITCH_USED)) {
+			tile->switches[e->idx] &= ~SWITCH_USED;
+			tile->num_used_switches--;
+		}
+	} else if (e->type == JRNL_NET) {
+		net = e->data;
+		model->highest_used_net = e->val;
+		if (e->idx-1 < model->nets_array_size) {
+			net_sw_owners(model, e->idx, /*add*/ 0);
+			if (net_reserve(model, &model->nets[e->idx-1], net->len))
+				return;
+			model->nets[e->idx-1].len = net->len;
+			if (net->len)
+				memcpy(model->nets[e->idx-1].el, net->el,
+					net->len*sizeof(*net->el));
+			if (net->is_deleted && !model->nets[e->idx-1].is_deleted) {
+				model->nets[e->idx-1].is_deleted = 1;
+				free_net_push(model, e->idx);
+			} else if (!net->is_deleted)
+				model->nets[e->idx-1].is_deleted = 0;
+			net_sw_owners(model, e->idx, /*add*/ 1);
+		}
+	} else if (e->type == JRNL_DEV) {
+		dev = &tile->devs[e->idx];
+		saved = e->data;
+		// the pinw_req_for_cfg allocation stays with the device
+		req = dev->pinw_req_for_cfg;
+		if (saved->pinw_req_for_cfg && !req) {
+			req = malloc(dev->num_pinw_total*sizeof(*req));
+			if (!req) {
+				RC_SET(model, ENOMEM);
+				return;
+			}
+		}
+		if (!saved->pinw_req_for_cfg) {
+			free(req);
+			req = 0;
+		}
+		*dev = *saved;
+		dev->pinw_req_for_cfg = req;
+		if (saved->pinw_req_total)
+			memcpy(req, saved+1, saved->pinw_req_total*sizeof(*req));
+	}
+}
+
+int fpga_journal_begin(struct fpga_model* model, int* savepoint)
+{
+	RC_CHECK(model);
+	*savepoint = model->journal_len;
+	model->journal_depth++;
+	model->journal_mark = model->journal_len;
+	RC_RETURN(model);
+}
+
+int fpga_journal_rollback(struct fpga_model* model, int savepoint)
+{
+	if (model->journal_depth < 1
+	    || savepoint < 0 || savepoint > model->journal_len)
+		RC_FAIL(model, EINVAL);
+	// fpga_journal_begin() only succeeds without an error, so
+	// the error goes away with the changes, unless some of them
+	// were not recorded
+	if (!model->journal_lost)
+		model->rc = 0;
+	while (model->journal_len > savepoint) {
+		model->journal_len--;
+		journal_undo(model, &model->journal[model->journal_len]);
+		free(model->journal[model->journal_len].data);
+	}
+	if (!--model->journal_depth)
+		fpga_journal_free(model);
+	model->journal_mark = model->journal_len;
+	RC_RETURN(model);
+}
+
+int fpga_journal_commit(struct fpga_model* model, int savepoint)
+{
+	RC_CHECK(model);
+	RC_ASSERT(model, model->journal_depth > 0
+		&& savepoint >= 0 && savepoint <= model->journal_len);
+	// an outer savepoint may still roll the changes back
+	if (!--model->journal_depth)
+		fpga_journal_free(model);
+	RC_RETURN(model);
+}
+
+void fpga_journal_free(struct fpga_model* model)
+{
+	int i;
+
+	for (i = 0; i < model->journal_len; i++)
+		free(model->journal[i].data);
+	free(model->journal);
+	model->journal = 0;
+	model->journal_len = 0;
+	model->journal_depth = 0;
+	model->journal_mark = 0;
+	model->journal_lost = 0;
+}
+
 //
 // logic device
 //
@@ -413,6 +959,7 @@ int fdev_logic_setconf(struct fpga_model *model, int y, int x,
 	fdev_delete(model, y, x, DEV_LOGIC, type_idx);
 	dev = fdev_p(model, y, x, DEV_LOGIC, type_idx);
 	RC_ASSERT(model, dev);
+	journal_dev(model, y, x, dev);
 
 	dev->u.logic = *logic_cfg;
 	dev->instantiated = 1;
@@ -429,6 +976,7 @@ int fdev_logic_a2d_out_used(struct fpga_model* model, int y, int x,
 
 	dev = fdev_p(model, y, x, DEV_LOGIC, type_idx);
 	RC_ASSERT(model, dev);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) RC_FAIL(model, rc);
 
@@ -449,6 +997,7 @@ int fdev_logic_a2d_ff(struct fpga_model* model, int y, int x, int type_idx,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_LOGIC, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -471,6 +1020,7 @@ int fdev_logic_a2d_ff5_srinit(struct fpga_model* model, int y, int x,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_LOGIC, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -490,6 +1040,7 @@ int fdev_logic_a2d_out_mux(struct fpga_model* model, int y, int x,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_LOGIC, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -509,6 +1060,7 @@ int fdev_logic_a2d_cy0(struct fpga_model* model, int y, int x,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_LOGIC, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -528,6 +1080,7 @@ int fdev_logic_clk(struct fpga_model* model, int y, int x, int type_idx,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_LOGIC, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -547,6 +1100,7 @@ int fdev_logic_sync(struct fpga_model* model, int y, int x, int type_idx,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_LOGIC, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -565,6 +1119,7 @@ int fdev_logic_ce_used(struct fpga_model* model, int y, int x, int type_idx)
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_LOGIC, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -583,6 +1138,7 @@ int fdev_logic_sr_used(struct fpga_model* model, int y, int x, int type_idx)
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_LOGIC, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -602,6 +1158,7 @@ int fdev_logic_we_mux(struct fpga_model* model, int y, int x,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_LOGIC, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -621,6 +1178,7 @@ int fdev_logic_cout_used(struct fpga_model* model, int y, int x,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_LOGIC, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -640,6 +1198,7 @@ int fdev_logic_precyinit(struct fpga_model* model, int y, int x,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_LOGIC, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -698,6 +1257,7 @@ int fdev_iob_input(struct fpga_model* model, int y, int x, int type_idx,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_IOB, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -719,6 +1279,7 @@ int fdev_iob_output(struct fpga_model* model, int y, int x, int type_idx,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_IOB, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -752,6 +1313,7 @@ int fdev_iob_IMUX(struct fpga_model* model, int y, int x,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_IOB, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -771,6 +1333,7 @@ int fdev_iob_slew(struct fpga_model* model, int y, int x,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_IOB, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -790,6 +1353,7 @@ int fdev_iob_drive(struct fpga_model* model, int y, int x,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_IOB, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 
@@ -809,6 +1373,7 @@ int fdev_bufgmux(struct fpga_model *model, int y, int x,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_BUFGMUX, type_idx);
 	RC_ASSERT(model, dev);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) RC_FAIL(model, rc);
 
@@ -827,6 +1392,7 @@ int fdev_bscan(struct fpga_model *model, int y, int x, int type_idx,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, DEV_BSCAN, type_idx);
 	RC_ASSERT(model, dev);
+	journal_dev(model, y, x, dev);
 
 	dev->u.bscan.jtag_chain = jtag_chain;
 	dev->u.bscan.jtag_test = jtag_test;
@@ -843,6 +1409,7 @@ int fdev_set_required_pins(struct fpga_model* model, int y, int x, int type,
 	RC_CHECK(model);
 	dev = fdev_p(model, y, x, type, type_idx);
 	if (!dev) FAIL(EINVAL);
+	journal_dev(model, y, x, dev);
 	rc = reset_required_pins(dev);
 	if (rc) FAIL(rc);
 	if (type == DEV_LOGIC) {
@@ -937,6 +1504,7 @@ void fdev_delete(struct fpga_model* model, int y, int x, int type, int type_idx)
 	dev = fdev_p(model, y, x, type, type_idx);
 	if (!dev) { HERE(); return; }
 	if (!dev->instantiated) return;
+	journal_dev(model, y, x, dev);
 	free(dev->pinw_req_for_cfg);
 	dev->pinw_req_for_cfg = 0;
 	dev->pinw_req_total = 0;
@@ -952,12 +1520,10 @@ int fpga_connpt_find(struct fpga_model* model, int y, int x,
 	int i;
 
 	RC_CHECK(model);
+	MATERIALIZE_TILE(model, y, x);
 	tile = YX_TILE(model, y, x);
-	for (i = 0; i < tile->num_conn_point_names; i++) {
-		if (tile->conn_point_names[i*2+1] == name_i)
-			break;
-	}
-	if (i >= tile->num_conn_point_names) {
+	i = connpt_lookup(tile, name_i);
+	if (i == NO_CONN) {
 		fprintf(stderr, "#E %s:%i cannot find y%i x%i connpt %s\n",
 			__FILE__, __LINE__, y, x,
 			strarray_lookup(&model->str, name_i));
@@ -1000,6 +1566,7 @@ int fpga_find_conn(struct fpga_model* model, int search_y, int search_x,
 	int i, j, dests_end;
 
 	RC_CHECK(model);
+	MATERIALIZE_TILE(model, search_y, search_x);
 	tile = YX_TILE(model, search_y, search_x);
 	for (i = 0; i < tile->num_conn_point_names; i++) {
 		dests_end = (i < tile->num_conn_point_names-1)
@@ -1019,29 +1586,67 @@ int fpga_find_conn(struct fpga_model* model, int search_y, int search_x,
 
 }
 
+// sw_search() returns the first switch at or after search_beg from
+// or to connpt_o, or NO_SWITCH. Connpt names are unique in a tile,
+// so comparing the connpt is the same as comparing the name.
+static swidx_t sw_search(struct fpga_model* model, struct fpga_tile* tile,
+	int connpt_o, swidx_t search_beg, int from_to)
+{
+	const struct sw_index* index;
+	const uint16_t* list;
+	int len, lo, hi, mid, i;
+
+	index = tile_switch_index(model, tile);
+	if (!index) {
+		for (i = search_beg; i < tile->num_switches; i++) {
+			if (SW_I(tile->switches[i], from_to) == connpt_o)
+				return i;
+		}
+		return NO_SWITCH;
+	}
+	if (connpt_o >= index->num_connpts)
+		return NO_SWITCH;
+	if (from_to == SW_FROM) {
+		list = &index->from_sw[index->from_start[connpt_o]];
+		len = index->from_start[connpt_o+1] - index->from_start[connpt_o];
+	} else {
+		list = &index->to_sw[index->to_start[connpt_o]];
+		len = index->to_start[connpt_o+1] - index->to_start[connpt_o];
+	}
+	lo = 0;
+	hi = len;
+	while (lo < hi) {
+		mid = (lo+hi)/2;
+		if (list[mid] < search_beg)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	return (lo >= len) ? NO_SWITCH : list[lo];
+}
+
 swidx_t fpga_switch_first(struct fpga_model* model, int y, int x,
 	str16_t name_i, int from_to)
 {
 	struct fpga_tile* tile;
-	int i, connpt_o;
+	int connpt_o;
 
 	RC_CHECK(model);
 	// Finds the first switch either from or to the name given.
 	if (name_i == STRIDX_NO_ENTRY) { HERE(); return NO_SWITCH; }
+	MATERIALIZE_TILE(model, y, x);
 	tile = YX_TILE(model, y, x);
-	for (i = 0; i < tile->num_switches; i++) {
-		connpt_o = SW_I(tile->switches[i], from_to);
-		if (tile->conn_point_names[connpt_o*2+1] == name_i)
-			break;
-	}
-	return (i >= tile->num_switches) ? NO_SWITCH : i;
+	connpt_o = connpt_lookup(tile, name_i);
+	if (connpt_o == NO_CONN)
+		return NO_SWITCH;
+	return sw_search(model, tile, connpt_o, /*search_beg*/ 0, from_to);
 }
 
 static swidx_t fpga_switch_search(struct fpga_model* model, int y, int x,
 	swidx_t last, swidx_t search_beg, int from_to)
 {
 	struct fpga_tile* tile;
-	int connpt_o, name_i, i;
+	int connpt_o;
 
 	RC_CHECK(model);
 	tile = YX_TILE(model, y, x);
@@ -1051,14 +1656,7 @@ static swidx_t fpga_switch_search(struct fpga_model* model, int y, int x,
 		if (connpt_o == NO_CONN) { HERE(); return NO_SWITCH; }
 	} else
 		connpt_o = SW_I(tile->switches[last], from_to);
-	name_i = tile->conn_point_names[connpt_o*2+1];
-
-	for (i = search_beg; i < tile->num_switches; i++) {
-		connpt_o = SW_I(tile->switches[i], from_to);
-		if (tile->conn_point_names[connpt_o*2+1] == name_i)
-			break;
-	}
-	return (i >= tile->num_switches) ? NO_SWITCH : i;
+	return sw_search(model, tile, connpt_o, search_beg, from_to);
 }
 
 swidx_t fpga_switch_next(struct fpga_model* model, int y, int x,
@@ -1226,10 +1824,36 @@ fail:
 	return rc;
 }
 
+// index can be 0, the switches are then scanned.
+static swidx_t tile_switch_lookup(const struct fpga_tile* tile,
+	const struct sw_index* index, int from_connpt_o, int to_connpt_o)
+{
+	uint32_t pair;
+	int slot, i;
+
+	if (!index) {
+		for (i = 0; i < tile->num_switches; i++) {
+			if (SW_FROM_I(tile->switches[i]) == from_connpt_o
+			    && SW_TO_I(tile->switches[i]) == to_connpt_o)
+				return i;
+		}
+		return NO_SWITCH;
+	}
+	pair = (from_connpt_o << 15) | to_connpt_o;
+	slot = SW_PAIR_HASH(pair, index->pair_size);
+	while (index->pair_hash[slot]) {
+		i = index->pair_hash[slot]-1;
+		if ((tile->switches[i] & SW_PAIR_MASK) == pair)
+			return i;
+		slot = (slot+1) & (index->pair_size-1);
+	}
+	return NO_SWITCH;
+}
+
 swidx_t fpga_switch_lookup(struct fpga_model* model, int y, int x,
 	str16_t from_str_i, str16_t to_str_i)
 {
-	int from_connpt_o, to_connpt_o, i;
+	int from_connpt_o, to_connpt_o;
 	struct fpga_tile* tile;
 
 	from_connpt_o = fpga_connpt_find(model, y, x, from_str_i,
@@ -1238,14 +1862,135 @@ swidx_t fpga_switch_lookup(struct fpga_model* model, int y, int x,
 		/*dests_o*/ 0, /*num_dests*/ 0);
 	if (from_connpt_o == NO_CONN || to_connpt_o == NO_CONN)
 		return NO_SWITCH;
-
 	tile = YX_TILE(model, y, x);
-	for (i = 0; i < tile->num_switches; i++) {
-		if (SW_FROM_I(tile->switches[i]) == from_connpt_o
-		    && SW_TO_I(tile->switches[i]) == to_connpt_o)
-			return i;
+	return tile_switch_lookup(tile, tile_switch_index(model, tile),
+		from_connpt_o, to_connpt_o);
+}
+
+//
+// batch queries
+//
+
+// Returns the query indices grouped by tile in *order, with a
+// counting sort over the tiles so equal tiles keep the input order.
+// tiles[] holds y*x_width+x of each query, or -1 for queries outside
+// the chip. Those are sorted to the end.
+static int batch_order(struct fpga_model* model, const int* tiles,
+	int num_queries, int** order)
+{
+	int num_tiles, *counts, i;
+
+	RC_CHECK(model);
+	num_tiles = model->y_height * model->x_width;
+	*order = malloc((num_queries ? num_queries : 1) * sizeof(**order));
+	if (!(*order)) RC_FAIL(model, ENOMEM);
+	counts = calloc(num_tiles + 2, sizeof(*counts));
+	if (!counts) {
+		free(*order);
+		*order = 0;
+		RC_FAIL(model, ENOMEM);
+	}
+	for (i = 0; i < num_queries; i++)
+		counts[(tiles[i] == -1 ? num_tiles : tiles[i]) + 1]++;
+	for (i = 1; i <= num_tiles; i++)
+		counts[i] += counts[i-1];
+	for (i = 0; i < num_queries; i++)
+		(*order)[counts[tiles[i] == -1 ? num_tiles : tiles[i]]++] = i;
+	free(counts);
+	RC_RETURN(model);
+}
+
+static int batch_tile(struct fpga_model* model, int y, int x)
+{
+	if (y < 0 || y >= model->y_height || x < 0 || x >= model->x_width)
+		return -1;
+	return y*model->x_width + x;
+}
+
+int fpga_switch_lookup_batch(struct fpga_model* model,
+	struct sw_query* queries, int num_queries)
+{
+	const struct sw_index* index;
+	struct fpga_tile* tile;
+	struct sw_query* q;
+	int *tiles, *order, from_connpt_o, to_connpt_o, last_tile, i;
+
+	RC_CHECK(model);
+	tiles = malloc((num_queries ? num_queries : 1) * sizeof(*tiles));
+	if (!tiles) RC_FAIL(model, ENOMEM);
+	for (i = 0; i < num_queries; i++)
+		tiles[i] = batch_tile(model, queries[i].y, queries[i].x);
+	if (batch_order(model, tiles, num_queries, &order)) {
+		free(tiles);
+		RC_RETURN(model);
+	}
+	last_tile = -1;
+	tile = 0;
+	index = 0;
+	for (i = 0; i < num_queries; i++) {
+		q = &queries[order[i]];
+		q->sw = NO_SWITCH;
+		if (tiles[order[i]] == -1)
+			continue;
+		if (tiles[order[i]] != last_tile) {
+			last_tile = tiles[order[i]];
+			MATERIALIZE_TILE(model, q->y, q->x);
+			tile = YX_TILE(model, q->y, q->x);
+			index = tile_switch_index(model, tile);
+		}
+		from_connpt_o = connpt_lookup(tile, q->from);
+		to_connpt_o = connpt_lookup(tile, q->to);
+		if (from_connpt_o == NO_CONN || to_connpt_o == NO_CONN)
+			continue;
+		q->sw = tile_switch_lookup(tile, index, from_connpt_o,
+			to_connpt_o);
 	}
-	return NO_SWITCH;
+	free(order);
+	free(tiles);
+	RC_RETURN(model);
+}
+
+int fpga_connpt_find_batch(struct fpga_model* model,
+	struct connpt_query* queries, int num_queries)
+{
+	struct fpga_tile* tile;
+	struct connpt_query* q;
+	int *tiles, *order, last_tile, i;
+
+	RC_CHECK(model);
+	tiles = malloc((num_queries ? num_queries : 1) * sizeof(*tiles));
+	if (!tiles) RC_FAIL(model, ENOMEM);
+	for (i = 0; i < num_queries; i++)
+		tiles[i] = batch_tile(model, queries[i].y, queries[i].x);
+	if (batch_order(model, tiles, num_queries, &order)) {
+		free(tiles);
+		RC_RETURN(model);
+	}
+	last_tile = -1;
+	tile = 0;
+	for (i = 0; i < num_queries; i++) {
+		q = &queries[order[i]];
+		q->connpt = NO_CONN;
+		q->dests_o = 0;
+		q->num_dests = 0;
+		if (tiles[order[i]] == -1)
+			continue;
+		if (tiles[order[i]] != last_tile) {
+			last_tile = tiles[order[i]];
+			MATERIALIZE_TILE(model, q->y, q->x);
+			tile = YX_TILE(model, q->y, q->x);
+		}
+		q->connpt = connpt_lookup(tile, q->name);
+		if (q->connpt == NO_CONN)
+			continue;
+		q->dests_o = tile->conn_point_names[q->connpt*2];
+		q->num_dests = (q->connpt < tile->num_conn_point_names-1)
+			? tile->conn_point_names[(q->connpt+1)*2] - q->dests_o
+			: tile->num_conn_point_dests - q->dests_o;
+	}
+	free(order);
+	free(tiles);
+	RC_RETURN(model);
 }
 
 #define NUM_CONNPT_BUFS	64
@@ -1256,8 +2001,8 @@ static const char* connpt_str(struct fpga_model* model, int y, int x, int connpt
 	// We have a little local ringbuffer to make passing
 	// around pointers with unknown lifetime and possible
 	// overlap with writing functions more stable.
-	static char switch_get_buf[NUM_CONNPT_BUFS][CONNPT_BUF_SIZE];
-	static int last_buf = 0;
+	static __thread char switch_get_buf[NUM_CONNPT_BUFS][CONNPT_BUF_SIZE];
+	static __thread int last_buf = 0;
 
 	const char* hash_str;
 	int str_i;
@@ -1292,40 +2037,63 @@ str16_t fpga_switch_str_i(struct fpga_model* model, int y, int x,
 	return tile->conn_point_names[connpt_o*2+1];
 }
 
+// The _r functions print straight from the string array, which
+// does not move as long as nobody adds strings.
+static const char* connpt_name(struct fpga_model* model, int y, int x,
+	int connpt_o)
+{
+	return strarray_lookup(&model->str,
+		YX_TILE(model, y, x)->conn_point_names[connpt_o*2+1]);
+}
+
+const char* fpga_switch_print_r(struct fpga_model* model, int y, int x,
+	swidx_t swidx, char* buf, int buf_len)
+{
+	uint32_t sw;
+
+	sw = YX_TILE(model, y, x)->switches[swidx];
+	snprintf(buf, buf_len, "%s %s %s",
+		connpt_name(model, y, x, SW_FROM_I(sw)),
+		sw & SWITCH_BIDIRECTIONAL ? "<->" : "->",
+		connpt_name(model, y, x, SW_TO_I(sw)));
+	return buf;
+}
+
 const char* fpga_switch_print(struct fpga_model* model, int y, int x,
 	swidx_t swidx)
 {
  	enum { NUM_BUFS = 16, BUF_SIZE = 128 };
-	static char buf[NUM_BUFS][BUF_SIZE];
-	static int last_buf = 0;
-	uint32_t sw;
+	static __thread char buf[NUM_BUFS][BUF_SIZE];
+	static __thread int last_buf = 0;
 
-	sw = YX_TILE(model, y, x)->switches[swidx];
 	last_buf = (last_buf+1)%NUM_BUFS;
+	return fpga_switch_print_r(model, y, x, swidx,
+		buf[last_buf], sizeof(*buf));
+}
 
-	snprintf(buf[last_buf], sizeof(*buf), "%s %s %s",
-		connpt_str(model, y, x, SW_FROM_I(sw)),
-		sw & SWITCH_BIDIRECTIONAL ? "<->" : "->",
-		connpt_str(model, y, x, SW_TO_I(sw)));
-	return buf[last_buf];
+const char* fpga_switch_print_json_r(struct fpga_model* model, int y, int x,
+	swidx_t swidx, char* buf, int buf_len)
+{
+	uint32_t sw;
+
+	sw = YX_TILE(model, y, x)->switches[swidx];
+	snprintf(buf, buf_len, ", \"from\" : \"%s\", \"to\" : \"%s\"%s",
+		connpt_name(model, y, x, SW_FROM_I(sw)),
+		connpt_name(model, y, x, SW_TO_I(sw)),
+		sw & SWITCH_BIDIRECTIONAL ? ", \"bidir\" : true" : "");
+	return buf;
 }
 
 const char* fpga_switch_print_json(struct fpga_model* model, int y, int x,
 	swidx_t swidx)
 {
  	enum { NUM_BUFS = 16, BUF_SIZE = 128 };
-	static char buf[NUM_BUFS][BUF_SIZE];
-	static int last_buf = 0;
-	uint32_t sw;
+	static __thread char buf[NUM_BUFS][BUF_SIZE];
+	static __thread int last_buf = 0;
 
-	sw = YX_TILE(model, y, x)->switches[swidx];
 	last_buf = (last_buf+1)%NUM_BUFS;
-
-	snprintf(buf[last_buf], sizeof(*buf), ", \"from\" : \"%s\", \"to\" : \"%s\"%s",
-		connpt_str(model, y, x, SW_FROM_I(sw)),
-		connpt_str(model, y, x, SW_TO_I(sw)),
-		sw & SWITCH_BIDIRECTIONAL ? ", \"bidir\" : true" : "");
-	return buf[last_buf];
+	return fpga_switch_print_json_r(model, y, x, swidx,
+		buf[last_buf], sizeof(*buf));
 }
 
 int fpga_switch_is_bidir(struct fpga_model* model, int y, int x,
@@ -1343,7 +2111,17 @@ int fpga_switch_is_used(struct fpga_model* model, int y, int x,
 void fpga_switch_enable(struct fpga_model* model, int y, int x,
 	swidx_t swidx)
 {
-	YX_TILE(model, y, x)->switches[swidx] |= SWITCH_USED;
+	struct fpga_tile* tile = YX_TILE(model, y, x);
+
+	if (tile->switches[swidx] & SWITCH_USED)
+		return;
+	journal_switch(model, y, x, swidx);
+	if (tile_unshare_switches(tile)) {
+		RC_SET(model, ENOMEM);
+		return;
+	}
+	tile->switches[swidx] |= SWITCH_USED;
+	tile->num_used_switches++;
 }
 
 int fpga_switch_set_enable(struct fpga_model* model, int y, int x,
@@ -1358,36 +2136,76 @@ int fpga_switch_set_enable(struct fpga_model* model, int y, int x,
 void fpga_switch_disable(struct fpga_model* model, int y, int x,
 	swidx_t swidx)
 {
-	YX_TILE(model, y, x)->switches[swidx] &= ~SWITCH_USED;
-}
+	struct fpga_tile* tile = YX_TILE(model, y, x);
 
-#define SW_BUF_SIZE	256
-#define NUM_SW_BUFS	64
+	if (!(tile->switches[swidx] & SWITCH_USED))
+		return;
+	journal_switch(model, y, x, swidx);
+	// a clone shares the used switches of its model
+	if (tile_unshare_switches(tile)) {
+		RC_SET(model, ENOMEM);
+		return;
+	}
+	tile->switches[swidx] &= ~SWITCH_USED;
+	tile->num_used_switches--;
+}
 
-static const char* fmt_swset_el(struct fpga_model* model, int y, int x,
-	swidx_t sw, int from_to)
+// fmt_swset_el() prints only the destination side of the
+// switch (!from_to), because it is the significant one in
+// a chain of switches, and if the caller wants the source
+// side they can add it outside. Returns the number of
+// characters written, truncated to buf_len.
+static int fmt_swset_el(struct fpga_model* model, int y, int x,
+	swidx_t sw, int from_to, char* buf, int buf_len)
 {
-	static char sw_buf[NUM_SW_BUFS][SW_BUF_SIZE];
-	static int last_buf = 0;
-	char midstr[64];
+	uint32_t sw_val;
+	int len;
 
-	last_buf = (last_buf+1)%NUM_SW_BUFS;
-	if (fpga_switch_is_bidir(model, y, x, sw))
-		strcpy(midstr, "<->");
-	else
-		strcpy(midstr, "->");
-	// fmt_swset_el() prints only the destination side of the
-	// switch (!from_to), because it is the significant one in
-	// a chain of switches, and if the caller wants the source
-	// side they can add it outside.
-	snprintf(sw_buf[last_buf], sizeof(sw_buf[0]), "%s%s%s",
+	if (buf_len < 1) return 0;
+	sw_val = YX_TILE(model, y, x)->switches[sw];
+	len = snprintf(buf, buf_len, "%s%s%s",
 		(from_to == SW_FROM) ? ""
-			: fpga_switch_str(model, y, x, sw, SW_FROM),
-		midstr,
+			: connpt_name(model, y, x, SW_FROM_I(sw_val)),
+		(sw_val & SWITCH_BIDIRECTIONAL) ? "<->" : "->",
 		(from_to == SW_TO) ? ""
-			: fpga_switch_str(model, y, x, sw, SW_TO));
+			: connpt_name(model, y, x, SW_TO_I(sw_val)));
+	return len < buf_len ? len : buf_len-1;
+}
 
-	return sw_buf[last_buf];
+const char* fmt_swset_r(struct fpga_model* model, int y, int x,
+	struct sw_set* set, int from_to, char* buf, int buf_len)
+{
+	swidx_t sw0;
+	int i, o;
+
+	if (buf_len < 1) return buf;
+	o = 0;
+	buf[0] = 0;
+	if (!set->len)
+		return buf;
+	sw0 = YX_TILE(model, y, x)->switches[set->sw[0]];
+	if (from_to == SW_FROM) {
+		o += snprintf(buf, buf_len, "%s",
+			connpt_name(model, y, x, SW_FROM_I(sw0)));
+		for (i = 0; i < set->len && o < buf_len-1; i++) {
+			buf[o++] = ' ';
+			o += fmt_swset_el(model, y, x, set->sw[i], SW_FROM,
+				&buf[o], buf_len-o);
+		}
+	} else { // SW_TO
+		for (i = set->len-1; i >= 0 && o < buf_len-1; i--) {
+			if (i < set->len-1) buf[o++] = ' ';
+			o += fmt_swset_el(model, y, x, set->sw[i], SW_TO,
+				&buf[o], buf_len-o);
+		}
+		if (o < buf_len-1) {
+			buf[o++] = ' ';
+			snprintf(&buf[o], buf_len-o, "%s",
+				connpt_name(model, y, x, SW_TO_I(sw0)));
+		}
+	}
+	buf[buf_len-1] = 0;
+	return buf;
 }
 
 #define FMT_SWSET_BUF_SIZE	2048
@@ -1396,36 +2214,80 @@ static const char* fmt_swset_el(struct fpga_model* model, int y, int x,
 const char* fmt_swset(struct fpga_model* model, int y, int x,
 	struct sw_set* set, int from_to)
 {
-	static char buf[FMT_SWSET_NUM_BUFS][FMT_SWSET_BUF_SIZE];
-	static int last_buf = 0;
-	int i, o;
+	static __thread char buf[FMT_SWSET_NUM_BUFS][FMT_SWSET_BUF_SIZE];
+	static __thread int last_buf = 0;
 
 	last_buf = (last_buf+1)%FMT_SWSET_NUM_BUFS;
-	o = 0;
-	if (set->len) {
-		if (from_to == SW_FROM) {
-			strcpy(&buf[last_buf][o], fpga_switch_str(model, y, x, set->sw[0], SW_FROM));
-			o += strlen(&buf[last_buf][o]);
-			for (i = 0; i < set->len; i++) {
-				buf[last_buf][o++] = ' ';
-				strcpy(&buf[last_buf][o],
-					fmt_swset_el(model, y, x, set->sw[i], SW_FROM));
-				o += strlen(&buf[last_buf][o]);
-			}
-		} else { // SW_TO
-			for (i = set->len-1; i >= 0; i--) {
-				if (i < set->len-1) buf[last_buf][o++] = ' ';
-				strcpy(&buf[last_buf][o],
-					fmt_swset_el(model, y, x, set->sw[i], SW_TO));
-				o += strlen(&buf[last_buf][o]);
-			}
-			buf[last_buf][o++] = ' ';
-			strcpy(&buf[last_buf][o], fpga_switch_str(model, y, x, set->sw[0], SW_TO));
-			o += strlen(&buf[last_buf][o]);
+	return fmt_swset_r(model, y, x, set, from_to,
+		buf[last_buf], sizeof(*buf));
+}
+
+void fpga_swset_copy(struct sw_set* dest, const struct sw_set* src)
+{
+	memcpy(dest->sw, src->sw, src->len*sizeof(src->sw[0]));
+	dest->len = src->len;
+}
+
+// Switch enumerations nest only a few levels deep, so each thread
+// keeps up to BLOCK_LIST_POOL internal block lists for the next
+// chain instead of allocating one per chain.
+#define BLOCK_LIST_POOL	8
+
+struct block_list_pool
+{
+	int num;
+	swidx_t* lists[BLOCK_LIST_POOL];
+};
+
+static pthread_key_t s_block_list_key;
+static pthread_once_t s_block_list_once = PTHREAD_ONCE_INIT;
+
+static void block_list_pool_free(void* ptr)
+{
+	struct block_list_pool* pool = ptr;
+	int i;
+
+	for (i = 0; i < pool->num; i++)
+		free(pool->lists[i]);
+	free(pool);
+}
+
+static void block_list_key_init(void)
+{
+	if (pthread_key_create(&s_block_list_key, block_list_pool_free))
+		HERE();
+}
+
+static swidx_t* block_list_get(void)
+{
+	struct block_list_pool* pool;
+
+	pthread_once(&s_block_list_once, block_list_key_init);
+	pool = pthread_getspecific(s_block_list_key);
+	if (pool && pool->num)
+		return pool->lists[--pool->num];
+	return malloc(MAX_SWITCHBOX_SIZE * sizeof(swidx_t));
+}
+
+static void block_list_put(swidx_t* list)
+{
+	struct block_list_pool* pool;
+
+	if (!list) return;
+	pool = pthread_getspecific(s_block_list_key);
+	if (!pool) {
+		pool = calloc(1, sizeof(*pool));
+		if (!pool || pthread_setspecific(s_block_list_key, pool)) {
+			free(pool);
+			free(list);
+			return;
 		}
 	}
-	buf[last_buf][o] = 0;
-	return buf[last_buf];
+	if (pool->num >= BLOCK_LIST_POOL) {
+		free(list);
+		return;
+	}
+	pool->lists[pool->num++] = list;
 }
 
 int construct_sw_chain(struct sw_chain* chain, struct fpga_model* model,
@@ -1450,8 +2312,7 @@ int construct_sw_chain(struct sw_chain* chain, struct fpga_model* model,
 		chain->block_list_len = block_list_len;
 		// internal_block_list is 0 from memset()
 	} else {
-		chain->internal_block_list = malloc(
-			MAX_SWITCHBOX_SIZE * sizeof(*chain->block_list));
+		chain->internal_block_list = block_list_get();
 		if (!chain->internal_block_list)
 			RC_FAIL(model, ENOMEM);
 		chain->block_list = chain->internal_block_list;
@@ -1469,7 +2330,7 @@ int construct_sw_chain(struct sw_chain* chain, struct fpga_model* model,
 
 void destruct_sw_chain(struct sw_chain* chain)
 {
-	free(chain->internal_block_list);
+	block_list_put(chain->internal_block_list);
 	memset(chain, 0, sizeof(*chain));
 }
 
@@ -1692,6 +2553,198 @@ void destruct_sw_conns(struct sw_conns* conns)
 	memset(conns, 0, sizeof(*conns));
 }
 
+//
+// switch closures
+//
+
+// Publishing a closure is a write to a read-only model, as with
+// tile_switch_index(). Build with -DNO_SWITCH_CLOSURES to search
+// every time.
+static pthread_mutex_t s_closure_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define CLOSURE_PATHS_INCREMENT	1024
+
+// Enumerates all chains from from_connpt once, as a search for a
+// connpt that is never found would.
+static struct sw_closure* closure_build(struct fpga_model* model,
+	int y, int x, const struct sw_index* index, int from_connpt,
+	int max_depth)
+{
+	struct fpga_tile* tile;
+	struct sw_closure* closure;
+	struct sw_chain chain;
+	uint32_t* first_off;
+	uint16_t* paths;
+	void* new_ptr;
+	int num_words, num_reached, paths_len, paths_size, to, i;
+
+	tile = YX_TILE(model, y, x);
+	closure = 0;
+	paths = 0;
+	paths_len = 0;
+	paths_size = 0;
+	num_reached = 0;
+	first_off = malloc(index->num_connpts * sizeof(*first_off));
+	if (!first_off) return 0;
+	memset(first_off, 0xFF, index->num_connpts * sizeof(*first_off));
+	if (construct_sw_chain(&chain, model, y, x,
+		tile->conn_point_names[from_connpt*2+1], SW_FROM, max_depth,
+		NO_NET, /*block_list*/ 0, /*block_list_len*/ 0))
+		goto out;
+	while (fpga_switch_chain(&chain) != NO_CONN) {
+		to = SW_TO_I(tile->switches[chain.set.sw[chain.set.len-1]]);
+		if (first_off[to] != 0xFFFFFFFF)
+			continue;
+		if (paths_len + chain.set.len+1 > paths_size) {
+			paths_size += CLOSURE_PATHS_INCREMENT;
+			new_ptr = realloc(paths, paths_size*sizeof(*paths));
+			if (!new_ptr) {
+				destruct_sw_chain(&chain);
+				goto out;
+			}
+			paths = new_ptr;
+		}
+		first_off[to] = paths_len;
+		paths[paths_len++] = chain.set.len;
+		for (i = 0; i < chain.set.len; i++)
+			paths[paths_len++] = chain.set.sw[i];
+		num_reached++;
+	}
+	destruct_sw_chain(&chain);
+
+	// one block: struct, reach, path_off, rank, paths
+	num_words = (index->num_connpts+63)/64;
+	closure = calloc(1, sizeof(*closure) + num_words*sizeof(uint64_t)
+		+ num_reached*sizeof(uint32_t)
+		+ (num_words + paths_len)*sizeof(uint16_t));
+	if (!closure) goto out;
+	closure->from_connpt = from_connpt;
+	closure->max_depth = max_depth;
+	closure->reach = (uint64_t*) (closure+1);
+	closure->path_off = (uint32_t*) (closure->reach + num_words);
+	closure->rank = (uint16_t*) (closure->path_off + num_reached);
+	closure->paths = closure->rank + num_words;
+	if (paths_len)
+		memcpy(closure->paths, paths, paths_len*sizeof(*paths));
+	num_reached = 0;
+	for (i = 0; i < index->num_connpts; i++) {
+		if (!(i%64))
+			closure->rank[i/64] = num_reached;
+		if (first_off[i] == 0xFFFFFFFF)
+			continue;
+		closure->reach[i/64] |= 1ULL << (i%64);
+		closure->path_off[num_reached++] = first_off[i];
+	}
+out:
+	free(first_off);
+	free(paths);
+	return closure;
+}
+
+// Returns 0 if out of memory, callers then search the switchbox.
+static const struct sw_closure* closure_get(struct fpga_model* model,
+	int y, int x, struct sw_index* index, int from_connpt,
+	int max_depth)
+{
+	struct sw_closure* closure, *built;
+
+	pthread_mutex_lock(&s_closure_lock);
+	for (closure = index->closures; closure; closure = closure->next) {
+		if (closure->from_connpt == from_connpt
+		    && closure->max_depth == max_depth)
+			break;
+	}
+	pthread_mutex_unlock(&s_closure_lock);
+	if (closure)
+		return closure;
+
+	built = closure_build(model, y, x, index, from_connpt, max_depth);
+	if (!built) return 0;
+	pthread_mutex_lock(&s_closure_lock);
+	// another thread may have been faster
+	for (closure = index->closures; closure; closure = closure->next) {
+		if (closure->from_connpt == from_connpt
+		    && closure->max_depth == max_depth)
+			break;
+	}
+	if (closure)
+		free(built);
+	else {
+		built->next = index->closures;
+		index->closures = built;
+		closure = built;
+	}
+	pthread_mutex_unlock(&s_closure_lock);
+	return closure;
+}
+
+// A closure ignores used switches, so it holds for a search in a
+// tile without any, or whose used switches are all in
+// exclusive_net. Searches with NO_NET never look at them.
+static int closure_applies(struct fpga_model* model, int y, int x,
+	net_idx_t exclusive_net)
+{
+	struct fpga_tile* tile;
+	struct fpga_net* net;
+	int num_in_net, i;
+
+	tile = YX_TILE(model, y, x);
+	if (exclusive_net == NO_NET || !tile->num_used_switches)
+		return 1;
+	net = fnet_get(model, exclusive_net);
+	if (!net) return 0;
+	num_in_net = 0;
+	for (i = 0; i < net->len; i++) {
+		if (!(net->el[i].idx & NET_IDX_IS_PINW)
+		    && net->el[i].y == y && net->el[i].x == x)
+			num_in_net++;
+	}
+	return num_in_net == tile->num_used_switches;
+}
+
+// Returns 0 if the closure answered, and the set in sw_set.
+static int closure_lookup(struct fpga_model* model, int y, int x,
+	str16_t from_sw, str16_t to_sw, int max_depth,
+	net_idx_t exclusive_net, struct sw_set* sw_set)
+{
+	struct sw_index* index;
+	const struct sw_closure* closure;
+	const uint16_t* path;
+	uint64_t word;
+	int from_connpt, to_connpt, n, i;
+
+#ifdef NO_SWITCH_CLOSURES
+	return -1;
+#endif
+	if (!closure_applies(model, y, x, exclusive_net))
+		return -1;
+	index = (struct sw_index*) tile_switch_index(model, YX_TILE(model, y, x));
+	from_connpt = fpga_connpt_find(model, y, x, from_sw,
+		/*dests_o*/ 0, /*num_dests*/ 0);
+	if (!index || from_connpt == NO_CONN
+	    || from_connpt >= index->num_connpts)
+		return -1;
+	closure = closure_get(model, y, x, index, from_connpt,
+		max_depth < 0 ? SW_SET_SIZE : max_depth);
+	if (!closure) return -1;
+
+	sw_set->len = 0;
+	to_connpt = fpga_connpt_find(model, y, x, to_sw,
+		/*dests_o*/ 0, /*num_dests*/ 0);
+	if (to_connpt == NO_CONN || to_connpt >= index->num_connpts)
+		return 0;
+	word = closure->reach[to_connpt/64];
+	if (!(word & (1ULL << (to_connpt%64))))
+		return 0;
+	n = closure->rank[to_connpt/64] + __builtin_popcountll(word
+		& ((1ULL << (to_connpt%64)) - 1));
+	path = &closure->paths[closure->path_off[n]];
+	for (i = 0; i < path[0]; i++)
+		sw_set->sw[i] = path[1+i];
+	sw_set->len = path[0];
+	return 0;
+}
+
 int fpga_multi_switch_lookup(struct fpga_model *model, int y, int x,
 	str16_t from_sw, str16_t to_sw, int max_depth, net_idx_t exclusive_net,
 	struct sw_set *sw_set)
@@ -1699,6 +2752,10 @@ int fpga_multi_switch_lookup(struct fpga_model *model, int y, int x,
 	struct sw_chain sw_chain;
 
 	sw_set->len = 0;
+	RC_CHECK(model);
+	if (!closure_lookup(model, y, x, from_sw, to_sw, max_depth,
+		exclusive_net, sw_set))
+		RC_RETURN(model);
 	construct_sw_chain(&sw_chain, model, y, x, from_sw, SW_FROM, max_depth,
 		exclusive_net, /*block_list*/ 0, /*block_list_len*/ 0);
 	RC_CHECK(model);
@@ -1707,7 +2764,7 @@ int fpga_multi_switch_lookup(struct fpga_model *model, int y, int x,
 		RC_ASSERT(model, sw_chain.set.len);
 		if (fpga_switch_str_i(model, y, x, sw_chain.set.sw[sw_chain.set.len-1],
 			SW_TO) == to_sw) {
-			*sw_set = sw_chain.set;
+			fpga_swset_copy(sw_set, &sw_chain.set);
 			break;
 		}
 	}
@@ -1782,7 +2839,7 @@ int fpga_first_conn(struct fpga_model *model, int sw_y, int sw_x, str16_t sw_str
 	if (fpga_switch_conns(&sw_conns) == NO_CONN)
 		RC_FAIL(model, EINVAL);
 
-	*sw_set = sw_conns.chain.set;
+	fpga_swset_copy(sw_set, &sw_conns.chain.set);
 	*dest_y = sw_conns.dest_y;
 	*dest_x = sw_conns.dest_x;
 	*dest_connpt = sw_conns.dest_str_i;
@@ -1871,7 +2928,7 @@ int fpga_switch_to_yx(struct switch_to_yx* p)
 			else if (conns.chain.set.len > best_set.len)
 				continue;
 		}
-		best_set = conns.chain.set;
+		fpga_swset_copy(&best_set, &conns.chain.set);
 		best_y = conns.dest_y;
 		best_x = conns.dest_x;
 		best_num_dests = conns.num_dests;
@@ -1884,7 +2941,7 @@ int fpga_switch_to_yx(struct switch_to_yx* p)
 	if (best_y == -1)
 		p->set.len = 0;
 	else {
-		p->set = best_set;
+		fpga_swset_copy(&p->set, &best_set);
 		p->dest_y = best_y;
 		p->dest_x = best_x;
 		p->dest_connpt = best_connpt;
@@ -1925,11 +2982,11 @@ int fpga_switch_to_yx_l2(struct switch_to_yx_l2 *p)
 			fpga_switch_to_yx(&l2);
 			RC_CHECK(l2.model);
 			if (l2.set.len) {
-				p->l1.set = conns.chain.set;
+				fpga_swset_copy(&p->l1.set, &conns.chain.set);
 				p->l1.dest_y = l2.dest_y;
 				p->l1.dest_x = l2.dest_x;
 				p->l1.dest_connpt = l2.dest_connpt;
-				p->l2_set = l2.set;
+				fpga_swset_copy(&p->l2_set, &l2.set);
 				p->l2_y = l2.y;
 				p->l2_x = l2.x;
 				break;
@@ -1988,7 +3045,7 @@ int fpga_switch_to_rel(struct switch_to_rel *p)
 				if (distance > best_distance)
 					continue;
 			}
-			best_set = conns.chain.set;
+			fpga_swset_copy(&best_set, &conns.chain.set);
 			best_y = conns.dest_y;
 			best_x = conns.dest_x;
 			best_connpt = conns.dest_str_i;
@@ -1999,7 +3056,7 @@ int fpga_switch_to_rel(struct switch_to_rel *p)
 		if (p->target_connpt != STRIDX_NO_ENTRY
 		    && conns.dest_str_i != p->target_connpt)
 			continue;
-		best_set = conns.chain.set;
+		fpga_swset_copy(&best_set, &conns.chain.set);
 		best_y = conns.dest_y;
 		best_x = conns.dest_x;
 		best_connpt = conns.dest_str_i;
@@ -2014,7 +3071,7 @@ int fpga_switch_to_rel(struct switch_to_rel *p)
 		printf(" dest y%i-x%i-%s\n", best_y, best_x,
 			strarray_lookup(&p->model->str, best_connpt));
 #endif
-		p->set = best_set;
+		fpga_swset_copy(&p->set, &best_set);
 		p->dest_y = best_y;
 		p->dest_x = best_x;
 		p->dest_connpt = best_connpt;
@@ -2047,10 +3104,17 @@ static int fnet_useidx(struct fpga_model* model, net_idx_t new_idx)
 	if (new_idx > model->highest_used_net)
 		model->highest_used_net = new_idx;
 
-	if ((new_idx-1) < model->nets_array_size)
+	if ((new_idx-1) < model->nets_array_size) {
+		model->nets[new_idx-1].is_deleted = 0;
 		return 0;
+	}
 
-	new_array_size = ((new_idx-1)/NET_ALLOC_INCREMENT+1)*NET_ALLOC_INCREMENT;
+	// the nets only hold a pointer to their elements, so
+	// grow by doubling
+	new_array_size = model->nets_array_size
+		? model->nets_array_size*2 : NET_ALLOC_INCREMENT;
+	if (new_array_size < new_idx)
+		new_array_size = ((new_idx-1)/NET_ALLOC_INCREMENT+1)*NET_ALLOC_INCREMENT;
 	new_ptr = realloc(model->nets, new_array_size*sizeof(*model->nets));
 	if (!new_ptr) RC_FAIL(model, ENOMEM);
 	// the memset will set the 'len' of each new net to 0
@@ -2062,15 +3126,35 @@ static int fnet_useidx(struct fpga_model* model, net_idx_t new_idx)
 	RC_RETURN(model);
 }
 
+// Returns a deleted net id, or NO_NET. Ids that were reused
+// since they were deleted are dropped.
+static net_idx_t free_net_pop(struct fpga_model* model)
+{
+	net_idx_t net_idx;
+
+	while (model->num_free_nets) {
+		net_idx = model->free_nets[--model->num_free_nets];
+		if (net_idx-1 < model->nets_array_size
+		    && model->nets[net_idx-1].is_deleted)
+			return net_idx;
+	}
+	return NO_NET;
+}
+
 int fnet_new(struct fpga_model* model, net_idx_t* new_idx)
 {
+	net_idx_t net_idx;
 	int rc;
 
 	RC_CHECK(model);
+	net_idx = free_net_pop(model);
 	// highest_used_net is initialized to NO_NET which becomes 1
-	rc = fnet_useidx(model, model->highest_used_net+1);
+	if (net_idx == NO_NET)
+		net_idx = model->highest_used_net+1;
+	journal_net(model, net_idx);
+	rc = fnet_useidx(model, net_idx);
 	if (rc) return rc;
-	*new_idx = model->highest_used_net;
+	*new_idx = net_idx;
 	return 0;
 }
 
@@ -2079,6 +3163,7 @@ void fnet_delete(struct fpga_model* model, net_idx_t net_idx)
 	struct fpga_net* net;
 	int i;
 
+	journal_net(model, net_idx);
 	net = &model->nets[net_idx-1];
 	for (i = 0; i < net->len; i++) {
 		if (net->el[i].idx & NET_IDX_IS_PINW)
@@ -2088,8 +3173,14 @@ void fnet_delete(struct fpga_model* model, net_idx_t net_idx)
 			HERE();
 		fpga_switch_disable(model, net->el[i].y, net->el[i].x,
 			net->el[i].idx);
+		sw_owner_clear(model, net->el[i].y, net->el[i].x,
+			net->el[i].idx);
+	}
+	net_release(model, net);
+	if (!net->is_deleted) {
+		net->is_deleted = 1;
+		free_net_push(model, net_idx);
 	}
-	model->nets[net_idx-1].len = 0;
 	if (model->highest_used_net == net_idx)
 		model->highest_used_net--;
 }
@@ -2124,39 +3215,68 @@ struct fpga_net* fnet_get(struct fpga_model* model, net_idx_t net_i)
 
 void fnet_free_all(struct fpga_model* model)
 {
+	sw_owners_free(model);
+	net_pool_free(model);
 	free(model->nets);
 	model->nets = 0;
 	model->nets_array_size = 0;
 	model->highest_used_net = 0;
+	free(model->free_nets);
+	model->free_nets = 0;
+	model->num_free_nets = 0;
+	model->free_nets_size = 0;
+}
+
+int fnet_copy_all(struct fpga_model* model, const struct fpga_model* src)
+{
+	int i;
+
+	RC_CHECK(model);
+	fnet_free_all(model);
+	if (src->nets_array_size) {
+		model->nets = calloc(src->nets_array_size, sizeof(*model->nets));
+		if (!model->nets) RC_FAIL(model, ENOMEM);
+		model->nets_array_size = src->nets_array_size;
+	}
+	model->highest_used_net = src->highest_used_net;
+	for (i = 0; i < src->nets_array_size; i++) {
+		model->nets[i].is_deleted = src->nets[i].is_deleted;
+		if (!src->nets[i].len)
+			continue;
+		if (net_reserve(model, &model->nets[i], src->nets[i].len))
+			RC_RETURN(model);
+		memcpy(model->nets[i].el, src->nets[i].el,
+			src->nets[i].len*sizeof(*model->nets[i].el));
+		model->nets[i].len = src->nets[i].len;
+	}
+	if (src->num_free_nets) {
+		model->free_nets = malloc(src->num_free_nets
+			*sizeof(*model->free_nets));
+		if (!model->free_nets) RC_FAIL(model, ENOMEM);
+		memcpy(model->free_nets, src->free_nets,
+			src->num_free_nets*sizeof(*model->free_nets));
+		model->num_free_nets = src->num_free_nets;
+		model->free_nets_size = src->num_free_nets;
+	}
+	for (i = 1; i <= model->highest_used_net; i++)
+		net_sw_owners(model, i, /*add*/ 1);
+	RC_RETURN(model);
 }
 
 int fpga_swset_in_other_net(struct fpga_model *model, int y, int x,
 	const swidx_t* sw, int len, net_idx_t our_net)
 {
-	struct fpga_net* net_p;
-	int i, j;
+	int i;
 
-	net_p = fnet_get(model, our_net);
-	if (!net_p) {
+	if (!fnet_get(model, our_net)) {
 		fprintf(stderr ,"#E %s:%i cannot find our_net %i\n",
 			__FILE__, __LINE__, our_net);
 		return 0;
 	}
 	for (i = 0; i < len; i++) {
-		if (!fpga_switch_is_used(model, y, x, sw[i]))
-			continue;
-		for (j = 0; j < net_p->len; j++) {
-			if (net_p->el[j].idx & NET_IDX_IS_PINW)
-				continue;
-			if (net_p->el[j].y == y
-			    && net_p->el[j].x == x
-			    && net_p->el[j].idx == sw[i])
-				break;
-		}
-		if (j >= net_p->len) {
-			// switch must be in other net
+		if (fpga_switch_is_used(model, y, x, sw[i])
+		    && fpga_switch_net(model, y, x, sw[i]) != our_net)
 			return 1;
-		}
 	}
 	return 0;
 }
@@ -2168,11 +3288,13 @@ int fnet_add_port(struct fpga_model* model, net_idx_t net_i,
 	struct fpga_net* net;
 	dev_idx_t dev_idx;
 
+	journal_net(model, net_i);
 	fnet_useidx(model, net_i);
 	RC_CHECK(model);
 	
 	net = &model->nets[net_i-1];
-	RC_ASSERT(model, net->len < MAX_NET_LEN);
+	if (net_reserve(model, net, net->len+1))
+		RC_RETURN(model);
 
 	net->el[net->len].y = y;
 	net->el[net->len].x = x;
@@ -2189,8 +3311,9 @@ int fnet_add_sw(struct fpga_model* model, net_idx_t net_i,
 	int y, int x, const swidx_t* switches, int num_sw)
 {
 	struct fpga_net* net;
-	int i, j;
+	int i;
 
+	journal_net(model, net_i);
 	fnet_useidx(model, net_i);
 	RC_CHECK(model);
 
@@ -2200,21 +3323,17 @@ int fnet_add_sw(struct fpga_model* model, net_idx_t net_i,
 		RC_FAIL(model, EINVAL);
 
 	net = &model->nets[net_i-1];
+	if (net_reserve(model, net, net->len+num_sw))
+		RC_RETURN(model);
 	for (i = 0; i < num_sw; i++) {
 		if (switches[i] == NO_SWITCH)
 			{ HERE(); continue; }
 
 		// check whether the switch is already in the net
-		for (j = 0; j < net->len; j++) {
-			if (net->el[j].y == y
-			    && net->el[j].x == x
-			    && net->el[j].idx == switches[i])
-				break;
-		}
-		if (j < net->len) continue;
+		if (fpga_switch_net(model, y, x, switches[i]) == net_i)
+			continue;
 
 		// add the switch
-		RC_ASSERT(model, net->len < MAX_NET_LEN);
 		net->el[net->len].y = y;
 		net->el[net->len].x = x;
 		RC_ASSERT(model, !OUT_OF_U16(switches[i]));
@@ -2223,6 +3342,7 @@ int fnet_add_sw(struct fpga_model* model, net_idx_t net_i,
 		fpga_switch_enable(model, y, x, switches[i]);
 		net->el[net->len].idx = switches[i];
 		net->len++;
+		sw_owner_set(model, y, x, switches[i], net_i);
 	}
 	RC_RETURN(model);
 }
@@ -2232,6 +3352,7 @@ static void _fnet_remove_sw(struct fpga_model *model, struct fpga_net *net_p, in
 	if (!fpga_switch_is_used(model, net_p->el[i].y, net_p->el[i].x, net_p->el[i].idx))
 		HERE();
 	fpga_switch_disable(model, net_p->el[i].y, net_p->el[i].x, net_p->el[i].idx);
+	sw_owner_clear(model, net_p->el[i].y, net_p->el[i].x, net_p->el[i].idx);
 	if (net_p->len > i+1)
 		memmove(&net_p->el[i], &net_p->el[i+1],
 			(net_p->len-i-1)*sizeof(net_p->el[0]));
@@ -2246,6 +3367,7 @@ int fnet_remove_sw(struct fpga_model* model, net_idx_t net_i,
 
 	RC_CHECK(model);
 	RC_ASSERT(model, net_i <= model->highest_used_net);
+	journal_net(model, net_i);
 	net = &model->nets[net_i-1];
 	if (!net->len) {
 		HERE();
@@ -2277,7 +3399,9 @@ int fnet_remove_all_sw(struct fpga_model* model, net_idx_t net_i)
 	RC_CHECK(model);
 	net_p = fnet_get(model, net_i);
 	RC_ASSERT(model, net_p);
-	for (i = 0; i < net_p->len; i++) {
+	journal_net(model, net_i);
+	// backwards, _fnet_remove_sw() moves the following elements
+	for (i = net_p->len-1; i >= 0; i--) {
 		if (net_p->el[i].idx & NET_IDX_IS_PINW)
 			continue;
 		_fnet_remove_sw(model, net_p, i);
@@ -2409,9 +3533,10 @@ static int fpga_switch_2sets(struct fpga_model* model, int from_y, int from_x,
 			if (conns.dest_str_i != fpga_switch_str_i(model, to_y,
 			    to_x, to_switches.sw[i], SW_FROM))
 				continue;
-			*from_set = conns.chain.set;
+			fpga_swset_copy(from_set, &conns.chain.set);
 			to_set->len = 1;
 			to_set->sw[0] = to_switches.sw[i];
+			destruct_sw_conns(&conns);
 			RC_RETURN(model);
 		}
 	}
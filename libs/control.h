@@ -5,6 +5,17 @@
 // For details see the UNLICENSE file at the root of the source tree.
 //
 
+//
+// Threads: all functions here that only look at the model (lookups,
+// enumeration, fpga_switch_first/next, construct_sw_chain, the *_str
+// and print functions) can be called from several threads at once,
+// as long as no thread changes the model at the same time. A lazily
+// built model (fpga_set_lazy_build) must first be materialized with
+// MATERIALIZE_ALL(), because looking at a tile adds its switches.
+// Functions that return a string use a per-thread ring buffer, the
+// _r variants write into a buffer of the caller instead.
+//
+
 typedef int net_idx_t; // net indices are 1-based
 #define NO_NET 0
 
@@ -116,6 +127,19 @@ void fdev_print_required_pins(struct fpga_model* model, int y, int x,
 void fdev_delete(struct fpga_model* model, int y, int x, int type,
 	int type_idx);
 
+// Between fpga_journal_begin() and the matching rollback or commit,
+// switch, net and device changes made through the functions in
+// this file are recorded. fpga_journal_rollback() restores the
+// model to the savepoint, fpga_journal_commit() keeps the changes.
+// Savepoints can nest, an outer rollback also undoes committed inner
+// changes. A rollback also works after a change failed and set
+// model->rc, and clears rc again. Only if the journal itself ran out
+// of memory the model keeps its error.
+int fpga_journal_begin(struct fpga_model* model, int* savepoint);
+int fpga_journal_rollback(struct fpga_model* model, int savepoint);
+int fpga_journal_commit(struct fpga_model* model, int savepoint);
+void fpga_journal_free(struct fpga_model* model);
+
 // Returns the connpt index or NO_CONN if the name was not
 // found. connpt_dests_o and num_dests are optional and may
 // return the offset into the connpt's destination array
@@ -149,6 +173,10 @@ struct sw_set
 	int len;
 };
 
+// fpga_swset_copy() copies only the len used switches. Iterators
+// return their sets in place, callers that keep one copy it.
+void fpga_swset_copy(struct sw_set* dest, const struct sw_set* src);
+
 // returns a switch index, or -1 (NO_SWITCH) if no switch was found
 swidx_t fpga_switch_first(struct fpga_model* model, int y, int x,
 	str16_t name_i, int from_to);
@@ -186,14 +214,51 @@ int fpga_switch_same_fromto(struct fpga_model* model, int y, int x,
 swidx_t fpga_switch_lookup(struct fpga_model* model, int y, int x,
 	str16_t from_str_i, str16_t to_str_i);
 
+//
+// The batch functions answer many queries at once. They work through
+// the queries tile by tile, so each tile is materialized and its
+// switch index found once, and write each result into its query.
+// Queries that are not found get NO_SWITCH or NO_CONN. Unlike
+// fpga_switch_lookup() and fpga_connpt_find(), which print a #E for a
+// missing connpt, the batches report nothing, so callers that want
+// the diagnostics repeat the single lookup for the misses.
+//
+
+struct sw_query
+{
+	int y, x;
+	str16_t from, to;
+	swidx_t sw; // result
+};
+
+int fpga_switch_lookup_batch(struct fpga_model* model,
+	struct sw_query* queries, int num_queries);
+
+struct connpt_query
+{
+	int y, x;
+	str16_t name;
+	// results: connpt and, as with fpga_connpt_find(),
+	// the first of num_dests destinations for fpga_conn_dest()
+	int connpt;
+	int dests_o, num_dests;
+};
+
+int fpga_connpt_find_batch(struct fpga_model* model,
+	struct connpt_query* queries, int num_queries);
+
 const char* fpga_switch_str(struct fpga_model* model, int y, int x,
 	swidx_t swidx, int from_to);
 str16_t fpga_switch_str_i(struct fpga_model* model, int y, int x,
 	swidx_t swidx, int from_to);
 const char* fpga_switch_print_json(struct fpga_model* model, int y, int x,
 	swidx_t swidx);
+const char* fpga_switch_print_json_r(struct fpga_model* model, int y, int x,
+	swidx_t swidx, char* buf, int buf_len);
 const char* fpga_switch_print(struct fpga_model* model, int y, int x,
 	swidx_t swidx);
+const char* fpga_switch_print_r(struct fpga_model* model, int y, int x,
+	swidx_t swidx, char* buf, int buf_len);
 int fpga_switch_is_bidir(struct fpga_model* model, int y, int x,
 	swidx_t swidx);
 int fpga_switch_is_used(struct fpga_model* model, int y, int x,
@@ -207,6 +272,8 @@ void fpga_switch_disable(struct fpga_model* model, int y, int x,
 
 const char* fmt_swset(struct fpga_model* model, int y, int x,
 	struct sw_set* set, int from_to);
+const char* fmt_swset_r(struct fpga_model* model, int y, int x,
+	struct sw_set* set, int from_to, char* buf, int buf_len);
 
 // MAX_SWITCHBOX_SIZE can be used to allocate the block
 // list and should be larger than the largest known number
@@ -255,6 +322,12 @@ void destruct_sw_chain(struct sw_chain* chain);
 // set.len is 0 when there are no more switches in the tree
 int fpga_switch_chain(struct sw_chain* chain);
 
+// fpga_multi_switch_lookup() returns the first chain from from_sw to
+// to_sw that fpga_switch_chain() would. Tiles with the same switch
+// index share which connpts each from_sw reaches and the first chain
+// to each (struct sw_closure), so after the first lookup from a
+// connpt, the others only check the used switches of the tile.
+// Tiles with switches used outside of exclusive_net are searched.
 int fpga_multi_switch_lookup(struct fpga_model *model, int y, int x,
 	str16_t from_sw, str16_t to_sw, int max_depth, net_idx_t exclusive_net,
 	struct sw_set *sw_set);
@@ -367,10 +440,9 @@ void printf_switch_to_rel_result(struct switch_to_rel* p);
 
 // The last m1 soc has about 20k nets with about 470k
 // connection points. The largest net has about 110
-// connection points. For now we work with a simple
-// fixed-size array, we can later make this more dynamic
-// depending on which load on the memory manager is better.
-#define MAX_NET_LEN	128
+// connection points. Net elements are kept in arrays
+// of power-of-two sizes taken from a per-model pool,
+// so small nets stay small and nets can have any length.
 
 #define NET_IDX_IS_PINW	0x8000
 #define NET_IDX_MASK	0x7FFF
@@ -389,7 +461,10 @@ struct net_el
 struct fpga_net
 {
 	int len;
-	struct net_el el[MAX_NET_LEN];
+	int size; // room in el, 0 if el is not allocated
+	struct net_el* el;
+	// deleted nets are reused by fnet_new()
+	int is_deleted;
 };
 
 int fnet_new(struct fpga_model* model, net_idx_t* new_idx);
@@ -398,7 +473,14 @@ void fnet_delete(struct fpga_model* model, net_idx_t net_idx);
 int fnet_enum(struct fpga_model* model, net_idx_t last, net_idx_t* next);
 struct fpga_net* fnet_get(struct fpga_model* model, net_idx_t net_i);
 void fnet_free_all(struct fpga_model* model);
+// fnet_copy_all() replaces the nets of model with a copy of src's nets
+int fnet_copy_all(struct fpga_model* model, const struct fpga_model* src);
 
+// fpga_switch_net() returns the net a switch was added to, or NO_NET.
+net_idx_t fpga_switch_net(struct fpga_model* model, int y, int x,
+	swidx_t swidx);
+// fpga_swset_in_other_net() returns 1 if any of the switches is used
+// and not in our_net, also if it is used outside of any net.
 int fpga_swset_in_other_net(struct fpga_model *model, int y, int x,
 	const swidx_t* sw, int len, net_idx_t our_net);
 
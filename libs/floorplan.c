@@ -33,8 +33,8 @@ int printf_tiles(FILE* f, struct fpga_model* model)
 			if (tile->type != NA)
 				fprintf(f, "tile y%i x%i name %s\n", y, x,
 					fpga_tiletype_str(tile->type));
-			if (tile->flags) {
-				int tf = tile->flags;
+			if (tile->flags & ~TF_SHARED_MASK) {
+				int tf = tile->flags & ~TF_SHARED_MASK;
 				fprintf(f, "tile y%i x%i flags", y, x);
 
 				PRINT_FLAG(f, TF_FABRIC_ROUTING_COL);
@@ -1175,6 +1175,7 @@ int printf_ports(FILE* f, struct fpga_model* model)
 	int first_port_printed;
 
 	RC_CHECK(model);
+	MATERIALIZE_ALL(model);
 	for (x = 0; x < model->x_width; x++) {
 		for (y = 0; y < model->y_height; y++) {
 			tile = &model->tiles[y*model->x_width + x];
@@ -1217,6 +1218,7 @@ int printf_conns(FILE* f, struct fpga_model* model)
 	int other_tile_x, other_tile_y, first_conn_printed;
 
 	RC_CHECK(model);
+	MATERIALIZE_ALL(model);
 	for (x = 0; x < model->x_width; x++) {
 		for (y = 0; y < model->y_height; y++) {
 			tile = &model->tiles[y*model->x_width + x];
@@ -1273,6 +1275,7 @@ int printf_switches(FILE* f, struct fpga_model* model)
 	int x, y, i, first_switch_printed;
 
 	RC_CHECK(model);
+	MATERIALIZE_ALL(model);
 	for (x = 0; x < model->x_width; x++) {
 		for (y = 0; y < model->y_height; y++) {
 			tile = YX_TILE(model, y, x);
@@ -1333,7 +1336,96 @@ fail:
 	return rc;
 }
 
-static void read_net_line(struct fpga_model* model, const char* line, int start)
+// Net lines are parsed first and added to the model in batches,
+// so that the switches of all lines are looked up tile by tile.
+struct net_line
+{
+	net_idx_t net_idx;
+	int y, x;
+	// switch: index into net_lines.sw, port: -1
+	int sw_q;
+	int is_bidir;
+	enum fpgadev_type dev_type;
+	int dev_type_idx;
+	pinw_idx_t pinw_idx;
+};
+
+struct net_lines
+{
+	int num_lines, num_sw;
+	struct net_line* lines;
+	struct sw_query* sw;
+};
+
+#define NET_LINES_INCREMENT	1024
+
+static struct net_line* net_line_add(struct fpga_model* model,
+	struct net_lines* nl, int is_sw)
+{
+	void* new_ptr;
+
+	if (!(nl->num_lines % NET_LINES_INCREMENT)) {
+		new_ptr = realloc(nl->lines, (nl->num_lines
+			+ NET_LINES_INCREMENT) * sizeof(*nl->lines));
+		if (!new_ptr) { RC_SET(model, ENOMEM); return 0; }
+		nl->lines = new_ptr;
+	}
+	if (is_sw && !(nl->num_sw % NET_LINES_INCREMENT)) {
+		new_ptr = realloc(nl->sw, (nl->num_sw + NET_LINES_INCREMENT)
+			* sizeof(*nl->sw));
+		if (!new_ptr) { RC_SET(model, ENOMEM); return 0; }
+		nl->sw = new_ptr;
+	}
+	nl->lines[nl->num_lines].sw_q = is_sw ? nl->num_sw++ : -1;
+	return &nl->lines[nl->num_lines++];
+}
+
+// The lines are dropped whether they could be added or not.
+static void add_net_lines(struct fpga_model* model, struct net_lines* nl)
+{
+	struct net_line* line;
+	struct sw_query* q;
+	int i;
+
+	if (fpga_switch_lookup_batch(model, nl->sw, nl->num_sw)) {
+		HERE();
+		nl->num_lines = 0;
+		nl->num_sw = 0;
+		return;
+	}
+	for (i = 0; i < nl->num_lines; i++) {
+		line = &nl->lines[i];
+		if (line->sw_q == -1) {
+			if (fnet_add_port(model, line->net_idx, line->y,
+				line->x, line->dev_type, line->dev_type_idx,
+				line->pinw_idx))
+				HERE();
+			continue;
+		}
+		q = &nl->sw[line->sw_q];
+		if (q->sw == NO_SWITCH) {
+			// The batch is silent about missing connpts, the
+			// single lookup prints which one is missing.
+			fpga_switch_lookup(model, q->y, q->x, q->from, q->to);
+			HERE();
+			continue;
+		}
+		if (line->is_bidir != fpga_switch_is_bidir(model, q->y, q->x,
+			q->sw)) {
+			HERE();
+			continue;
+		}
+		if (fpga_switch_is_used(model, q->y, q->x, q->sw))
+			HERE();
+		if (fnet_add_sw(model, line->net_idx, q->y, q->x, &q->sw, 1))
+			HERE();
+	}
+	nl->num_lines = 0;
+	nl->num_sw = 0;
+}
+
+static void read_net_line(struct fpga_model* model, const char* line,
+	int start, struct net_lines* nl)
 {
 	int coord_end, y_coord, x_coord;
 	int from_beg, from_end, from_str_i;
@@ -1346,7 +1438,7 @@ static void read_net_line(struct fpga_model* model, const char* line, int start)
 	char buf[1024];
 	net_idx_t net_idx;
 	pinw_idx_t pinw_idx;
-	int sw_is_bidir;
+	struct net_line* net_line;
 
 	// net lines will be one of the following three types:
 	// in-port:  net 1 in y68 x13 LOGIC 1 pin D3
@@ -1363,8 +1455,6 @@ static void read_net_line(struct fpga_model* model, const char* line, int start)
 
 	next_word(line, net_idx_end, &el_type_beg, &el_type_end);
 	if (!str_cmp(&line[el_type_beg], el_type_end-el_type_beg, "sw", 2)) {
-		struct sw_set sw;
-
 		if (coord(line, el_type_end, &coord_end, &y_coord, &x_coord))
 			return;
 
@@ -1402,22 +1492,21 @@ static void read_net_line(struct fpga_model* model, const char* line, int start)
 			return;
 		}
 
-		sw.sw[0] = fpga_switch_lookup(model, y_coord, x_coord, from_str_i, to_str_i);
-		if (sw.sw[0] == NO_SWITCH) {
-			HERE();
-			return;
-		}
-		sw_is_bidir = fpga_switch_is_bidir(model, y_coord, x_coord, sw.sw[0]);
-		if ((is_bidir && !sw_is_bidir)
-		    || (!is_bidir && sw_is_bidir)) {
+		if (y_coord < 0 || y_coord >= model->y_height
+		    || x_coord < 0 || x_coord >= model->x_width) {
 			HERE();
 			return;
 		}
-		if (fpga_switch_is_used(model, y_coord, x_coord, sw.sw[0]))
-			HERE();
-		sw.len = 1;
-		if (fnet_add_sw(model, net_idx, y_coord, x_coord, sw.sw, sw.len))
-			HERE();
+		net_line = net_line_add(model, nl, /*is_sw*/ 1);
+		if (!net_line) return;
+		net_line->net_idx = net_idx;
+		net_line->y = y_coord;
+		net_line->x = x_coord;
+		net_line->is_bidir = is_bidir;
+		nl->sw[net_line->sw_q].y = y_coord;
+		nl->sw[net_line->sw_q].x = x_coord;
+		nl->sw[net_line->sw_q].from = from_str_i;
+		nl->sw[net_line->sw_q].to = to_str_i;
 		return;
 	}
 
@@ -1444,10 +1533,15 @@ static void read_net_line(struct fpga_model* model, const char* line, int start)
 	pinw_idx = fdev_pinw_str2idx(dev_type, &line[pin_name_beg],
 		pin_name_end-pin_name_beg);
 	if (pinw_idx == PINW_NO_IDX) { HERE(); return; }
-	if (fnet_add_port(model, net_idx, y_coord, x_coord, dev_type,
-		to_i(&line[dev_type_idx_str_beg], dev_type_idx_str_end
-			-dev_type_idx_str_beg), pinw_idx))
-		HERE();
+	net_line = net_line_add(model, nl, /*is_sw*/ 0);
+	if (!net_line) return;
+	net_line->net_idx = net_idx;
+	net_line->y = y_coord;
+	net_line->x = x_coord;
+	net_line->dev_type = dev_type;
+	net_line->dev_type_idx = to_i(&line[dev_type_idx_str_beg],
+		dev_type_idx_str_end-dev_type_idx_str_beg);
+	net_line->pinw_idx = pinw_idx;
 }
 
 static void read_dev_line(struct fpga_model* model, const char* line, int start)
@@ -1533,23 +1627,30 @@ static void read_dev_line(struct fpga_model* model, const char* line, int start)
 
 int read_floorplan(struct fpga_model* model, FILE* f)
 {
+	struct net_lines nl;
 	char line[1024];
 	int beg, end;
 
 	RC_CHECK(model);
+	memset(&nl, 0, sizeof(nl));
 	while (fgets(line, sizeof(line), f)) {
 		next_word(line, 0, &beg, &end);
 		if (end == beg) continue;
 
 		if (end-beg == 3
 		    && !str_cmp(&line[beg], 3, "net", 3)) {
-			read_net_line(model, line, end);
+			read_net_line(model, line, end, &nl);
 		}
 		if (end-beg == 3
 		    && !str_cmp(&line[beg], 3, "dev", 3)) {
+			// keep the order of net and dev lines
+			add_net_lines(model, &nl);
 			read_dev_line(model, line, end);
 		}
 	}
+	add_net_lines(model, &nl);
+	free(nl.lines);
+	free(nl.sw);
 	return 0;
 }
 
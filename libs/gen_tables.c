@@ -0,0 +1,72 @@
+//
+// Author: Wolfgang Spraul
+//
+// This is free and unencumbered software released into the public domain.
+// For details see the UNLICENSE file at the root of the source tree.
+//
+
+#include "model.h"
+#include "control.h"
+#include "rr_graph.h"
+#include "lookahead.h"
+
+//
+// gen_tables builds the model of every supported die procedurally
+// and prints model_tables.c with the static tables, the lookahead
+// tables and the wire name table to stdout. It is linked without
+// libfpga-tables, so the library's weak references to them are 0.
+//
+
+static const struct
+{
+	int idcode;
+	enum xc6_pkg pkg; // any package, the tables do not depend on it
+	const char* name;
+} s_dies[] = {
+	{ XC6SLX9, TQG144, "xc6slx9" },
+};
+
+int main(void)
+{
+	struct fpga_model model;
+	const struct lookahead* la;
+	int i;
+
+	unsetenv(FPGA_MODEL_CACHE_ENV);
+	printf("//\n"
+	       "// Generated by gen_tables, do not edit.\n"
+	       "//\n\n"
+	       "#include \"model.h\"\n"
+	       "#include \"control.h\"\n"
+	       "#include \"rr_graph.h\"\n"
+	       "#include \"lookahead.h\"\n\n");
+	for (i = 0; i < sizeof(s_dies)/sizeof(*s_dies); i++) {
+		if (fpga_build_model(&model, s_dies[i].idcode, s_dies[i].pkg)
+		    || fpga_write_table(stdout, &model, s_dies[i].name)) {
+			fprintf(stderr, "#E %s:%i %s failed\n", __FILE__,
+				__LINE__, s_dies[i].name);
+			return EXIT_FAILURE;
+		}
+		printf("\n");
+		// the lookahead needs the routing graph of the model
+		la = la_get(&model, /*rrg*/ 0);
+		if (!la || la_write_table(stdout, la, s_dies[i].name)) {
+			fprintf(stderr, "#E %s:%i %s lookahead failed\n",
+				__FILE__, __LINE__, s_dies[i].name);
+			return EXIT_FAILURE;
+		}
+		fpga_free_model(&model);
+		printf("\n");
+	}
+	printf("const struct xc6_model_table* const xc6_model_tables[] = {\n");
+	for (i = 0; i < sizeof(s_dies)/sizeof(*s_dies); i++)
+		printf("\t&xc6_table_%s,\n", s_dies[i].name);
+	printf("\t0\n};\n\n");
+	printf("const struct xc6_la_table* const xc6_la_tables[] = {\n");
+	for (i = 0; i < sizeof(s_dies)/sizeof(*s_dies); i++)
+		printf("\t&xc6_la_table_%s,\n", s_dies[i].name);
+	printf("\t0\n};\n\n");
+	if (fpga_write_wire_table(stdout))
+		return EXIT_FAILURE;
+	return fflush(stdout) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -7,6 +7,7 @@
 
 #include <stdarg.h>
 #include <errno.h>
+#include <limits.h>
 #include "model.h"
 
 void printf_stdout(const char* fmt, ...)
@@ -27,7 +28,7 @@ void printf_stderr(const char* fmt, ...)
 
 const char *bitstr(uint32_t value, int digits)
 {
-        static char str[2 /* "0b" */ + 32 + 1 /* '\0' */];
+        static __thread char str[2 /* "0b" */ + 32 + 1 /* '\0' */];
         int i;
 
         str[0] = '0';
@@ -306,7 +307,8 @@ typedef struct _minterm_entry
 	int merged;
 } minterm_entry;
 
-const char* bool_bits2str(uint64_t u64, int num_bits)
+const char* bool_bits2str_r(uint64_t u64, int num_bits, char* str,
+	int str_len)
 {
 	// round 0 needs 64 entries
 	// round 1 (size2): 192
@@ -319,7 +321,6 @@ const char* bool_bits2str(uint64_t u64, int num_bits)
 	int mt_size[7];
 	int i, j, k, round, only_diff_bit;
 	int str_end, first_op, bit_width;
-	static char str[2048];
 
 	if (num_bits == 64) {
 		if (!u64) return "0";
@@ -398,6 +399,11 @@ const char* bool_bits2str(uint64_t u64, int num_bits)
 	for (round = 0; round < 7; round++) {
 		for (i = 0; i < mt_size[round]; i++) {
 			if (!mt[round][i].merged) {
+				// '+' and up to 6 times "*~A1"
+				if (str_end + 1 + bit_width*4 >= str_len) {
+					HERE();
+					goto out;
+				}
 				if (str_end)
 					str[str_end++] = '+';
 				first_op = 1;
@@ -415,6 +421,7 @@ const char* bool_bits2str(uint64_t u64, int num_bits)
 			}
 		}
 	}
+out:
 	str[str_end] = 0;
 
 	// TODO: This could be further simplified, see Petrick's method.
@@ -422,6 +429,13 @@ const char* bool_bits2str(uint64_t u64, int num_bits)
 	return str;
 }
 
+const char* bool_bits2str(uint64_t u64, int num_bits)
+{
+	static __thread char str[2048];
+
+	return bool_bits2str_r(u64, num_bits, str, sizeof(str));
+}
+
 int bool_req_pins(uint64_t u64, int num_bits)
 {
 	static const uint64_t pin_mask[6] = {
@@ -1022,8 +1036,8 @@ void printf_v64_mi20(const uint8_t* bits, int row, int major)
 const char *fmt_word(int word)
 {
 	enum { NUM_BUFS = 16, BUF_SIZE = 64 };
-	static char buf[NUM_BUFS][BUF_SIZE];
-	static int last_buf = 0;
+	static __thread char buf[NUM_BUFS][BUF_SIZE];
+	static __thread int last_buf = 0;
 	char bit_str[XC6_WORD_BITS];
 	int i, num_bits_printed;
 
@@ -1231,191 +1245,425 @@ uint32_t hash_djb2(const unsigned char* str)
 }
 
 //
-// The format of each entry in a bin is.
+// The format of each entry in the arena is:
 //   uint32_t idx
-//   uint16_t entry len including 4-byte header
+//   uint32_t hash
+//   uint16_t string len without terminating zero
 //   char[]   zero-terminated string
 //
 // Offsets point to the zero-terminated string, so the len
-// is at off-2, the index at off-6. offset0 can thus be
-// used as a special value to signal 'no entry'.
+// is at off-2, the hash at off-6 and the index at off-10.
+// Offset 0 can thus be used as a special value to signal
+// 'no entry'.
 //
 
-#define BIN_STR_HEADER	(4+2)
-#define BIN_MIN_OFFSET	BIN_STR_HEADER
-#define BIN_INCREMENT	32768
+#define ARENA_STR_HEADER	(4+4+2)
+#define ARENA_MIN_OFFSET	ARENA_STR_HEADER
+#define ARENA_INCREMENT		32768
+#define STR_MIN_SLOTS		1024
 
-const char* strarray_lookup(struct hashed_strarray* array, int idx)
+// The headers are not aligned, they are copied in and out.
+#define STR_IDX(off)	arena_u32(array, (off)-10)
+#define STR_HASH(off)	arena_u32(array, (off)-6)
+#define STR_LEN(off)	arena_u16(array, (off)-2)
+
+static uint32_t arena_u32(const struct hashed_strarray* array, uint32_t o)
 {
-	int bin, offset;
+	uint32_t v;
 
-	if (!array->index_to_bin || !array->bin_offsets || idx==STRIDX_NO_ENTRY)
-		return 0;
+	memcpy(&v, &array->arena[o], sizeof(v));
+	return v;
+}
+
+static uint16_t arena_u16(const struct hashed_strarray* array, uint32_t o)
+{
+	uint16_t v;
+
+	memcpy(&v, &array->arena[o], sizeof(v));
+	return v;
+}
 
-	bin = array->index_to_bin[idx-1];
-	offset = array->bin_offsets[idx-1];
+// djb2 like hash_djb2(), and the length on the way
+static uint32_t hash_len(const char* str, int* len)
+{
+	const unsigned char* s = (const unsigned char*) str;
+	uint32_t hash = 5381;
+
+	while (*s)
+		hash = ((hash << 5) + hash) + *s++;
+	*len = s - (const unsigned char*) str;
+	return hash;
+}
 
-	// bin 0 offset 0 is a special value that signals 'no
-	// entry'. Normal offsets cannot be less than BIN_MIN_OFFSET.
-	if (!bin && !offset) return 0;
+const char* strarray_lookup(struct hashed_strarray* array, int idx)
+{
+	uint32_t off;
 
-	if (!array->bin_strings[bin] || offset >= array->bin_len[bin]
-	    || offset < BIN_MIN_OFFSET) {
+	if (!array->str_off || idx <= STRIDX_NO_ENTRY
+	    || idx > array->highest_index)
+		return 0;
+	off = array->str_off[idx-1];
+	if (!off) return 0;
+	if (off < ARENA_MIN_OFFSET || off >= array->arena_len) {
 		// This really should never happen and is an internal error.
 		fprintf(stderr, "Internal error.\n");
 		return 0;
 	}
+	return &array->arena[off];
+}
+
+static int s_find(struct hashed_strarray* array, const char* str,
+	uint32_t hash, int len)
+{
+	uint32_t off;
+	int i, mask;
 
-	return &array->bin_strings[bin][offset];
+	if (!array->num_slots) return STRIDX_NO_ENTRY;
+	mask = array->num_slots-1;
+	for (i = hash & mask; array->slots[i*2+1]; i = (i+1) & mask) {
+		if (array->slots[i*2] != hash)
+			continue;
+		off = array->str_off[array->slots[i*2+1]-1];
+		if (STR_LEN(off) == len
+		    && !memcmp(&array->arena[off], str, len))
+			return array->slots[i*2+1];
+	}
+	return STRIDX_NO_ENTRY;
 }
 
 int strarray_find(struct hashed_strarray* array, const char* str)
 {
-	int bin, search_off, i;
 	uint32_t hash;
+	int len;
 
-	hash = hash_djb2((const unsigned char*) str);
-	bin = hash % array->num_bins;
-	// iterate over strings in bin to find match
-	if (array->bin_strings[bin]) {
-		search_off = BIN_MIN_OFFSET;
-		while (search_off < array->bin_len[bin]) {
-			if (!strcmp(&array->bin_strings[bin][search_off], str)) {
-				i = *(uint32_t*)&array->bin_strings[bin][search_off-6];
-				if (!i) {
-					fprintf(stderr, "Internal error - index 0.\n");
-					return STRIDX_NO_ENTRY;
-				}
-				return i+1;
-			}
-			search_off += *(uint16_t*)&array->bin_strings[bin][search_off-2];
-		}
-	}
-	return STRIDX_NO_ENTRY;
+	hash = hash_len(str, &len);
+	return s_find(array, str, hash, len);
 }
 
-int s_stash_at_bin(struct hashed_strarray* array, const char* str, int idx, int bin);
+static int s_grow_slots(struct hashed_strarray* array)
+{
+	uint32_t* old_slots, hash;
+	int old_num, i, j, mask;
 
-int strarray_add(struct hashed_strarray* array, const char* str, int* idx)
+	old_slots = array->slots;
+	old_num = array->num_slots;
+	array->num_slots = old_num ? old_num*2 : STR_MIN_SLOTS;
+	array->slots = calloc(array->num_slots, 2*sizeof(*array->slots));
+	if (!array->slots) {
+		fprintf(stderr, "Out of memory.\n");
+		array->slots = old_slots;
+		array->num_slots = old_num;
+		return -1;
+	}
+	mask = array->num_slots-1;
+	for (i = 0; i < old_num; i++) {
+		if (!old_slots[i*2+1])
+			continue;
+		hash = old_slots[i*2];
+		for (j = hash & mask; array->slots[j*2+1]; j = (j+1) & mask);
+		array->slots[j*2] = hash;
+		array->slots[j*2+1] = old_slots[i*2+1];
+	}
+	free(old_slots);
+	return 0;
+}
+
+static int s_insert_slot(struct hashed_strarray* array, uint32_t hash,
+	int idx)
 {
-	int bin, i, free_index, rc, start_index;
-	unsigned long hash;
+	int i, mask;
 
-	*idx = strarray_find(array, str);
-	if (*idx != STRIDX_NO_ENTRY) return 0;
+	// keep the table at most half full
+	if ((array->num_used+1)*2 > array->num_slots
+	    && s_grow_slots(array))
+		return -1;
+	mask = array->num_slots-1;
+	for (i = hash & mask; array->slots[i*2+1]; i = (i+1) & mask);
+	array->slots[i*2] = hash;
+	array->slots[i*2+1] = idx+1;
+	return 0;
+}
 
-	hash = hash_djb2((const unsigned char*) str);
+// s_reserve() makes room for index idx (0-based) in a STRIDX_GROW
+// array, and fails for an index past highest_index otherwise.
+static int s_reserve(struct hashed_strarray* array, int idx)
+{
+	int new_highest;
+	void* new_ptr;
 
-	// search free index
-	start_index = hash % array->highest_index;
-	for (i = 0; i < array->highest_index; i++) {
-		int cur_i = (start_index+i)%array->highest_index;
-		if (!cur_i) // never issue index 0
-			continue;
-		if (!array->bin_offsets[cur_i])
-			break;
+	if (idx < 0) {
+		HERE();
+		return -1;
 	}
-	if (i >= array->highest_index) {
-		fprintf(stderr, "All array indices full.\n");
+	if (idx < array->highest_index)
+		return 0;
+	if (!array->grow || idx == INT_MAX) {
+		HERE();
 		return -1;
 	}
-	free_index = (start_index+i)%array->highest_index;
-	bin = hash % array->num_bins;
-	rc = s_stash_at_bin(array, str, free_index, bin);
-	if (rc) return rc;
-	*idx = free_index + 1;
+	new_highest = array->highest_index;
+	while (new_highest <= idx)
+		new_highest = new_highest > INT_MAX/2 ? INT_MAX : new_highest*2;
+	new_ptr = realloc(array->str_off, new_highest*sizeof(*array->str_off));
+	if (!new_ptr) {
+		fprintf(stderr, "Out of memory.\n");
+		return -1;
+	}
+	array->str_off = new_ptr;
+	memset(&array->str_off[array->highest_index], 0,
+		(new_highest-array->highest_index)*sizeof(*array->str_off));
+	array->highest_index = new_highest;
 	return 0;
 }
 
-int s_stash_at_bin(struct hashed_strarray* array, const char* str, int idx, int bin)
+static void s_mark_used(struct hashed_strarray* array, int idx)
 {
-	int str_len = strlen(str);
-	// check whether bin needs expansion
-	if (!(array->bin_len[bin]%BIN_INCREMENT)
-	    || array->bin_len[bin]%BIN_INCREMENT + BIN_STR_HEADER+str_len+1 > BIN_INCREMENT)
-	{
-		int new_alloclen;
-		void* new_ptr;
-		new_alloclen = ((array->bin_len[bin]
-				+ BIN_STR_HEADER+str_len+1)/BIN_INCREMENT + 1)
-			  * BIN_INCREMENT;
-		new_ptr = realloc(array->bin_strings[bin], new_alloclen);
+	if (array->grow) {
+		if (idx >= array->next_index)
+			array->next_index = idx+1;
+	} else
+		array->used[idx/64] |= 1ULL << (idx%64);
+	array->num_used++;
+}
+
+// Appends str to the arena and points index idx (0-based) to it.
+static int s_stash(struct hashed_strarray* array, const char* str,
+	int len, uint32_t hash, int idx)
+{
+	uint64_t new_size;
+	uint32_t off, u32;
+	uint16_t u16;
+	void* new_ptr;
+
+	if (len > 0xFFFF) {
+		HERE();
+		return -1;
+	}
+	if (s_reserve(array, idx)) return -1;
+	if (array->arena_len + ARENA_STR_HEADER+len+1 > array->arena_size) {
+		new_size = array->arena_size ? array->arena_size : ARENA_INCREMENT;
+		while (array->arena_len + ARENA_STR_HEADER+len+1 > new_size)
+			new_size *= 2;
+		if (new_size > UINT32_MAX) {
+			if (array->arena_len + ARENA_STR_HEADER+len+1 > UINT32_MAX) {
+				fprintf(stderr, "String arena full.\n");
+				return -1;
+			}
+			new_size = UINT32_MAX;
+		}
+		new_ptr = realloc(array->arena, new_size);
 		if (!new_ptr) {
 			fprintf(stderr, "Out of memory.\n");
 			return -1;
 		}
-		if (new_alloclen > array->bin_len[bin])
-			memset(new_ptr+array->bin_len[bin], 0, new_alloclen-array->bin_len[bin]);
-		array->bin_strings[bin] = new_ptr;
-	}
-	// append new string at end of bin
-	*(uint32_t*)&array->bin_strings[bin][array->bin_len[bin]] = idx;
-	*(uint16_t*)&array->bin_strings[bin][array->bin_len[bin]+4] = BIN_STR_HEADER+str_len+1;
-	strcpy(&array->bin_strings[bin][array->bin_len[bin]+BIN_STR_HEADER], str);
-	array->index_to_bin[idx] = bin;
-	array->bin_offsets[idx] = array->bin_len[bin]+BIN_STR_HEADER;
-	array->bin_len[bin] += BIN_STR_HEADER+str_len+1;
+		array->arena = new_ptr;
+		array->arena_size = new_size;
+	}
+	off = array->arena_len + ARENA_STR_HEADER;
+	u32 = idx;
+	memcpy(&array->arena[off-10], &u32, sizeof(u32));
+	memcpy(&array->arena[off-6], &hash, sizeof(hash));
+	u16 = len;
+	memcpy(&array->arena[off-2], &u16, sizeof(u16));
+	memcpy(&array->arena[off], str, len+1);
+	array->arena_len = off+len+1;
+	if (!array->str_off[idx])
+		s_mark_used(array, idx);
+	array->str_off[idx] = off;
+	return 0;
+}
+
+// Returns the first free index at or after start, wrapping
+// around, or -1 if all are used.
+static int s_free_index(struct hashed_strarray* array, int start)
+{
+	int num_words, w, i;
+	uint64_t free_bits;
+
+	num_words = (array->highest_index+63)/64;
+	w = start/64;
+	free_bits = ~array->used[w] & (~0ULL << (start%64));
+	// the last round looks at the bits before start
+	for (i = 0; i <= num_words; i++) {
+		if (free_bits)
+			return w*64 + __builtin_ctzll(free_bits);
+		w = (w+1) % num_words;
+		free_bits = ~array->used[w];
+	}
+	return -1;
+}
+
+int strarray_add(struct hashed_strarray* array, const char* str, int* idx)
+{
+	uint32_t hash;
+	int len, free_index;
+
+	hash = hash_len(str, &len);
+	*idx = s_find(array, str, hash, len);
+	if (*idx != STRIDX_NO_ENTRY) return 0;
+	if (array->read_only) {
+		fprintf(stderr, "String array is read-only.\n");
+		return -1;
+	}
+
+	// index 0 is marked used in strarray_init() and never issued
+	if (array->grow)
+		free_index = array->next_index;
+	else
+		free_index = s_free_index(array, hash % array->highest_index);
+	if (free_index == -1) {
+		fprintf(stderr, "All array indices full.\n");
+		return -1;
+	}
+	if (s_insert_slot(array, hash, free_index)
+	    || s_stash(array, str, len, hash, free_index))
+		return -1;
+	*idx = free_index + 1;
 	return 0;
 }
 
 int strarray_stash(struct hashed_strarray* array, const char* str, int idx)
 {
-	// The bin is just a random number here, because find
-	// cannot be used after stash anyway, only lookup can.
-	return s_stash_at_bin(array, str, idx-1, idx % array->num_bins);
+	int len;
+	uint32_t hash;
+
+	if (array->read_only) {
+		fprintf(stderr, "String array is read-only.\n");
+		return -1;
+	}
+	// not entered into the slots, find cannot be used after
+	// stash anyway, only lookup can
+	hash = hash_len(str, &len);
+	return s_stash(array, str, len, hash, idx-1);
 }
 
 int strarray_used_slots(struct hashed_strarray* array)
 {
-	int i, num_used_slots;
-	num_used_slots = 0;
-	if (!array->bin_offsets) return 0;
-	for (i = 0; i < array->highest_index; i++) {
-		if (array->bin_offsets[i])
-			num_used_slots++;
+	return array->num_used;
+}
+
+const char* strarray_data(struct hashed_strarray* array, int* len)
+{
+	*len = array->arena_len;
+	return array->arena;
+}
+
+int strarray_load(struct hashed_strarray* array, const char* data, int len)
+{
+	int off, idx;
+
+	if (array->arena_len || array->num_used) {
+		HERE();
+		return -1;
+	}
+	if (!len) return 0;
+	array->arena_size = (len/ARENA_INCREMENT + 1) * ARENA_INCREMENT;
+	array->arena = malloc(array->arena_size);
+	if (!array->arena) {
+		fprintf(stderr, "Out of memory.\n");
+		array->arena_size = 0;
+		return -1;
+	}
+	memcpy(array->arena, data, len);
+	array->arena_len = len;
+
+	// walk the entries to restore the index, the
+	// hashes are stored so nothing is rehashed
+	off = ARENA_MIN_OFFSET;
+	while (off < len) {
+		idx = STR_IDX(off);
+		if (idx <= 0 || s_reserve(array, idx)
+		    || off + STR_LEN(off) >= len
+		    || array->str_off[idx]) {
+			HERE();
+			return -1;
+		}
+		if (s_insert_slot(array, STR_HASH(off), idx))
+			return -1;
+		array->str_off[idx] = off;
+		s_mark_used(array, idx);
+		off += STR_LEN(off)+1 + ARENA_STR_HEADER;
+	}
+	return 0;
+}
+
+int strarray_load_lines(struct hashed_strarray* array, FILE* f)
+{
+	char line[1024], last[1024];
+	int len, cmp, idx, sorted;
+	uint32_t hash;
+
+	sorted = !array->num_used;
+	last[0] = 0;
+	while (fgets(line, sizeof(line), f)) {
+		len = strlen(line);
+		if (len && line[len-1] == '\n')
+			line[--len] = 0;
+		if (!len) continue;
+		if (sorted && (cmp = strcmp(line, last)) <= 0) {
+			if (!cmp) continue;
+			sorted = 0;
+		}
+		if (!sorted) {
+			if (strarray_add(array, line, &idx))
+				return -1;
+			continue;
+		}
+		// nothing after the last line can be in the array yet
+		strcpy(last, line);
+		hash = hash_len(line, &len);
+		idx = array->grow ? array->next_index
+			: s_free_index(array, hash % array->highest_index);
+		if (idx == -1) {
+			fprintf(stderr, "All array indices full.\n");
+			return -1;
+		}
+		if (s_insert_slot(array, hash, idx)
+		    || s_stash(array, line, len, hash, idx))
+			return -1;
 	}
-	return num_used_slots;
+	return 0;
 }
 
+#define STR_GROW_MIN	65536
+
 int strarray_init(struct hashed_strarray* array, int highest_index)
 {
 	memset(array, 0, sizeof(*array));
+	if (highest_index == STRIDX_GROW) {
+		array->grow = 1;
+		array->highest_index = STR_GROW_MIN;
+		array->next_index = 1; // never issue index 0
+		array->str_off = calloc(STR_GROW_MIN, sizeof(*array->str_off));
+		if (!array->str_off) {
+			fprintf(stderr, "Out of memory in %s:%i\n", __FILE__, __LINE__);
+			return -1;
+		}
+		return 0;
+	}
 	array->highest_index = highest_index;
-	array->num_bins = highest_index / 64;
-
-	array->bin_strings = calloc(array->num_bins,sizeof(*array->bin_strings));
-	array->bin_len = calloc(array->num_bins,sizeof(*array->bin_len));
-	array->bin_offsets = calloc(array->highest_index,sizeof(*array->bin_offsets));
-	array->index_to_bin = calloc(array->highest_index,sizeof(*array->index_to_bin));
-	
-	if (!array->bin_strings || !array->bin_len
-	    || !array->bin_offsets || !array->index_to_bin) {
+	array->str_off = calloc(highest_index, sizeof(*array->str_off));
+	array->used = calloc((highest_index+63)/64, sizeof(*array->used));
+	if (!array->str_off || !array->used) {
 		fprintf(stderr, "Out of memory in %s:%i\n", __FILE__, __LINE__);
-		free(array->bin_strings);
-		free(array->bin_len);
-		free(array->bin_offsets);
-		free(array->index_to_bin);
+		free(array->str_off);
+		free(array->used);
 		return -1;
 	}
+	// never issue index 0, or one past highest_index
+	array->used[0] = 1;
+	if (highest_index % 64)
+		array->used[highest_index/64] |= ~0ULL << (highest_index%64);
 	return 0;
 }
 
 void strarray_free(struct hashed_strarray* array)
 {
-	int i;
-	for (i = 0; i < sizeof(array->bin_strings)/
-		sizeof(array->bin_strings[0]); i++) {
-		free(array->bin_strings[i]);
-		array->bin_strings[i] = 0;
-	}
-	free(array->bin_strings);
-	array->bin_strings = 0;
-	free(array->bin_len);
-	array->bin_len = 0;
-	free(array->bin_offsets);
-	array->bin_offsets = 0;
-	free(array->index_to_bin);
-	array->index_to_bin = 0;
+	free(array->str_off);
+	free(array->used);
+	free(array->slots);
+	free(array->arena);
+	memset(array, 0, sizeof(*array));
 }
 
 int row_pos_to_y(int num_rows, int row, int pos)
@@ -1445,8 +1693,10 @@ int cmdline_help(int argc, char **argv)
 				"\n"
 				"Usage: %s [--part=xc6slx9]\n"
 				"       %*s [--package=tqg144|ftg256]\n"
+				"       %*s [--build-threads=<num>] [--lazy-build]\n"
 				"       %*s [--help]\n",
 				*argv, *argv, (int) strlen(*argv), "",
+				(int) strlen(*argv), "",
 				(int) strlen(*argv), "");
 			return 1;
 		}
@@ -1479,8 +1729,8 @@ int cmdline_package(int argc, char **argv)
 const char *cmdline_strvar(int argc, char **argv, const char *var)
 {
 	enum { NUM_BUFS = 32, BUF_SIZE = 256 };
-	static char buf[NUM_BUFS][BUF_SIZE];
-	static int last_buf = 0;
+	static __thread char buf[NUM_BUFS][BUF_SIZE];
+	static __thread int last_buf = 0;
 	char scan_str[128];
 	int i, next_buf;
 
@@ -1507,3 +1757,25 @@ int cmdline_intvar(int argc, char **argv, const char *var)
 	}
 	return 0;
 }
+
+int cmdline_build_threads(int argc, char **argv)
+{
+	int i, num_threads;
+
+	for (i = 1; i < argc; i++) {
+		if (sscanf(argv[i], "--build-threads=%i", &num_threads) == 1)
+			return num_threads;
+	}
+	return 0;
+}
+
+int cmdline_lazy_build(int argc, char **argv)
+{
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--lazy-build"))
+			return 1;
+	}
+	return 0;
+}
@@ -75,6 +75,10 @@ int bool_str2u32(const char *str, uint32_t *u32);
 int bool_str2lut_pair(const char *str6, const char *str5, uint64_t *lut6_val, uint32_t *lut5_val);
 int bool_str2bits(const char* str, int str_len, uint64_t* u64, int num_bits);
 const char* bool_bits2str(uint64_t u64, int num_bits);
+// bool_bits2str_r() writes into str, but may return a constant
+// string like "0" or "1" instead.
+const char* bool_bits2str_r(uint64_t u64, int num_bits, char* str,
+	int str_len);
 int bool_req_pins(uint64_t u64, int num_bits);
 
 void printf_type2(uint8_t* d, int len, int inpos, int num_entries);
@@ -139,38 +143,64 @@ void printf_wrap(FILE* f, char* line, int prefix_len,
 
 uint32_t hash_djb2(const unsigned char* str);
 
-// Strings are distributed among bins. Each bin is
-// one continuous stream of zero-terminated strings
-// prefixed with a 32+16=48-bit header. The allocation
-// increment for each bin is 32k.
+// All strings live in one arena, each prefixed with its index,
+// hash and length. An open-addressing table of hash/index pairs
+// finds them, so that a lookup only compares the bytes of a
+// string whose hash and length match. Indices are picked from a
+// bitmap of used indices, starting at the hash of the string.
+//
+// An array initialized with STRIDX_GROW instead issues indices in
+// the order strings are added and grows without limit, for tools
+// that work on more strings than a str16_t can hold. Each string
+// then costs its length plus 15 bytes in the arena and index, and
+// 8 to 16 bytes in the table. The arena is limited to 4 GB.
 struct hashed_strarray
 {
-	int highest_index;
-	uint32_t* bin_offsets; // min offset is 4, 0 means no entry
-	uint16_t* index_to_bin;
-	char** bin_strings;
-	int* bin_len;
-	int num_bins;
+	int highest_index; // capacity with STRIDX_GROW
+	int grow;
+	int next_index; // STRIDX_GROW: next index to issue
+	uint32_t* str_off; // per index, 0 means no entry
+	uint64_t* used; // bitmap of used indices, 0 with STRIDX_GROW
+	int num_used;
+	uint32_t* slots; // hash, index+1 pairs, 0 index means empty
+	int num_slots; // power of 2
+	char* arena;
+	uint32_t arena_len, arena_size;
+	int read_only; // shared, no strings can be added
 };
 
 #define STRIDX_64K	0xFFFF
 #define STRIDX_1M	1000000
+#define STRIDX_GROW	0
 
 typedef uint16_t str16_t;
 
 int strarray_init(struct hashed_strarray* array, int highest_index);
 void strarray_free(struct hashed_strarray* array);
 
+// Pointers returned by strarray_lookup() stay valid until the
+// next string is added.
 const char* strarray_lookup(struct hashed_strarray* array, int idx);
 // The found or created index will never be 0, so the caller
 // can use 0 as a special value to indicate 'no string'.
 #define STRIDX_NO_ENTRY 0
 int strarray_find(struct hashed_strarray* array, const char* str);
+// strarray_add() fails for a new string if the array is read_only.
 int strarray_add(struct hashed_strarray* array, const char* str, int* idx);
 // If you stash a string to a fixed index, you cannot use strarray_find()
 // anymore, only strarray_lookup().
 int strarray_stash(struct hashed_strarray* array, const char* str, int idx);
 int strarray_used_slots(struct hashed_strarray* array);
+// strarray_data() and strarray_load() give raw access to the
+// arena so that an array can be saved and restored without
+// rehashing. strarray_load() expects an initialized empty array.
+const char* strarray_data(struct hashed_strarray* array, int* len);
+int strarray_load(struct hashed_strarray* array, const char* data, int len);
+// strarray_load_lines() adds every line of f. If the array was
+// empty and f is sorted, repeated lines are skipped without a
+// lookup and with STRIDX_GROW the indices follow the sort order.
+// Unsorted lines are added normally.
+int strarray_load_lines(struct hashed_strarray* array, FILE* f);
 
 int row_pos_to_y(int num_rows, int row, int pos);
 
@@ -179,3 +209,7 @@ int cmdline_part(int argc, char **argv);
 int cmdline_package(int argc, char **argv);
 const char *cmdline_strvar(int argc, char **argv, const char *var);
 int cmdline_intvar(int argc, char **argv, const char *var);
+// cmdline_build_threads() returns N for --build-threads=N, or 0
+int cmdline_build_threads(int argc, char **argv);
+// cmdline_lazy_build() returns 1 if --lazy-build was given
+int cmdline_lazy_build(int argc, char **argv);
@@ -0,0 +1,471 @@
+//
+// Author: Wolfgang Spraul
+//
+// This is free and unencumbered software released into the public domain.
+// For details see the UNLICENSE file at the root of the source tree.
+//
+
+#include <pthread.h>
+#include "model.h"
+#include "control.h"
+#include "rr_graph.h"
+#include "lookahead.h"
+
+//
+// The cache file is a header, the type names in type order, each
+// terminated by a 0, and the cost tables.
+//
+// Bump LA_VERSION whenever the file layout or the search changes.
+//
+
+#define LA_MAGIC	"FPGALOOK"
+#define LA_VERSION	1
+#ifndef LIBS_VERSION
+  #define LIBS_VERSION	"unknown"
+#endif
+
+struct la_hdr
+{
+	char magic[8];
+	uint32_t version;
+	char libs_version[16];
+	int32_t idcode;
+	int32_t radius;
+	int32_t num_types;
+	float far_per_tile;
+	int32_t names_len;
+};
+
+// A STRIDX_GROW array issues 2 as its first index.
+#define TYPE2IDX(type)	((type)+2)
+#define IDX2TYPE(idx)	((idx)-2)
+
+#define LA_CELL(type, dy, dx) \
+	((type)*LA_SIZE*LA_SIZE + ((dy)+LA_RADIUS)*LA_SIZE + (dx)+LA_RADIUS)
+
+static pthread_mutex_t s_la_lock = PTHREAD_MUTEX_INITIALIZER;
+static int s_num_las;
+static struct lookahead** s_las;
+
+static void la_free(struct lookahead* la)
+{
+	strarray_free(&la->names);
+	free(la->cost);
+	free(la);
+}
+
+// Searches from the node of each type closest to the center of the
+// chip and keeps the fewest nodes to every offset.
+static int la_build(struct lookahead* la, struct fpga_model* model,
+	const struct rr_graph* rrg)
+{
+	rrg_node_t* rep, *queue, node, to;
+	uint16_t* node_y, *node_x;
+	uint8_t* dist, *cell;
+	int* rep_distance;
+	int i, y, x, connpt_o, type, head, tail, dy, dx, distance, rc;
+	rrg_edge_t e;
+	float per_tile;
+
+	rep = 0;
+	rep_distance = 0;
+	queue = 0;
+	node_y = node_x = 0;
+	dist = 0;
+	node_y = malloc(rrg->num_nodes * sizeof(*node_y));
+	node_x = malloc(rrg->num_nodes * sizeof(*node_x));
+	dist = malloc(rrg->num_nodes);
+	queue = malloc(rrg->num_nodes * sizeof(*queue));
+	rep = malloc(rrg->num_nodes * sizeof(*rep));
+	rep_distance = malloc(rrg->num_nodes * sizeof(*rep_distance));
+	if (!node_y || !node_x || !dist || !queue || !rep || !rep_distance)
+		FAIL(ENOMEM);
+
+	for (i = 0; i < rrg->num_nodes; i++) {
+		rrg_node_yx(rrg, i, &y, &x, &connpt_o);
+		node_y[i] = y;
+		node_x[i] = x;
+		if (strarray_add(&la->names, strarray_lookup(&model->str,
+				YX_TILE(model, y, x)->conn_point_names[connpt_o*2+1]),
+				&type))
+			FAIL(ENOMEM);
+		type = IDX2TYPE(type);
+		distance = abs(y - model->y_height/2) + abs(x - model->x_width/2);
+		if (type >= la->num_types) {
+			la->num_types = type+1;
+			rep[type] = i;
+			rep_distance[type] = distance;
+		} else if (distance < rep_distance[type]) {
+			rep[type] = i;
+			rep_distance[type] = distance;
+		}
+	}
+	la->cost = malloc(la->num_types * LA_SIZE*LA_SIZE);
+	if (!la->cost) FAIL(ENOMEM);
+	memset(la->cost, LA_UNKNOWN, la->num_types * LA_SIZE*LA_SIZE);
+
+	la->far_per_tile = 1;
+	memset(dist, LA_UNKNOWN, rrg->num_nodes);
+	for (type = 0; type < la->num_types; type++) {
+		head = tail = 0;
+		queue[tail++] = rep[type];
+		dist[rep[type]] = 0;
+		while (head < tail) {
+			node = queue[head++];
+			cell = &la->cost[LA_CELL(type,
+				node_y[node] - node_y[rep[type]],
+				node_x[node] - node_x[rep[type]])];
+			if (dist[node] < *cell)
+				*cell = dist[node];
+			if (dist[node] >= LA_UNKNOWN-1)
+				continue;
+			for (e = rrg->edge_start[node]; e < rrg->edge_start[node+1]; e++) {
+				to = rrg->edge_to[e];
+				if (dist[to] != LA_UNKNOWN
+				    || abs(node_y[to] - node_y[rep[type]]) > LA_RADIUS
+				    || abs(node_x[to] - node_x[rep[type]]) > LA_RADIUS)
+					continue;
+				dist[to] = dist[node]+1;
+				queue[tail++] = to;
+			}
+		}
+		for (i = 0; i < tail; i++)
+			dist[queue[i]] = LA_UNKNOWN;
+
+		// the edge of the table
+		for (dy = -LA_RADIUS; dy <= LA_RADIUS; dy++) {
+			for (dx = -LA_RADIUS; dx <= LA_RADIUS; dx++) {
+				if (abs(dy) != LA_RADIUS && abs(dx) != LA_RADIUS)
+					continue;
+				if (la->cost[LA_CELL(type, dy, dx)] == LA_UNKNOWN)
+					continue;
+				per_tile = (float) la->cost[LA_CELL(type, dy, dx)]
+					/ (abs(dy) + abs(dx));
+				if (per_tile < la->far_per_tile)
+					la->far_per_tile = per_tile;
+			}
+		}
+	}
+	rc = 0;
+fail:
+	free(node_y);
+	free(node_x);
+	free(dist);
+	free(queue);
+	free(rep);
+	free(rep_distance);
+	return rc;
+}
+
+static int la_write(const struct lookahead* la, const char* path)
+{
+	struct hashed_strarray* names = (struct hashed_strarray*) &la->names;
+	struct la_hdr hdr;
+	char tmp_path[1024];
+	const char* name;
+	FILE* f;
+	int i, rc;
+
+	// write to a temporary file first so that concurrent
+	// readers never see a partial file
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%i", path, (int) getpid());
+	f = fopen(tmp_path, "w");
+	if (!f) return errno;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, LA_MAGIC, sizeof(hdr.magic));
+	hdr.version = LA_VERSION;
+	strncpy(hdr.libs_version, LIBS_VERSION, sizeof(hdr.libs_version)-1);
+	hdr.idcode = la->idcode;
+	hdr.radius = LA_RADIUS;
+	hdr.num_types = la->num_types;
+	hdr.far_per_tile = la->far_per_tile;
+	for (i = 0; i < la->num_types; i++)
+		hdr.names_len += strlen(strarray_lookup(names, TYPE2IDX(i))) + 1;
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1) FAIL(EIO);
+	for (i = 0; i < la->num_types; i++) {
+		name = strarray_lookup(names, TYPE2IDX(i));
+		if (fwrite(name, strlen(name)+1, 1, f) != 1) FAIL(EIO);
+	}
+	if (fwrite(la->cost, la->num_types * LA_SIZE*LA_SIZE, 1, f) != 1)
+		FAIL(EIO);
+	if (fclose(f)) {
+		f = 0;
+		FAIL(EIO);
+	}
+	f = 0;
+	if (rename(tmp_path, path)) FAIL(errno);
+	return 0;
+fail:
+	if (f) fclose(f);
+	unlink(tmp_path);
+	return rc;
+}
+
+// Returns 0 if the file is missing, corrupt or from a different
+// version.
+static struct lookahead* la_read(int idcode, const char* path)
+{
+	struct lookahead* la;
+	struct la_hdr hdr;
+	char* names;
+	FILE* f;
+	int i, off, idx;
+
+	la = 0;
+	names = 0;
+	f = fopen(path, "r");
+	if (!f) return 0;
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1
+	    || memcmp(hdr.magic, LA_MAGIC, sizeof(hdr.magic))
+	    || hdr.version != LA_VERSION
+	    || strncmp(hdr.libs_version, LIBS_VERSION, sizeof(hdr.libs_version))
+	    || hdr.idcode != idcode || hdr.radius != LA_RADIUS
+	    || hdr.num_types <= 0 || hdr.names_len <= 0)
+		goto fail;
+	la = calloc(1, sizeof(*la));
+	names = malloc(hdr.names_len);
+	if (!la || !names) goto fail;
+	if (strarray_init(&la->names, STRIDX_GROW)) {
+		free(la);
+		la = 0;
+		goto fail;
+	}
+	la->idcode = idcode;
+	la->num_types = hdr.num_types;
+	la->far_per_tile = hdr.far_per_tile;
+	la->cost = malloc(la->num_types * LA_SIZE*LA_SIZE);
+	if (!la->cost
+	    || fread(names, hdr.names_len, 1, f) != 1
+	    || names[hdr.names_len-1]
+	    || fread(la->cost, la->num_types * LA_SIZE*LA_SIZE, 1, f) != 1)
+		goto fail;
+	for (i = 0, off = 0; off < hdr.names_len; i++) {
+		if (strarray_add(&la->names, &names[off], &idx) || idx != TYPE2IDX(i))
+			goto fail;
+		off += strlen(&names[off]) + 1;
+	}
+	if (i != la->num_types) goto fail;
+	free(names);
+	fclose(f);
+	return la;
+fail:
+	if (la) la_free(la);
+	free(names);
+	fclose(f);
+	return 0;
+}
+
+// Copies a static table, returns 0 for out of memory.
+static struct lookahead* la_from_table(const struct xc6_la_table* table)
+{
+	struct lookahead* la;
+	const char* name;
+	int i, idx;
+
+	la = calloc(1, sizeof(*la));
+	if (!la) return 0;
+	if (strarray_init(&la->names, STRIDX_GROW)) {
+		free(la);
+		return 0;
+	}
+	la->idcode = table->idcode;
+	la->num_types = table->num_types;
+	la->far_per_tile = table->far_per_tile;
+	la->cost = malloc(la->num_types * LA_SIZE*LA_SIZE);
+	if (!la->cost) goto fail;
+	memcpy(la->cost, table->cost, la->num_types * LA_SIZE*LA_SIZE);
+	name = table->names;
+	for (i = 0; i < la->num_types; i++) {
+		if (strarray_add(&la->names, name, &idx) || idx != TYPE2IDX(i))
+			goto fail;
+		name += strlen(name) + 1;
+	}
+	return la;
+fail:
+	la_free(la);
+	return 0;
+}
+
+// Called with s_la_lock held.
+static struct lookahead* la_known(int idcode)
+{
+	int i;
+
+	for (i = 0; i < s_num_las; i++) {
+		if (s_las[i]->idcode == idcode)
+			return s_las[i];
+	}
+	return 0;
+}
+
+// Keeps la for the rest of the process. If another thread added the
+// same die in the meantime, la is dropped in favour of that one.
+static const struct lookahead* la_keep(struct fpga_model* model,
+	struct lookahead* la)
+{
+	struct lookahead* known;
+	void* new_ptr;
+
+	pthread_mutex_lock(&s_la_lock);
+	known = la_known(la->idcode);
+	if (known) {
+		pthread_mutex_unlock(&s_la_lock);
+		la_free(la);
+		return known;
+	}
+	new_ptr = realloc(s_las, (s_num_las+1) * sizeof(*s_las));
+	if (!new_ptr) {
+		pthread_mutex_unlock(&s_la_lock);
+		la_free(la);
+		RC_SET(model, ENOMEM);
+		return 0;
+	}
+	s_las = new_ptr;
+	s_las[s_num_las++] = la;
+	pthread_mutex_unlock(&s_la_lock);
+	return la;
+}
+
+// The build takes seconds, so it runs without s_la_lock. Two threads
+// may then build the same die, la_keep() keeps the first.
+static const struct lookahead* la_load(struct fpga_model* model,
+	const struct rr_graph* rrg, int build)
+{
+	struct lookahead* la;
+	struct rr_graph own_rrg;
+	const char* cache_dir;
+	char path[1024];
+	int idcode, i, rc;
+
+	if (model->rc) return 0;
+	idcode = model->die->idcode;
+	pthread_mutex_lock(&s_la_lock);
+	la = la_known(idcode);
+	pthread_mutex_unlock(&s_la_lock);
+	if (la) return la;
+
+	for (i = 0; xc6_la_tables && xc6_la_tables[i]; i++) {
+		if (xc6_la_tables[i]->idcode != idcode)
+			continue;
+		la = la_from_table(xc6_la_tables[i]);
+		if (!la) { rc = ENOMEM; goto fail; }
+		return la_keep(model, la);
+	}
+	path[0] = 0;
+	cache_dir = getenv(FPGA_MODEL_CACHE_ENV);
+	if (cache_dir && *cache_dir) {
+		snprintf(path, sizeof(path), "%s/xc6_%08x.lookahead",
+			cache_dir, idcode);
+		la = la_read(idcode, path);
+		if (la) return la_keep(model, la);
+	}
+	if (!build) return 0;
+
+	la = calloc(1, sizeof(*la));
+	if (!la) { rc = ENOMEM; goto fail; }
+	if (strarray_init(&la->names, STRIDX_GROW)) {
+		free(la);
+		la = 0;
+		rc = ENOMEM;
+		goto fail;
+	}
+	la->idcode = idcode;
+	if (!rrg) {
+		rrg_build(&own_rrg, model);
+		if (model->rc) { rc = model->rc; goto fail; }
+	}
+	rc = la_build(la, model, rrg ? rrg : &own_rrg);
+	if (!rrg)
+		rrg_free(&own_rrg);
+	if (rc) goto fail;
+	// the tables are fine, only the cache failed
+	if (*path && la_write(la, path))
+		fprintf(stderr, "#W %s:%i cannot write %s\n",
+			__FILE__, __LINE__, path);
+	return la_keep(model, la);
+fail:
+	if (la) la_free(la);
+	RC_SET(model, rc);
+	return 0;
+}
+
+const struct lookahead* la_get(struct fpga_model* model,
+	const struct rr_graph* rrg)
+{
+	return la_load(model, rrg, /*build*/ 1);
+}
+
+const struct lookahead* la_find(struct fpga_model* model)
+{
+	return la_load(model, /*rrg*/ 0, /*build*/ 0);
+}
+
+int la_type(const struct lookahead* la, struct fpga_model* model,
+	str16_t name_i)
+{
+	int idx;
+
+	idx = strarray_find((struct hashed_strarray*) &la->names,
+		strarray_lookup(&model->str, name_i));
+	return idx == STRIDX_NO_ENTRY ? LA_NO_TYPE : IDX2TYPE(idx);
+}
+
+float la_estimate(const struct lookahead* la, int type, int dy, int dx)
+{
+	int cy, cx, cost;
+
+	if (type == LA_NO_TYPE)
+		return la->far_per_tile * (abs(dy) + abs(dx));
+	cy = dy < -LA_RADIUS ? -LA_RADIUS : (dy > LA_RADIUS ? LA_RADIUS : dy);
+	cx = dx < -LA_RADIUS ? -LA_RADIUS : (dx > LA_RADIUS ? LA_RADIUS : dx);
+	cost = la->cost[LA_CELL(type, cy, cx)];
+	if (cost == LA_UNKNOWN)
+		return la->far_per_tile * (abs(dy) + abs(dx));
+	return cost + la->far_per_tile * (abs(dy-cy) + abs(dx-cx));
+}
+
+float la_estimate_yx(const struct lookahead* la, struct fpga_model* model,
+	int y, int x, str16_t name_i, int to_y, int to_x)
+{
+	return la_estimate(la, la_type(la, model, name_i), to_y-y, to_x-x);
+}
+
+void la_print_stats(FILE* f, const struct lookahead* la)
+{
+	int i, num_known;
+
+	num_known = 0;
+	for (i = 0; i < la->num_types * LA_SIZE*LA_SIZE; i++)
+		num_known += la->cost[i] != LA_UNKNOWN;
+	fprintf(f, "lookahead: %i types, %i of %i offsets reached, "
+		"%.3f nodes per tile beyond, %i kb\n", la->num_types,
+		num_known, la->num_types * LA_SIZE*LA_SIZE, la->far_per_tile,
+		la->num_types * LA_SIZE*LA_SIZE / 1024);
+}
+
+int la_write_table(FILE* f, const struct lookahead* la, const char* name)
+{
+	struct hashed_strarray* names = (struct hashed_strarray*) &la->names;
+	int i;
+
+	fprintf(f, "static const char s_%s_la_names[] =\n", name);
+	// one literal per name, so that no \0 escape runs on
+	for (i = 0; i < la->num_types; i++)
+		fprintf(f, "\t\"%s\\0\"\n", strarray_lookup(names, TYPE2IDX(i)));
+	fprintf(f, "\t\"\";\n\nstatic const uint8_t s_%s_la_cost[] = {\n", name);
+	for (i = 0; i < la->num_types * LA_SIZE*LA_SIZE; i++) {
+		fprintf(f, "%u,", la->cost[i]);
+		if (!((i+1) % LA_SIZE))
+			fprintf(f, "\n");
+	}
+	fprintf(f, "};\n\n"
+		"const struct xc6_la_table xc6_la_table_%s = {\n"
+		"\t.idcode = 0x%08x,\n"
+		"\t.num_types = %i,\n"
+		"\t.far_per_tile = %a,\n"
+		"\t.names = s_%s_la_names,\n"
+		"\t.cost = s_%s_la_cost,\n"
+		"};\n", name, la->idcode, la->num_types, la->far_per_tile,
+		name, name);
+	return ferror(f) ? EIO : 0;
+}
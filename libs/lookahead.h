@@ -0,0 +1,73 @@
+//
+// Author: Wolfgang Spraul
+//
+// This is free and unencumbered software released into the public domain.
+// For details see the UNLICENSE file at the root of the source tree.
+//
+
+//
+// A lookahead estimates how many routing graph nodes a route needs
+// from a wire to a tile dy/dx away. The wire type is the name of the
+// first connpt of a node (see rr_graph.h). For every type, a
+// breadth-first search from the wire of that type closest to the
+// center of the chip records the fewest nodes to any node at each
+// offset up to LA_RADIUS tiles. The fabric is regular enough for that
+// to hold elsewhere, too. Further out, and for offsets the search did
+// not reach, the estimate grows by far_per_tile, the lowest number of
+// nodes per tile seen at the edge of any table.
+//
+// Building the tables takes seconds, so gen_tables builds them for
+// the supported dies into the generated model_tables.c, which is
+// linked into the optional libfpga-tables. la_find()
+// returns the lookahead of the model's die from there, or from
+// xc6_<idcode>.lookahead in FPGA_MODEL_CACHE, or 0 without setting
+// model->rc. la_get() also builds missing tables, once per process,
+// and writes them to FPGA_MODEL_CACHE.
+//
+
+#define LA_RADIUS	8
+#define LA_SIZE		(2*LA_RADIUS+1)
+#define LA_UNKNOWN	0xFF
+#define LA_NO_TYPE	-1
+
+struct lookahead
+{
+	int idcode;
+	// types are in the order the names were added
+	struct hashed_strarray names;
+	int num_types;
+	uint8_t* cost; // num_types * LA_SIZE*LA_SIZE, LA_UNKNOWN
+	float far_per_tile;
+};
+
+// rrg can be 0, the graph is then built when needed.
+const struct lookahead* la_get(struct fpga_model* model,
+	const struct rr_graph* rrg);
+const struct lookahead* la_find(struct fpga_model* model);
+
+// la_type() returns LA_NO_TYPE for names without a table.
+int la_type(const struct lookahead* la, struct fpga_model* model,
+	str16_t name_i);
+float la_estimate(const struct lookahead* la, int type, int dy, int dx);
+float la_estimate_yx(const struct lookahead* la, struct fpga_model* model,
+	int y, int x, str16_t name_i, int to_y, int to_x);
+
+void la_print_stats(FILE* f, const struct lookahead* la);
+
+struct xc6_la_table
+{
+	int idcode;
+	int num_types;
+	float far_per_tile;
+	const char* names; // num_types names, each terminated by a 0
+	const uint8_t* cost; // num_types * LA_SIZE*LA_SIZE
+};
+
+// zero-terminated, defined in the generated model_tables.c of the
+// optional libfpga-tables. Without it the symbol is 0.
+extern const struct xc6_la_table* const xc6_la_tables[]
+	__attribute__((weak));
+
+// la_write_table() prints the C source of a static table, name is
+// the suffix of all symbols.
+int la_write_table(FILE* f, const struct lookahead* la, const char* name);
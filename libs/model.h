@@ -18,6 +18,8 @@
 
 #define LEFT_SIDE_MAJOR 1
 
+enum { SWBOX_SWITCHES = 0, SWBOX_CONNPTS, SWBOX_NUM_KINDS };
+
 struct fpga_model
 {
 	int rc; // if rc != 0, all function calls will immediately return
@@ -48,10 +50,74 @@ struct fpga_model
 	int nets_array_size;
 	int highest_used_net; // 1-based net_idx_t
 	struct fpga_net* nets;
+	// the el arrays of the nets, see net_el_alloc()
+	struct net_pool* net_pool;
+	// deleted net ids, may hold ids that were reused already
+	int* free_nets; // 1-based net_idx_t
+	int num_free_nets, free_nets_size;
+	// The net of every switch in a net, kept by the fnet_
+	// functions, see fpga_switch_net(). sw_owners is a hash of
+	// sw_owners_size slots, net_sw_bits holds per tile 0 or one
+	// bit per switch, set if the switch is in the hash.
+	struct sw_owner* sw_owners;
+	int sw_owners_size, num_sw_owners;
+	uint64_t** net_sw_bits;
+
+	// undo records, see fpga_journal_begin()
+	struct journal_entry* journal;
+	int journal_len;
+	int journal_depth, journal_mark;
+	int journal_lost; // a change could not be recorded
 
 	// tmp_str will be allocated to hold max(x_width, y_height)
 	// pointers, useful for string seeding when running wires.
 	const char** tmp_str;
+
+	// only set while fpga_build_model() queues tile changes
+	struct build_queue* build_q;
+
+	// switch and connpt arrays shared by TF_SHARED_SWITCHES
+	// and TF_SHARED_CONNPTS tiles, indexed by SWBOX_SWITCHES
+	// and SWBOX_CONNPTS
+	int num_swbox_templates[SWBOX_NUM_KINDS];
+	struct swbox_template* swbox_templates[SWBOX_NUM_KINDS];
+
+	// If the model was loaded from a snapshot, the per-tile
+	// conn_point_names, conn_point_dests and switches arrays
+	// point into this private (copy-on-write) mapping.
+	void* snapshot;
+	size_t snapshot_len;
+
+	// If the model was built from a static table, the same arrays
+	// point into the read-only table and are all marked shared.
+	const struct xc6_model_table* table;
+
+	// switch indices built by tile_switch_index(), tiles point
+	// into this list
+	int num_sw_indices;
+	struct sw_index** sw_indices;
+
+	// A clone shares model->str, sw_bitpos and the switchbox
+	// templates of the model it was cloned from. The strings
+	// are read_only while they are shared.
+	struct fpga_model* clone_of;
+	int num_clones;
+};
+
+// A swbox_template holds either the switches or the connection
+// point names (with their connpt_hash) of all tiles in which that
+// array is identical. Templates are immutable, a tile that needs
+// to change the array gets its own copy with tile_unshare_switches()
+// or tile_unshare_connpts() first.
+struct swbox_template
+{
+	int num_tiles;
+	// SWBOX_SWITCHES: num switches in uint32_t data
+	// SWBOX_CONNPTS: num connpt pairs in uint16_t data
+	int num;
+	void* data;
+	int connpt_hash_size;
+	uint16_t* connpt_hash;
 };
 
 enum fpga_tile_type
@@ -193,6 +259,14 @@ enum fpga_tile_type
 // on the right side.
 #define TF_WIRED			0x00008000
 #define TF_CENTER_MIDBUF		0x00010000
+// TF_SHARED_SWITCHES tiles point switches, TF_SHARED_CONNPTS tiles
+// conn_point_names and connpt_hash at a swbox_template.
+#define TF_SHARED_SWITCHES		0x00020000
+#define TF_SHARED_CONNPTS		0x00040000
+// TF_SHARED_DESTS tiles share conn_point_dests with a clone
+#define TF_SHARED_DESTS			0x00080000
+// memory layout only, not part of the floorplan
+#define TF_SHARED_MASK			(TF_SHARED_SWITCHES|TF_SHARED_CONNPTS|TF_SHARED_DESTS)
 
 #define Y_OUTER_TOP		0x0001
 #define Y_INNER_TOP		0x0002
@@ -837,6 +911,13 @@ struct fpga_tile
 	int num_conn_point_names; // conn_point_names is 2*num_conn_point_names 16-bit words
 	uint16_t* conn_point_names; // num_conn_point_names*2 16-bit-words: 16(conn)-16(str)
 
+	// optional open-addressing hash over the conn_point_names
+	// strings, maintained by connpt_names_array_append()
+	//   - connpt_hash_size is a power of 2, 0 if there is no index
+	//   - each slot holds connpt+1, 0 is a free slot
+	int connpt_hash_size;
+	uint16_t* connpt_hash;
+
 	// expect up to 28k connection point destinations to other tiles per tile
 	// 3*16 bit per destination:
 	//   - x coordinate of other tile (16bit)
@@ -852,11 +933,144 @@ struct fpga_tile
 	//        14:0  to, index into conn_point_names (not yet *2)
 	int num_switches;
 	uint32_t* switches;
+	int num_used_switches; // with SWITCH_USED
+
+	// built on first use by tile_switch_index(), 0 before
+	struct sw_index* sw_index;
 };
 
+// A sw_index lists the switches from and to each connpt of a tile,
+// in switch order. Switch i is in from_sw[from_start[connpt] ..
+// from_start[connpt+1]-1] for its from connpt, and the same for to.
+// Connpts at or above num_connpts have no switches. pair_hash
+// is an open-addressing hash of switch+1 over the from/to pair,
+// pair_size is a power of 2 and 0 marks a free slot. The index only
+// depends on the from/to part of the switches, so it survives
+// tile_unshare_switches() and switching on or off, add_switch()
+// drops it. Tiles that share a switch array share its index.
+struct sw_index
+{
+	const uint32_t* switches; // shared array it was built for, or 0
+	int num_connpts;
+	uint16_t* from_start, *to_start; // num_connpts+1 entries each
+	uint16_t* from_sw, *to_sw; // num_switches entries each
+	int pair_size;
+	uint16_t* pair_hash;
+	// built on first use by fpga_multi_switch_lookup()
+	struct sw_closure* closures;
+};
+
+// A sw_closure records which connpts the switch chains from one
+// connpt reach within max_depth switches, regardless of which
+// switches are used. reach has one bit per connpt, rank the number
+// of bits set before each 64-bit word of reach. For the n-th set
+// bit, paths[path_off[n]] is the length of the first chain that
+// fpga_switch_chain() returns to that connpt, followed by its
+// switches.
+struct sw_closure
+{
+	struct sw_closure* next;
+	int from_connpt, max_depth;
+	uint64_t* reach;
+	uint16_t* rank;
+	uint32_t* path_off;
+	uint16_t* paths;
+};
+
+#define SW_PAIR_MASK	0x3FFFFFFF // from and to connpt
+#define SW_PAIR_HASH(pair, size) \
+	((((pair) * 2654435761U) ^ (((pair) * 2654435761U) >> 15)) & ((size)-1))
+
 int fpga_build_model(struct fpga_model* model, int idcode, enum xc6_pkg pkg);
-// returns model->rc (model itself will be memset to 0)
+// returns model->rc (model itself will be memset to 0), or EBUSY
+// without freeing anything if the model still has clones
 int fpga_free_model(struct fpga_model* model);
+// fpga_clone_model() makes clone a copy of model that can be changed
+// and thrown away independently. The fabric arrays are shared and
+// copied by whichever model writes to a tile first, devices and nets
+// are copied. No strings can be added to either model while they
+// share them. Clones must be freed before the model they came from.
+int fpga_clone_model(struct fpga_model* clone, struct fpga_model* model);
+
+// fpga_set_build_threads() sets the number of threads used by
+// fpga_build_model(). 0 or 1 build serially, the model is the
+// same either way.
+#define MAX_BUILD_THREADS	64
+void fpga_set_build_threads(int num_threads);
+
+// fpga_set_lazy_build(1) makes fpga_build_model() create tiles and
+// devices, but leave the ports, connections and switches of each
+// tile queued until the tile is first queried through the control
+// API. fpga_materialize() does this eagerly for a range of tiles,
+// y2/x2 of -1 mean to the last row/column. A lazy model is never
+// written to the snapshot cache.
+void fpga_set_lazy_build(int on);
+int fpga_materialize(struct fpga_model* model, int y1, int x1,
+	int y2, int x2);
+#define MATERIALIZE_TILE(model, y, x) \
+	do { if ((model)->build_q) build_queue_flush_tile((model), (y), (x)); } while (0)
+#define MATERIALIZE_ALL(model) fpga_materialize((model), 0, 0, -1, -1)
+
+// If the environment variable FPGA_MODEL_CACHE names a directory,
+// fpga_build_model() will first try to map a snapshot for the
+// idcode/package from there, and write one after a full build.
+#define FPGA_MODEL_CACHE_ENV	"FPGA_MODEL_CACHE"
+
+// fpga_write_snapshot() saves a fully built model to path.
+// fpga_load_snapshot() maps it back in and returns 0, or
+// -1 if the file is missing, corrupt or from a different
+// snapshot format or library version. The model is memset
+// to 0 and model->rc is not touched in that case, so the
+// caller can fall back to fpga_build_model().
+int fpga_write_snapshot(struct fpga_model* model, const char* path);
+int fpga_load_snapshot(struct fpga_model* model, int idcode,
+	enum xc6_pkg pkg, const char* path);
+
+// Static model tables are generated at build time by libs/gen_tables
+// from the procedural build and linked into libfpga-model. The ports,
+// connections and switches of a die with a table are not built, the
+// tiles point into the table instead. The package does not change
+// them, so there is one table per die. The snapshot cache and
+// --lazy-build are only used for dies without a table.
+// FPGA_MODEL_TABLES=0 in the environment builds procedurally.
+#define FPGA_MODEL_TABLES_ENV	"FPGA_MODEL_TABLES"
+
+struct xc6_table_tile
+{
+	int flags;
+	int num_conn_point_names, num_conn_point_dests, num_switches;
+	// offsets into the u16 and u32 pools of the table
+	int conn_point_names_o, conn_point_dests_o, switches_o;
+};
+
+struct xc6_model_table
+{
+	int idcode;
+	int x_width, y_height;
+	int str_highest_index, str_used_slots;
+	int str_len;
+	const char* str; // arena of strarray_data()
+	int num_u16, num_u32;
+	const uint16_t* u16; // conn_point_names and conn_point_dests
+	const uint32_t* u32; // switches
+	const struct xc6_table_tile* tiles;
+};
+
+// zero-terminated, defined in the generated model_tables.c of the
+// optional libfpga-tables. Without it the symbol is 0.
+extern const struct xc6_model_table* const xc6_model_tables[]
+	__attribute__((weak));
+
+// fpga_table_strings() loads the string arena of table into an empty
+// model->str, fpga_table_tiles() points the tiles of a model with
+// tiles and devices initialized into the table.
+int fpga_table_strings(struct fpga_model* model,
+	const struct xc6_model_table* table);
+int fpga_table_tiles(struct fpga_model* model,
+	const struct xc6_model_table* table);
+// fpga_write_table() prints the C source of a table for a
+// procedurally built model, name is the suffix of all symbols.
+int fpga_write_table(FILE* f, struct fpga_model* model, const char* name);
 
 const char* fpga_tiletype_str(enum fpga_tile_type type);
 
@@ -864,6 +1078,8 @@ int init_tiles(struct fpga_model* model);
 
 int init_devices(struct fpga_model* model);
 void free_devices(struct fpga_model* model);
+// copy_devices() gives all tiles of a cloned model their own devs
+int copy_devices(struct fpga_model* model);
 
 int init_ports(struct fpga_model* model, int dup_warn);
 int init_conns(struct fpga_model* model);
@@ -879,6 +1095,13 @@ const char* wpref(struct fpga_model* model, int y, int x, const char* wire_name)
 char next_non_whitespace(const char* s);
 char last_major(const char* str, int cur_o);
 int has_connpt(struct fpga_model* model, int y, int x, const char* name);
+// connpt_lookup() returns the connpt (index into conn_point_names,
+// not yet *2) of name_i in the tile, or NO_CONN.
+int connpt_lookup(const struct fpga_tile* tile, str16_t name_i);
+// connpt_index_build() (re)builds the index if the tile has enough
+// names to benefit from it, and not with -DNO_CONNPT_INDEX.
+int connpt_index_build(struct fpga_tile* tile);
+void connpt_index_free(struct fpga_tile* tile);
 // add_connpt_name(): name_i and conn_point_o can be 0
 int add_connpt_name(struct fpga_model* model, int y, int x,
 	const char* connpt_name, int warn_if_duplicate, uint16_t* name_i,
@@ -918,6 +1141,53 @@ int add_switch(struct fpga_model* model, int y, int x, const char* from,
 int add_switch_set(struct fpga_model* model, int y, int x, const char* prefix,
 	const char** pairs, int suffix_inc);
 
+// Between build_queue_start() and build_queue_stop(), add_conn_*(),
+// add_switch() and add_connpt_name() add their strings to model->str
+// right away but only queue the tile change. build_queue_flush()
+// applies the queue with one column per worker thread. Each tile's
+// changes are applied in the order they were made, with all queued
+// conns of a tile merged into conn_point_dests at once, so the result
+// is identical to adding them one by one. has_connpt() flushes its
+// tile.
+// build_queue_free() drops whatever is still queued.
+int build_queue_start(struct fpga_model* model, int num_threads);
+void build_queue_flush_tile(struct fpga_model* model, int y, int x);
+int build_queue_flush(struct fpga_model* model);
+// build_queue_jobs() calls job_f(model, i, arg) for i from 0 to
+// num_jobs-1 with the threads of the queue, and adds their strings
+// and changes as if they had been called in that order. Jobs get a
+// view of the model in which nothing can be flushed and only
+// add_connpt_name() without name_i returns an index, a job that
+// needs either runs again serially.
+typedef int (*build_job_f)(struct fpga_model* model, int i, void* arg);
+int build_queue_jobs(struct fpga_model* model, build_job_f job_f,
+	int num_jobs, void* arg);
+int build_queue_stop(struct fpga_model* model);
+void build_queue_free(struct fpga_model* model);
+
+// share_swboxes() moves identical switch and connpt arrays into
+// templates, free_swbox_templates() releases them.
+int share_swboxes(struct fpga_model* model);
+// lend_swboxes() moves all remaining per-tile switch and connpt
+// arrays into templates so that a clone can share them.
+int lend_swboxes(struct fpga_model* model);
+int tile_unshare_switches(struct fpga_tile* tile);
+// tile_switch_index() returns the switch index of the tile, building
+// it on first use. It may be called from several threads reading
+// the same model. The indices belong to the model, free_sw_indices()
+// releases them. Returns 0 if out of memory or when built with
+// -DNO_SWITCH_INDEX, callers then scan the switches.
+#define SW_INDICES_INCREMENT	64
+const struct sw_index* tile_switch_index(struct fpga_model* model,
+	struct fpga_tile* tile);
+void free_sw_indices(struct fpga_model* model);
+int tile_unshare_connpts(struct fpga_tile* tile);
+int tile_unshare_dests(struct fpga_tile* tile);
+void free_swbox_templates(struct fpga_model* model);
+// free_tile_swboxes() frees the switch, connpt and dests arrays
+// the tiles own, those not shared with templates or another model.
+void free_tile_swboxes(struct fpga_model* model);
+
 // This will replicate the entire conn_point_names and switches arrays
 // from one tile to another, assuming that all of conn_point_names,
 // switches and conn_point_dests in the destination tile are empty.
@@ -1169,6 +1439,27 @@ str16_t fpga_iologic_wire2str_yx(struct fpga_model *model,
 const char* fpga_wire2str(enum extra_wires wire);
 str16_t fpga_wire2str_i(struct fpga_model* model, enum extra_wires wire);
 enum extra_wires fpga_str2wire(const char* str);
+
+// xc6_wire_table is a minimal perfect hash over all wire names
+// fpga_str2wire() parses, and the name of every wire indexed by
+// enum extra_wires. Both functions fall back to building or parsing
+// the name for anything not in the table, or for all names when
+// built with -DNO_WIRE_TABLE. fpga_write_wire_table() prints it for
+// model_tables.c.
+struct xc6_wire_table
+{
+	int num_names, num_buckets;
+	const uint16_t* disp; // per bucket
+	const char* const* names; // per slot
+	const uint8_t* name_len;
+	const uint16_t* wires;
+	int num_wire_str;
+	const char* const* wire_str; // per wire, 0 if not in the table
+};
+
+// in libfpga-tables as well, &xc6_wire_table is 0 without it
+extern const struct xc6_wire_table xc6_wire_table __attribute__((weak));
+int fpga_write_wire_table(FILE* f);
 int fdev_logic_inbit(pinw_idx_t idx);
 int fdev_logic_outbit(pinw_idx_t idx);
 
@@ -4120,7 +4120,7 @@ static int run_dirwire(struct fpga_model *model, int start_y, int start_x,
 		outer_term_hit = is_atyx(YX_OUTER_TERM, model, cur_y, cur_x);
 
 		if (cur_bamce == 'E' || outer_term_hit) {
-			if (net.num_pts < 2) RC_FAIL(model, EINVAL);
+			RC_ASSERT(model, net.num_pts >= 2);
 			add_conn_net(model, ADD_PREF, &net);
 			net.num_pts = 0;
 			if (outer_term_hit)
@@ -4147,10 +4147,298 @@ static int run_dirwire_0to3(struct fpga_model *model, int start_y, int start_x,
 	RC_RETURN(model);
 }
 
-static int run_dirwires(struct fpga_model* model)
+static int dirwires_ee_ww(struct fpga_model* model, int y, void* arg)
 {
-	int y, x, i;
+	RC_CHECK(model);
+	if (y < TOP_OUTER_IO || y > model->y_height-BOT_OUTER_IO
+	    || is_aty(Y_ROW_HORIZ_AXSYMM|Y_CHIP_HORIZ_REGS, model, y))
+		RC_RETURN(model);
+	run_dirwire_0to3(model, y, LEFT_INNER_COL, W_EE4, 'E');
+	run_dirwire_0to3(model, y, LEFT_INNER_COL, W_EE4, 'C');
+	run_dirwire_0to3(model, y, LEFT_INNER_COL, W_EE4, 'M');
+	run_dirwire_0to3(model, y, LEFT_INNER_COL, W_EE4, 'A');
+	run_dirwire_0to3(model, y, LEFT_INNER_COL, W_EE2, 'E');
+	run_dirwire_0to3(model, y, LEFT_INNER_COL, W_EE2, 'M');
+	run_dirwire_0to3(model, y, LEFT_INNER_COL, W_EL1, 'E');
+	run_dirwire_0to3(model, y, LEFT_INNER_COL, W_ER1, 'E');
+
+	run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WW4, 'E');
+	run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WW4, 'C');
+	run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WW4, 'M');
+	run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WW4, 'A');
+	run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WW2, 'E');
+	run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WW2, 'M');
+	run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WL1, 'E');
+	run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WR1, 'E');
+	RC_RETURN(model);
+}
+
+static int dirwires_ee_ww_term(struct fpga_model* model, int x, void* arg)
+{
+	RC_CHECK(model);
+	if (x < LEFT_IO_ROUTING || x > model->x_width-RIGHT_IO_ROUTING_O
+	    || !is_atx(X_ROUTING_COL, model, x))
+		RC_RETURN(model);
+	add_conn_bi_pref(model, TOP_INNER_ROW, x, "WW4E_S0",
+		TOP_FIRST_REGULAR, x, "WW4E_S0");
+	add_conn_bi_pref(model, TOP_INNER_ROW, x, "EL1E_S0",
+		TOP_FIRST_REGULAR, x, "EL1E_S0");
+	add_conn_bi_pref(model, TOP_INNER_ROW, x, "WR1E_S0",
+		TOP_FIRST_REGULAR, x, "WR1E_S0");
+
+	if (!is_atx(X_FABRIC_BRAM_ROUTING_COL, model, x)) {
+		add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "WW2E_N3",
+			model->y_height-BOT_LAST_REGULAR_O, x, "WW2E_N3");
+		add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "ER1E_N3",
+			model->y_height-BOT_LAST_REGULAR_O, x, "ER1E_N3");
+		add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "WL1E_N3",
+			model->y_height-BOT_LAST_REGULAR_O, x, "WL1E_N3");
+	}
+	RC_RETURN(model);
+}
+
+static int dirwires_nn_ss(struct fpga_model* model, int x, void* arg)
+{
+	int i;
+
+	RC_CHECK(model);
+	if (x < LEFT_IO_ROUTING || x > model->x_width-RIGHT_IO_ROUTING_O
+	    || !is_atx(X_ROUTING_COL, model, x))
+		RC_RETURN(model);
+	if (is_atx(X_FABRIC_BRAM_ROUTING_COL, model, x)) {
+		for (i = 0; i <= 3; i++)
+			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1-i, x, W_NN4, 'B');
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1, x, W_NN2, 'B');
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-2, x, W_NN2, 'B');
+		add_conn_bi_pref(model,
+			model->y_height-BOT_INNER_ROW-2, x, "NN2E0",
+			model->y_height-BOT_INNER_ROW-1, x, "NN2E_S0");
+
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1, x, W_NL1, 'B');
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1, x, W_NR1, 'B');
+
+	} else {
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NN4, 'E');
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NN4, 'C');
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NN4, 'M');
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NN4, 'A');
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NN2, 'E');
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NN2, 'M');
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NL1, 'E');
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NR1, 'E');
+	}
+
+	run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SS4, 'E');
+	run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SS4, 'M');
+	run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SS4, 'C');
+	run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SS4, 'A');
+	run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SS2, 'E');
+	run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SS2, 'M');
+	run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SL1, 'E');
+	run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SR1, 'E');
+	RC_RETURN(model);
+}
+
+static int dirwires_nn_ss_term(struct fpga_model* model, int x, void* arg)
+{
+	RC_CHECK(model);
+	if (x < LEFT_IO_ROUTING || x > model->x_width-RIGHT_IO_ROUTING_O
+	    || !is_atx(X_ROUTING_COL, model, x))
+		RC_RETURN(model);
+	add_conn_bi_pref(model, TOP_INNER_ROW, x, "NN2E_S0",
+		TOP_FIRST_REGULAR, x, "NN2E_S0");
+	add_conn_bi_pref(model, TOP_INNER_ROW, x, "NL1E_S0",
+		TOP_FIRST_REGULAR, x, "NL1E_S0");
+	if (!is_atx(X_FABRIC_BRAM_ROUTING_COL, model, x)) {
+		add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "SS4E_N3",
+			model->y_height-BOT_LAST_REGULAR_O, x, "SS4E_N3");
+		add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "SS2E_N3",
+			model->y_height-BOT_LAST_REGULAR_O, x, "SS2E_N3");
+		add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "SR1E_N3",
+			model->y_height-BOT_LAST_REGULAR_O, x, "SR1E_N3");
+	}
+	RC_RETURN(model);
+}
+
+static int dirwires_se_sw(struct fpga_model* model, int x, void* arg)
+{
+	RC_CHECK(model);
+	if (x < LEFT_IO_ROUTING || x > model->x_width-RIGHT_IO_ROUTING_O
+	    || !is_atx(X_ROUTING_COL, model, x))
+		RC_RETURN(model);
+	run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SE4, 'M');
+	run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SE4, 'A');
+	run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SE2, 'M');
+
+	run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SW4, 'M');
+	run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SW4, 'A');
+	run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SW2, 'M');
+
+	if (!is_atx(X_FABRIC_BRAM_ROUTING_COL, model, x)) {
+		add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "SW4E_N3",
+			model->y_height-BOT_LAST_REGULAR_O, x, "SW4E_N3");
+		add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "SW2E_N3",
+			model->y_height-BOT_LAST_REGULAR_O, x, "SW2E_N3");
+	}
+	RC_RETURN(model);
+}
+
+static int dirwires_se_sw_row(struct fpga_model* model, int y, void* arg)
+{
+	RC_CHECK(model);
+	if (y < TOP_OUTER_IO || y > model->y_height-BOT_OUTER_IO
+	    || is_aty(Y_ROW_HORIZ_AXSYMM|Y_CHIP_HORIZ_REGS, model, y))
+		RC_RETURN(model);
+	run_dirwire_0to3(model, y, LEFT_INNER_COL, W_SE4, 'E');
+	run_dirwire_0to3(model, y, LEFT_INNER_COL, W_SE4, 'C');
+	run_dirwire_0to3(model, y, LEFT_INNER_COL, W_SE2, 'E');
+
+	run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_SW4, 'E');
+	run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_SW4, 'C');
+	run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_SW2, 'E');
+	RC_RETURN(model);
+}
+
+static int dirwires_ne(struct fpga_model* model, int x, void* arg)
+{
+	int i;
+
+	RC_CHECK(model);
+	if (x < LEFT_IO_ROUTING || x > model->x_width-RIGHT_IO_ROUTING_O
+	    || !is_atx(X_ROUTING_COL, model, x))
+		RC_RETURN(model);
+	if (is_atx(X_FABRIC_BRAM_ROUTING_COL, model, x)) {
+		// NE2B is one major right, NE4B is two majors right
+		int plus_one_major, plus_two_majors;
+		plus_one_major = x+1;
+		while (plus_one_major != -1
+		       && !is_atx(X_ROUTING_COL, model, plus_one_major)) {
+			if (++plus_one_major >= model->x_width)
+				plus_one_major = -1;
+		}
+		if (plus_one_major == -1)
+			plus_two_majors = -1;
+		else {
+			plus_two_majors = plus_one_major + 1;
+			while (plus_two_majors != -1
+			       && !is_atx(X_ROUTING_COL, model, plus_two_majors)) {
+				if (++plus_two_majors >= model->x_width)
+					plus_two_majors = -1;
+			}
+		}
+		if (plus_two_majors != -1) {
+			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1, plus_two_majors, W_NE4, 'B');
+			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-2, plus_two_majors, W_NE4, 'B');
+		}
+		if (plus_one_major != -1) {
+			struct w_net net;
+
+			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1, plus_one_major, W_NE2, 'B');
+
+			net.last_inc = 2;
+			net.num_pts = 0;
+			for (i = x; i <= plus_one_major; i++) {
+				net.pt[net.num_pts].start_count = 1;
+				net.pt[net.num_pts].y = model->y_height-BOT_INNER_ROW-1;
+				net.pt[net.num_pts].x = i;
+				net.pt[net.num_pts].name = (i == plus_one_major) ? "NE2E%i" : "NE2M%i";
+				net.num_pts++;
+			}
+			add_conn_net(model, ADD_PREF, &net);
+			add_conn_bi_pref(model,
+				model->y_height-BOT_INNER_ROW-1, plus_one_major, "NE2E0",
+				model->y_height-BOT_INNER_ROW, plus_one_major, "NE2E0");
+		}
+	} else {
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NE4, 'M');
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NE4, 'A');
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NE2, 'M');
+	}
+	add_conn_bi_pref(model, TOP_INNER_ROW, x, "NE2E_S0",
+		TOP_FIRST_REGULAR, x, "NE2E_S0");
+	RC_RETURN(model);
+}
+
+static int dirwires_ne_row(struct fpga_model* model, int y, void* arg)
+{
+	RC_CHECK(model);
+	if (y < TOP_OUTER_IO || y > model->y_height-BOT_OUTER_IO
+	    || is_aty(Y_ROW_HORIZ_AXSYMM|Y_CHIP_HORIZ_REGS, model, y))
+		RC_RETURN(model);
+	run_dirwire_0to3(model, y, LEFT_INNER_COL, W_NE4, 'E');
+	run_dirwire_0to3(model, y, LEFT_INNER_COL, W_NE4, 'C');
+	run_dirwire_0to3(model, y, LEFT_INNER_COL, W_NE2, 'E');
+	RC_RETURN(model);
+}
+
+static int dirwires_nw(struct fpga_model* model, int x, void* arg)
+{
+	RC_CHECK(model);
+	if (x < LEFT_IO_ROUTING || x > model->x_width-RIGHT_IO_ROUTING_O
+	    || !is_atx(X_ROUTING_COL, model, x))
+		RC_RETURN(model);
+	if (is_atx(X_FABRIC_BRAM_ROUTING_COL, model, x)) {
+		// NW2B is one major left, NW4B is two majors left
+		int minus_one_major, minus_two_majors;
+		minus_one_major = x-1;
+		while (minus_one_major != -1
+		       && !is_atx(X_ROUTING_COL, model, minus_one_major)) {
+			if (--minus_one_major < LEFT_IO_ROUTING)
+				minus_one_major = -1;
+		}
+		if (minus_one_major == -1)
+			minus_two_majors = -1;
+		else {
+			minus_two_majors = minus_one_major - 1;
+			while (minus_two_majors != -1
+			       && !is_atx(X_ROUTING_COL, model, minus_two_majors)) {
+				if (--minus_two_majors < LEFT_IO_ROUTING)
+					minus_two_majors = -1;
+			}
+		}
+		if (minus_two_majors != -1) {
+			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1, minus_two_majors, W_NW4, 'B');
+			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-2, minus_two_majors, W_NW4, 'B');
+
+			add_conn_bi_pref(model,
+				model->y_height-BOT_INNER_ROW-2, minus_two_majors, "NW4E0",
+				model->y_height-BOT_INNER_ROW-1, minus_two_majors, "NW4E_S0");
+			add_conn_bi_pref(model,
+				model->y_height-BOT_INNER_ROW-1, minus_two_majors, "NW4E0",
+				model->y_height-BOT_INNER_ROW, minus_two_majors, "NW4E0");
+		}
+		if (minus_one_major != -1) {
+			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1, minus_one_major, W_NW2, 'B');
+			add_conn_bi_pref(model,
+				model->y_height-BOT_INNER_ROW-1, minus_one_major, "NW2E0",
+				model->y_height-BOT_INNER_ROW, minus_one_major, "NW2E0");
+		}
+	} else {
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NW4, 'M');
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NW4, 'A');
+		run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NW2, 'M');
+	}
+	add_conn_bi_pref(model, TOP_INNER_ROW, x, "NW4E_S0",
+		TOP_FIRST_REGULAR, x, "NW4E_S0");
+	add_conn_bi_pref(model, TOP_INNER_ROW, x, "NW2E_S0",
+		TOP_FIRST_REGULAR, x, "NW2E_S0");
+	RC_RETURN(model);
+}
+
+static int dirwires_nw_row(struct fpga_model* model, int y, void* arg)
+{
+	RC_CHECK(model);
+	if (y < TOP_OUTER_IO || y > model->y_height-BOT_OUTER_IO
+	    || is_aty(Y_ROW_HORIZ_AXSYMM|Y_CHIP_HORIZ_REGS, model, y))
+		RC_RETURN(model);
+	run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_NW4, 'E');
+	run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_NW4, 'C');
+	run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_NW2, 'E');
+	RC_RETURN(model);
+}
 
+static int run_dirwires(struct fpga_model* model)
+{
 	RC_CHECK(model);
 
 	//
@@ -4163,7 +4451,8 @@ static int run_dirwires(struct fpga_model* model)
 	//
 	// set_BAMCE_point() adds net entries for one such point, run_dirwire()
 	// runs one wire through the chip, run_dirwires() goes through
-	// all rows vertically.
+	// all rows vertically. Each row or column is a build queue job,
+	// so the build threads run them in parallel.
 	//
 
 	//
@@ -4171,266 +4460,37 @@ static int run_dirwires(struct fpga_model* model)
 	// WW4, WW2, WL1, WR1
 	//
 
-	for (y = TOP_OUTER_IO; y <= model->y_height-BOT_OUTER_IO; y++) {
-		if (is_aty(Y_ROW_HORIZ_AXSYMM|Y_CHIP_HORIZ_REGS, model, y))
-			continue;
-		run_dirwire_0to3(model, y, LEFT_INNER_COL, W_EE4, 'E');
-		run_dirwire_0to3(model, y, LEFT_INNER_COL, W_EE4, 'C');
-		run_dirwire_0to3(model, y, LEFT_INNER_COL, W_EE4, 'M');
-		run_dirwire_0to3(model, y, LEFT_INNER_COL, W_EE4, 'A');
-		run_dirwire_0to3(model, y, LEFT_INNER_COL, W_EE2, 'E');
-		run_dirwire_0to3(model, y, LEFT_INNER_COL, W_EE2, 'M');
-		run_dirwire_0to3(model, y, LEFT_INNER_COL, W_EL1, 'E');
-		run_dirwire_0to3(model, y, LEFT_INNER_COL, W_ER1, 'E');
-
-		run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WW4, 'E');
-		run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WW4, 'C');
-		run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WW4, 'M');
-		run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WW4, 'A');
-		run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WW2, 'E');
-		run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WW2, 'M');
-		run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WL1, 'E');
-		run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_WR1, 'E');
-	}
-	for (x = LEFT_IO_ROUTING; x <= model->x_width-RIGHT_IO_ROUTING_O; x++) {
-		if (!is_atx(X_ROUTING_COL, model, x))
-			continue;
-		add_conn_bi_pref(model, TOP_INNER_ROW, x, "WW4E_S0",
-			TOP_FIRST_REGULAR, x, "WW4E_S0");
-		add_conn_bi_pref(model, TOP_INNER_ROW, x, "EL1E_S0",
-			TOP_FIRST_REGULAR, x, "EL1E_S0");
-		add_conn_bi_pref(model, TOP_INNER_ROW, x, "WR1E_S0",
-			TOP_FIRST_REGULAR, x, "WR1E_S0");
-
-		if (!is_atx(X_FABRIC_BRAM_ROUTING_COL, model, x)) {
-			add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "WW2E_N3",
-				model->y_height-BOT_LAST_REGULAR_O, x, "WW2E_N3");
-			add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "ER1E_N3",
-				model->y_height-BOT_LAST_REGULAR_O, x, "ER1E_N3");
-			add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "WL1E_N3",
-				model->y_height-BOT_LAST_REGULAR_O, x, "WL1E_N3");
-		}
-	}
+	build_queue_jobs(model, dirwires_ee_ww, model->y_height, /*arg*/ 0);
+	build_queue_jobs(model, dirwires_ee_ww_term, model->x_width, /*arg*/ 0);
 
 	//
 	// NN4, NN2, NL1, NR1
 	// SS4, SS2, SL1, SR1
 	//
 
-	for (x = LEFT_IO_ROUTING; x <= model->x_width-RIGHT_IO_ROUTING_O; x++) {
-		if (!is_atx(X_ROUTING_COL, model, x))
-			continue;
-
-		if (is_atx(X_FABRIC_BRAM_ROUTING_COL, model, x)) {
-			for (i = 0; i <= 3; i++)
-				run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1-i, x, W_NN4, 'B');
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1, x, W_NN2, 'B');
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-2, x, W_NN2, 'B');
-			add_conn_bi_pref(model,
-				model->y_height-BOT_INNER_ROW-2, x, "NN2E0",
-				model->y_height-BOT_INNER_ROW-1, x, "NN2E_S0");
-
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1, x, W_NL1, 'B');
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1, x, W_NR1, 'B');
-
-		} else {
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NN4, 'E');
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NN4, 'C');
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NN4, 'M');
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NN4, 'A');
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NN2, 'E');
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NN2, 'M');
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NL1, 'E');
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NR1, 'E');
-		}
-
-		run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SS4, 'E');
-		run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SS4, 'M');
-		run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SS4, 'C');
-		run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SS4, 'A');
-		run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SS2, 'E');
-		run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SS2, 'M');
-		run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SL1, 'E');
-		run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SR1, 'E');
-	}
-
-	for (x = LEFT_IO_ROUTING; x <= model->x_width-RIGHT_IO_ROUTING_O; x++) {
-		if (!is_atx(X_ROUTING_COL, model, x))
-			continue;
-		add_conn_bi_pref(model, TOP_INNER_ROW, x, "NN2E_S0",
-			TOP_FIRST_REGULAR, x, "NN2E_S0");
-		add_conn_bi_pref(model, TOP_INNER_ROW, x, "NL1E_S0",
-			TOP_FIRST_REGULAR, x, "NL1E_S0");
-		if (!is_atx(X_FABRIC_BRAM_ROUTING_COL, model, x)) {
-			add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "SS4E_N3",
-				model->y_height-BOT_LAST_REGULAR_O, x, "SS4E_N3");
-			add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "SS2E_N3",
-				model->y_height-BOT_LAST_REGULAR_O, x, "SS2E_N3");
-			add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "SR1E_N3",
-				model->y_height-BOT_LAST_REGULAR_O, x, "SR1E_N3");
-		}
-	}
+	build_queue_jobs(model, dirwires_nn_ss, model->x_width, /*arg*/ 0);
+	build_queue_jobs(model, dirwires_nn_ss_term, model->x_width, /*arg*/ 0);
 
 	//
 	// SE4, SE2, SW4, SW2
 	//
 
-	for (x = LEFT_IO_ROUTING; x <= model->x_width-RIGHT_IO_ROUTING_O; x++) {
-		if (!is_atx(X_ROUTING_COL, model, x))
-			continue;
-		run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SE4, 'M');
-		run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SE4, 'A');
-		run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SE2, 'M');
-
-		run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SW4, 'M');
-		run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SW4, 'A');
-		run_dirwire_0to3(model, TOP_INNER_ROW, x, W_SW2, 'M');
-
-		if (!is_atx(X_FABRIC_BRAM_ROUTING_COL, model, x)) {
-			add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "SW4E_N3",
-				model->y_height-BOT_LAST_REGULAR_O, x, "SW4E_N3");
-			add_conn_bi_pref(model, model->y_height-BOT_INNER_ROW, x, "SW2E_N3",
-				model->y_height-BOT_LAST_REGULAR_O, x, "SW2E_N3");
-		}
-	}
-	for (y = TOP_OUTER_IO; y <= model->y_height-BOT_OUTER_IO; y++) {
-		if (is_aty(Y_ROW_HORIZ_AXSYMM|Y_CHIP_HORIZ_REGS, model, y))
-			continue;
-		run_dirwire_0to3(model, y, LEFT_INNER_COL, W_SE4, 'E');
-		run_dirwire_0to3(model, y, LEFT_INNER_COL, W_SE4, 'C');
-		run_dirwire_0to3(model, y, LEFT_INNER_COL, W_SE2, 'E');
-
-		run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_SW4, 'E');
-		run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_SW4, 'C');
-		run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_SW2, 'E');
-	}
+	build_queue_jobs(model, dirwires_se_sw, model->x_width, /*arg*/ 0);
+	build_queue_jobs(model, dirwires_se_sw_row, model->y_height, /*arg*/ 0);
 
 	//
 	// NE4, NE2
 	//
 
-	for (x = LEFT_IO_ROUTING; x <= model->x_width-RIGHT_IO_ROUTING_O; x++) {
-		if (!is_atx(X_ROUTING_COL, model, x))
-			continue;
-
-		if (is_atx(X_FABRIC_BRAM_ROUTING_COL, model, x)) {
-			// NE2B is one major right, NE4B is two majors right
-			int plus_one_major, plus_two_majors;
-			plus_one_major = x+1;
-			while (plus_one_major != -1
-			       && !is_atx(X_ROUTING_COL, model, plus_one_major)) {
-				if (++plus_one_major >= model->x_width)
-					plus_one_major = -1;
-			}
-			if (plus_one_major == -1)
-				plus_two_majors = -1;
-			else {
-				plus_two_majors = plus_one_major + 1;
-				while (plus_two_majors != -1
-				       && !is_atx(X_ROUTING_COL, model, plus_two_majors)) {
-					if (++plus_two_majors >= model->x_width)
-						plus_two_majors = -1;
-				}
-			}
-			if (plus_two_majors != -1) {
-				run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1, plus_two_majors, W_NE4, 'B');
-				run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-2, plus_two_majors, W_NE4, 'B');
-			}
-			if (plus_one_major != -1) {
-				struct w_net net;
-
-				run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1, plus_one_major, W_NE2, 'B');
-
-				net.last_inc = 2;
-				net.num_pts = 0;
-				for (i = x; i <= plus_one_major; i++) {
-					net.pt[net.num_pts].start_count = 1;
-					net.pt[net.num_pts].y = model->y_height-BOT_INNER_ROW-1;
-					net.pt[net.num_pts].x = i;
-					net.pt[net.num_pts].name = (i == plus_one_major) ? "NE2E%i" : "NE2M%i";
-					net.num_pts++;
-				}
-				add_conn_net(model, ADD_PREF, &net);
-				add_conn_bi_pref(model,
-					model->y_height-BOT_INNER_ROW-1, plus_one_major, "NE2E0",
-					model->y_height-BOT_INNER_ROW, plus_one_major, "NE2E0");
-			}
-		} else {
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NE4, 'M');
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NE4, 'A');
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NE2, 'M');
-		}
-		add_conn_bi_pref(model, TOP_INNER_ROW, x, "NE2E_S0",
-			TOP_FIRST_REGULAR, x, "NE2E_S0");
-	}
-	for (y = TOP_OUTER_IO; y <= model->y_height-BOT_OUTER_IO; y++) {
-		if (is_aty(Y_ROW_HORIZ_AXSYMM|Y_CHIP_HORIZ_REGS, model, y))
-			continue;
-		run_dirwire_0to3(model, y, LEFT_INNER_COL, W_NE4, 'E');
-		run_dirwire_0to3(model, y, LEFT_INNER_COL, W_NE4, 'C');
-		run_dirwire_0to3(model, y, LEFT_INNER_COL, W_NE2, 'E');
-	}
+	build_queue_jobs(model, dirwires_ne, model->x_width, /*arg*/ 0);
+	build_queue_jobs(model, dirwires_ne_row, model->y_height, /*arg*/ 0);
 
 	//
 	// NW4, NW2
 	//
 
-	for (x = LEFT_IO_ROUTING; x <= model->x_width-RIGHT_IO_ROUTING_O; x++) {
-		if (!is_atx(X_ROUTING_COL, model, x))
-			continue;
+	build_queue_jobs(model, dirwires_nw, model->x_width, /*arg*/ 0);
+	build_queue_jobs(model, dirwires_nw_row, model->y_height, /*arg*/ 0);
 
-		if (is_atx(X_FABRIC_BRAM_ROUTING_COL, model, x)) {
-			// NW2B is one major left, NW4B is two majors left
-			int minus_one_major, minus_two_majors;
-			minus_one_major = x-1;
-			while (minus_one_major != -1
-			       && !is_atx(X_ROUTING_COL, model, minus_one_major)) {
-				if (--minus_one_major < LEFT_IO_ROUTING)
-					minus_one_major = -1;
-			}
-			if (minus_one_major == -1)
-				minus_two_majors = -1;
-			else {
-				minus_two_majors = minus_one_major - 1;
-				while (minus_two_majors != -1
-				       && !is_atx(X_ROUTING_COL, model, minus_two_majors)) {
-					if (--minus_two_majors < LEFT_IO_ROUTING)
-						minus_two_majors = -1;
-				}
-			}
-			if (minus_two_majors != -1) {
-				run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1, minus_two_majors, W_NW4, 'B');
-				run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-2, minus_two_majors, W_NW4, 'B');
-
-				add_conn_bi_pref(model,
-					model->y_height-BOT_INNER_ROW-2, minus_two_majors, "NW4E0",
-					model->y_height-BOT_INNER_ROW-1, minus_two_majors, "NW4E_S0");
-				add_conn_bi_pref(model,
-					model->y_height-BOT_INNER_ROW-1, minus_two_majors, "NW4E0",
-					model->y_height-BOT_INNER_ROW, minus_two_majors, "NW4E0");
-			}
-			if (minus_one_major != -1) {
-				run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW-1, minus_one_major, W_NW2, 'B');
-				add_conn_bi_pref(model,
-					model->y_height-BOT_INNER_ROW-1, minus_one_major, "NW2E0",
-					model->y_height-BOT_INNER_ROW, minus_one_major, "NW2E0");
-			}
-		} else {
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NW4, 'M');
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NW4, 'A');
-			run_dirwire_0to3(model, model->y_height-BOT_INNER_ROW, x, W_NW2, 'M');
-		}
-		add_conn_bi_pref(model, TOP_INNER_ROW, x, "NW4E_S0",
-			TOP_FIRST_REGULAR, x, "NW4E_S0");
-		add_conn_bi_pref(model, TOP_INNER_ROW, x, "NW2E_S0",
-			TOP_FIRST_REGULAR, x, "NW2E_S0");
-	}
-	for (y = TOP_OUTER_IO; y <= model->y_height-BOT_OUTER_IO; y++) {
-		if (is_aty(Y_ROW_HORIZ_AXSYMM|Y_CHIP_HORIZ_REGS, model, y))
-			continue;
-		run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_NW4, 'E');
-		run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_NW4, 'C');
-		run_dirwire_0to3(model, y, model->x_width-RIGHT_INNER_O, W_NW2, 'E');
-	}
 	RC_RETURN(model);
 }
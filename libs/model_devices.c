@@ -327,6 +327,8 @@ fail:
 	return rc;
 }
 
+#define DEV_INCREMENT 4
+
 void free_devices(struct fpga_model* model)
 {
 	struct fpga_tile* tile;
@@ -353,7 +355,50 @@ void free_devices(struct fpga_model* model)
 	}
 }
 
-#define DEV_INCREMENT 4
+int copy_devices(struct fpga_model* model)
+{
+	struct fpga_tile* tile;
+	struct fpga_device* devs;
+	pinw_idx_t* req;
+	int i, j;
+
+	RC_CHECK(model);
+	for (i = 0; i < model->x_width * model->y_height; i++) {
+		tile = &model->tiles[i];
+		if (!tile->num_devs)
+			continue;
+		// The tile still points to the devs of the original model,
+		// which must not be freed by a failure midway.
+		devs = malloc(((tile->num_devs/DEV_INCREMENT)+1)*DEV_INCREMENT*sizeof(*devs));
+		if (!devs) goto fail_nomem;
+		memcpy(devs, tile->devs, tile->num_devs*sizeof(*devs));
+		for (j = 0; j < tile->num_devs; j++) {
+			if (!devs[j].pinw_req_for_cfg)
+				continue;
+			req = malloc(devs[j].num_pinw_total*sizeof(*req));
+			if (!req) {
+				while (--j >= 0) {
+					if (devs[j].pinw_req_for_cfg != tile->devs[j].pinw_req_for_cfg)
+						free(devs[j].pinw_req_for_cfg);
+				}
+				free(devs);
+				goto fail_nomem;
+			}
+			memcpy(req, devs[j].pinw_req_for_cfg,
+				devs[j].num_pinw_total*sizeof(*req));
+			devs[j].pinw_req_for_cfg = req;
+		}
+		tile->devs = devs;
+	}
+	RC_RETURN(model);
+fail_nomem:
+	// keep free_devices() away from the devs that are not ours
+	for (; i < model->x_width * model->y_height; i++) {
+		model->tiles[i].devs = 0;
+		model->tiles[i].num_devs = 0;
+	}
+	RC_FAIL(model, ENOMEM);
+}
 
 static int add_dev(struct fpga_model* model,
 	int y, int x, int type, int subtype)
@@ -6,16 +6,27 @@
 //
 
 #include <stdarg.h>
+#include <pthread.h>
 #include "model.h"
 
+enum { BQ_CONNPT = 1, BQ_CONN, BQ_SWITCH };
+
+// marks a string index of a build job, see model_str_add()
+#define STR_JOB_LOCAL	0x10000
+
+static int build_queue_add(struct fpga_model* model, int type, int y, int x,
+	int from, int flag, int to_y, int to_x, int to);
+static int model_str_add(struct fpga_model* model, const char* str, int* idx);
+
 #define NUM_PF_BUFS	32
 
 const char* pf(const char* fmt, ...)
 {
 	// safe to call it NUM_PF_BUFStimes in 1 expression,
 	// such as function params or a net structure
-	static char pf_buf[NUM_PF_BUFS][128];
-	static int last_buf = 0;
+	// The buffers are per thread.
+	static __thread char pf_buf[NUM_PF_BUFS][128];
+	static __thread int last_buf = 0;
 	va_list list;
 	last_buf = (last_buf+1)%NUM_PF_BUFS;
 	pf_buf[last_buf][0] = 0;
@@ -27,8 +38,8 @@ const char* pf(const char* fmt, ...)
 
 const char* wpref(struct fpga_model* model, int y, int x, const char* wire_name)
 {
-	static char buf[8][128];
-	static int last_buf = 0;
+	static __thread char buf[8][128];
+	static __thread int last_buf = 0;
 	const char *prefix;
 	int i;
 
@@ -95,29 +106,251 @@ const char* wpref(struct fpga_model* model, int y, int x, const char* wire_name)
 int has_connpt(struct fpga_model* model, int y, int x,
 	const char* name)
 {
-	struct fpga_tile* tile;
-	uint16_t name_i;
 	int i;
 
+	if (model->build_q)
+		build_queue_flush_tile(model, y, x);
 	i = strarray_find(&model->str, name);
 	if (i == STRIDX_NO_ENTRY)
 		return 0;
-	name_i = i;
+	return connpt_lookup(YX_TILE(model, y, x), i) != NO_CONN;
+}
 
-	tile = YX_TILE(model, y, x);
-	for (i = 0; i < tile->num_conn_point_names; i++) {
+//
+// connpt index
+//
+
+// Small tiles are faster to search linearly. Build with
+// -DNO_CONNPT_INDEX to search all tiles linearly, to compare.
+#define CONNPT_INDEX_MIN	16
+
+#define CONNPT_HASH(name_i, size)	(((name_i) * 2654435761U) & ((size)-1))
+
+static void connpt_index_insert(struct fpga_tile* tile, int connpt)
+{
+	str16_t name_i;
+	int slot;
+
+	name_i = tile->conn_point_names[connpt*2+1];
+	slot = CONNPT_HASH(name_i, tile->connpt_hash_size);
+	while (tile->connpt_hash[slot]) {
+		// keep the first connpt for a name, like a forward search
+		if (tile->conn_point_names[(tile->connpt_hash[slot]-1)*2+1] == name_i)
+			return;
+		slot = (slot+1) & (tile->connpt_hash_size-1);
+	}
+	tile->connpt_hash[slot] = connpt+1;
+}
+
+int connpt_index_build(struct fpga_tile* tile)
+{
+	int size, i;
+
+	connpt_index_free(tile);
+#ifdef NO_CONNPT_INDEX
+	return 0;
+#endif
+	if (tile->num_conn_point_names < CONNPT_INDEX_MIN)
+		return 0;
+	// keep the load factor at or below 1/2
+	for (size = CONNPT_INDEX_MIN*2; size < tile->num_conn_point_names*2; size *= 2);
+	tile->connpt_hash = calloc(size, sizeof(*tile->connpt_hash));
+	if (!tile->connpt_hash) {
+		OUT_OF_MEM();
+		return ENOMEM;
+	}
+	tile->connpt_hash_size = size;
+	for (i = 0; i < tile->num_conn_point_names; i++)
+		connpt_index_insert(tile, i);
+	return 0;
+}
+
+void connpt_index_free(struct fpga_tile* tile)
+{
+	if (!(tile->flags & TF_SHARED_CONNPTS))
+		free(tile->connpt_hash);
+	tile->connpt_hash = 0;
+	tile->connpt_hash_size = 0;
+}
+
+int connpt_lookup(const struct fpga_tile* tile, str16_t name_i)
+{
+	int slot, i;
+
+	if (!tile->connpt_hash_size) {
+		for (i = 0; i < tile->num_conn_point_names; i++) {
+			if (tile->conn_point_names[i*2+1] == name_i)
+				return i;
+		}
+		return NO_CONN;
+	}
+	slot = CONNPT_HASH(name_i, tile->connpt_hash_size);
+	while (tile->connpt_hash[slot]) {
+		i = tile->connpt_hash[slot]-1;
 		if (tile->conn_point_names[i*2+1] == name_i)
-			return 1;
+			return i;
+		slot = (slot+1) & (tile->connpt_hash_size-1);
+	}
+	return NO_CONN;
+}
+
+//
+// switch index
+//
+
+// Building an index is a write to an otherwise read-only model, so
+// concurrent readers build under this lock and publish atomically.
+// Build with -DNO_SWITCH_INDEX to scan the switches instead.
+static pthread_mutex_t s_sw_index_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct sw_index* sw_index_build(const struct fpga_tile* tile)
+{
+	struct sw_index* index;
+	int num_connpts, pair_size, slot, i;
+
+	num_connpts = 0;
+	for (i = 0; i < tile->num_switches; i++) {
+		if (SW_FROM_I(tile->switches[i]) >= num_connpts)
+			num_connpts = SW_FROM_I(tile->switches[i])+1;
+		if (SW_TO_I(tile->switches[i]) >= num_connpts)
+			num_connpts = SW_TO_I(tile->switches[i])+1;
+	}
+	// keep the load factor of the pair hash at or below 1/2
+	for (pair_size = 2; pair_size < tile->num_switches*2; pair_size *= 2);
+	// one block: from_start, to_start, from_sw, to_sw, pair_hash
+	index = malloc(sizeof(*index)
+		+ (2*(num_connpts+1) + 2*tile->num_switches + pair_size)
+		  *sizeof(uint16_t));
+	if (!index) return 0;
+	index->switches = (tile->flags & TF_SHARED_SWITCHES)
+		? tile->switches : 0;
+	index->num_connpts = num_connpts;
+	index->from_start = (uint16_t*) (index+1);
+	index->to_start = index->from_start + num_connpts+1;
+	index->from_sw = index->to_start + num_connpts+1;
+	index->to_sw = index->from_sw + tile->num_switches;
+	index->pair_size = pair_size;
+	index->pair_hash = index->to_sw + tile->num_switches;
+	index->closures = 0;
+	memset(index->from_start, 0, 2*(num_connpts+1)*sizeof(uint16_t));
+	memset(index->pair_hash, 0, pair_size*sizeof(uint16_t));
+
+	// the first of several identical switches wins, as in a scan
+	for (i = 0; i < tile->num_switches; i++) {
+		slot = SW_PAIR_HASH(tile->switches[i] & SW_PAIR_MASK, pair_size);
+		while (index->pair_hash[slot]) {
+			if (!((tile->switches[index->pair_hash[slot]-1]
+			       ^ tile->switches[i]) & SW_PAIR_MASK))
+				break;
+			slot = (slot+1) & (pair_size-1);
+		}
+		if (!index->pair_hash[slot])
+			index->pair_hash[slot] = i+1;
+	}
+
+	// count, then turn the counts into start offsets
+	for (i = 0; i < tile->num_switches; i++) {
+		index->from_start[SW_FROM_I(tile->switches[i])+1]++;
+		index->to_start[SW_TO_I(tile->switches[i])+1]++;
 	}
+	for (i = 0; i < num_connpts; i++) {
+		index->from_start[i+1] += index->from_start[i];
+		index->to_start[i+1] += index->to_start[i];
+	}
+	// Fill in switch order so that each list stays sorted. The
+	// start offsets serve as fill positions, which moves each of
+	// them to the start of the next connpt, then shift them back.
+	for (i = 0; i < tile->num_switches; i++) {
+		index->from_sw[index->from_start[SW_FROM_I(tile->switches[i])]++] = i;
+		index->to_sw[index->to_start[SW_TO_I(tile->switches[i])]++] = i;
+	}
+	for (i = num_connpts; i > 0; i--) {
+		index->from_start[i] = index->from_start[i-1];
+		index->to_start[i] = index->to_start[i-1];
+	}
+	index->from_start[0] = 0;
+	index->to_start[0] = 0;
+	return index;
+}
+
+const struct sw_index* tile_switch_index(struct fpga_model* model,
+	struct fpga_tile* tile)
+{
+	struct sw_index* index;
+	void* new_ptr;
+	int i;
+
+	index = __atomic_load_n(&tile->sw_index, __ATOMIC_ACQUIRE);
+	if (index)
+		return index;
+#ifdef NO_SWITCH_INDEX
+	return 0;
+#endif
+	if (model->rc) return 0;
+	// pair_hash holds switch+1 in 16 bits
+	if (tile->num_switches >= 0xFFFF) {
+		HERE();
+		return 0;
+	}
+	pthread_mutex_lock(&s_sw_index_lock);
+	index = tile->sw_index;
+	if (index)
+		goto out;
+	// tiles sharing a switch array share its index
+	if (tile->flags & TF_SHARED_SWITCHES) {
+		for (i = 0; i < model->num_sw_indices; i++) {
+			if (model->sw_indices[i]->switches == tile->switches) {
+				index = model->sw_indices[i];
+				goto publish;
+			}
+		}
+	}
+	if (!(model->num_sw_indices % SW_INDICES_INCREMENT)) {
+		new_ptr = realloc(model->sw_indices,
+			(model->num_sw_indices+SW_INDICES_INCREMENT)
+			  *sizeof(*model->sw_indices));
+		if (!new_ptr) goto fail;
+		model->sw_indices = new_ptr;
+	}
+	index = sw_index_build(tile);
+	if (!index) goto fail;
+	model->sw_indices[model->num_sw_indices++] = index;
+publish:
+	__atomic_store_n(&tile->sw_index, index, __ATOMIC_RELEASE);
+out:
+	pthread_mutex_unlock(&s_sw_index_lock);
+	return index;
+fail:
+	pthread_mutex_unlock(&s_sw_index_lock);
+	OUT_OF_MEM();
 	return 0;
 }
 
+void free_sw_indices(struct fpga_model* model)
+{
+	struct sw_closure* closure, *next;
+	int i;
+
+	for (i = 0; i < model->num_sw_indices; i++) {
+		for (closure = model->sw_indices[i]->closures; closure;
+		     closure = next) {
+			next = closure->next;
+			free(closure);
+		}
+		free(model->sw_indices[i]);
+	}
+	free(model->sw_indices);
+	model->sw_indices = 0;
+	model->num_sw_indices = 0;
+}
+
 #define CONN_NAMES_INCREMENT	128
 
 // add_switch() assumes that the new element is appended
 // at the end of the array.
 static void connpt_names_array_append(struct fpga_tile* tile, int name_i)
 {
+	EXIT(tile_unshare_connpts(tile));
 	if (!(tile->num_conn_point_names % CONN_NAMES_INCREMENT)) {
 		uint16_t* new_ptr = realloc(tile->conn_point_names,
 			(tile->num_conn_point_names+CONN_NAMES_INCREMENT)*2*sizeof(uint16_t));
@@ -127,6 +360,15 @@ static void connpt_names_array_append(struct fpga_tile* tile, int name_i)
 	tile->conn_point_names[tile->num_conn_point_names*2] = tile->num_conn_point_dests;
 	tile->conn_point_names[tile->num_conn_point_names*2+1] = name_i;
 	tile->num_conn_point_names++;
+
+	if (tile->connpt_hash_size
+	    && tile->num_conn_point_names*2 <= tile->connpt_hash_size) {
+		connpt_index_insert(tile, tile->num_conn_point_names-1);
+		return;
+	}
+	if (tile->connpt_hash_size
+	    || tile->num_conn_point_names == CONNPT_INDEX_MIN)
+		EXIT(connpt_index_build(tile));
 }
 
 static int add_connpt_name_i(struct fpga_model *model, int y, int x,
@@ -141,10 +383,9 @@ static int add_connpt_name_i(struct fpga_model *model, int y, int x,
 	// All destinations for a connection point must be under
 	// one unique entry for that connection point, so we
 	// first have to search for existing destinations.
-	for (i = 0; i < tile->num_conn_point_names; i++) {
-		if (tile->conn_point_names[i*2+1] == name_i)
-			break;
-	}
+	i = connpt_lookup(tile, name_i);
+	if (i == NO_CONN)
+		i = tile->num_conn_point_names;
 	if (conn_point_o) *conn_point_o = i;
 	if (i < tile->num_conn_point_names) {
 		if (warn_dup)
@@ -161,16 +402,27 @@ int add_connpt_name(struct fpga_model* model, int y, int x,
 	const char* connpt_name, int warn_if_duplicate, uint16_t* name_i,
 	int* conn_point_o)
 {
-	int rc, i;
+	int i;
 
 	RC_CHECK(model);
 
-	rc = strarray_add(&model->str, connpt_name, &i);
-	if (rc) RC_FAIL(model, rc);
-
-	RC_ASSERT(model, !OUT_OF_U16(i));
-	if (name_i) *name_i = i;
+	if (model_str_add(model, connpt_name, &i))
+		RC_RETURN(model);
+	if (name_i) {
+		// a job cannot hand out its own strings
+		if (i & STR_JOB_LOCAL) {
+			model->rc = EAGAIN;
+			RC_RETURN(model);
+		}
+		*name_i = i;
+	}
 
+	if (model->build_q) {
+		if (!conn_point_o)
+			return build_queue_add(model, BQ_CONNPT, y, x,
+				i, warn_if_duplicate, 0, 0, 0);
+		build_queue_flush_tile(model, y, x);
+	}
 	return add_connpt_name_i(model, y, x, i, warn_if_duplicate, conn_point_o);
 }
 
@@ -223,7 +475,7 @@ int add_connpt_2(struct fpga_model* model, int y, int x,
 #define CONNS_INCREMENT		128
 #undef DBG_ADD_CONN_UNI
 
-static int add_conn_uni_i(struct fpga_model *model,
+static int apply_conn_uni_i(struct fpga_model *model,
 	int from_y, int from_x, str16_t from_name, int *from_connpt_o,
 	int to_y, int to_x, str16_t to_name)
 {
@@ -271,6 +523,7 @@ static int add_conn_uni_i(struct fpga_model *model,
 		}
 	}
 
+	if (tile_unshare_dests(tile)) RC_FAIL(model, ENOMEM);
 	if (!(tile->num_conn_point_dests % CONNS_INCREMENT)) {
 		new_ptr = realloc(tile->conn_point_dests,
 			(tile->num_conn_point_dests+CONNS_INCREMENT)*3*sizeof(uint16_t));
@@ -285,6 +538,7 @@ static int add_conn_uni_i(struct fpga_model *model,
 	tile->conn_point_dests[j*3+1] = to_y;
 	tile->conn_point_dests[j*3+2] = to_name;
 	tile->num_conn_point_dests++;
+	if (tile_unshare_connpts(tile)) RC_FAIL(model, ENOMEM);
 	for (j = (*from_connpt_o)+1; j < tile->num_conn_point_names; j++)
 		tile->conn_point_names[j*2]++;
 #ifdef DBG_ADD_CONN_UNI
@@ -300,23 +554,28 @@ static int add_conn_uni_i(struct fpga_model *model,
 	RC_RETURN(model);
 }
 
+static int add_conn_uni_i(struct fpga_model *model,
+	int from_y, int from_x, int from_name, int *from_connpt_o,
+	int to_y, int to_x, int to_name)
+{
+	if (model->build_q)
+		return build_queue_add(model, BQ_CONN, from_y, from_x,
+			from_name, 0, to_y, to_x, to_name);
+	return apply_conn_uni_i(model, from_y, from_x, from_name,
+		from_connpt_o, to_y, to_x, to_name);
+}
+
 static int add_conn_uni(struct fpga_model *model,
 	int y1, int x1, const char *name1,
 	int y2, int x2, const char *name2)
 {
-	str16_t name1_i, name2_i;
-	int j, from_connpt_o, rc;
+	int name1_i, name2_i, from_connpt_o;
 
 	RC_CHECK(model);
 
-	rc = strarray_add(&model->str, name1, &j);
-	if (rc) RC_FAIL(model, rc);
-	RC_ASSERT(model, !OUT_OF_U16(j));
-	name1_i = j;
-	rc = strarray_add(&model->str, name2, &j);
-	if (rc) RC_FAIL(model, rc);
-	RC_ASSERT(model, !OUT_OF_U16(j));
-	name2_i = j;
+	if (model_str_add(model, name1, &name1_i)
+	    || model_str_add(model, name2, &name2_i))
+		RC_RETURN(model);
 
 	from_connpt_o = -1;
 	return add_conn_uni_i(model, y1, x1, name1_i, &from_connpt_o, y2, x2, name2_i);
@@ -361,23 +620,21 @@ int add_conn_range(struct fpga_model* model, add_conn_f add_conn_func,
 
 int add_conn_net(struct fpga_model* model, int add_pref, const struct w_net *net)
 {
-	int i, j, rc;
+	int i, j;
 
 	RC_CHECK(model);
 	if (net->num_pts < 2) RC_FAIL(model, EINVAL);
 	if (!net->last_inc) {
-		str16_t net_name_i[MAX_NET_POINTS];
-		int str_i, net_connpt_o[MAX_NET_POINTS];
+		int net_name_i[MAX_NET_POINTS];
+		int net_connpt_o[MAX_NET_POINTS];
 
 		for (i = 0; i < net->num_pts; i++) {
-			rc = strarray_add(&model->str, add_pref
+			if (model_str_add(model, add_pref
 				? wpref(model,
 					net->pt[i].y, net->pt[i].x,
 					net->pt[i].name)
-				: net->pt[i].name, &str_i);
-			if (rc) RC_FAIL(model, rc);
-			RC_ASSERT(model, !OUT_OF_U16(str_i));
-			net_name_i[i] = str_i;
+				: net->pt[i].name, &net_name_i[i]))
+				RC_RETURN(model);
 
 			net_connpt_o[i] = -1;
 		}
@@ -429,20 +686,21 @@ int add_conn_net(struct fpga_model* model, int add_pref, const struct w_net *net
 // model a lot.
 #undef CHECK_DUPLICATES
 
+static int add_switch_i(struct fpga_model* model, int y, int x,
+	str16_t from_idx, str16_t to_idx, int is_bidirectional);
+
 int add_switch(struct fpga_model* model, int y, int x, const char* from,
 	const char* to, int is_bidirectional)
 {
-	struct fpga_tile* tile = YX_TILE(model, y, x);
-	int rc, i, from_idx, to_idx, from_connpt_o, to_connpt_o;
-	uint32_t new_switch;
+	int rc, from_idx, to_idx;
 
 	RC_CHECK(model);
 // later this can be strarray_find() and not strarray_add(), but
 // then we need all wires and ports to be present first...
 #ifdef DBG_ALLOW_ADDPOINTS
-	rc = strarray_add(&model->str, from, &from_idx);
+	rc = model_str_add(model, from, &from_idx);
 	if (rc) goto xout;
-	rc = strarray_add(&model->str, to, &to_idx);
+	rc = model_str_add(model, to, &to_idx);
 	if (rc) goto xout;
 #else
 	from_idx = strarray_find(&model->str, from);
@@ -453,24 +711,26 @@ int add_switch(struct fpga_model* model, int y, int x, const char* from,
 			from, from_idx, to, to_idx);
 		return -1;
 	}
+	if (model->build_q)
+		return build_queue_add(model, BQ_SWITCH, y, x,
+			from_idx, is_bidirectional, 0, 0, to_idx);
+	return add_switch_i(model, y, x, from_idx, to_idx, is_bidirectional);
+xout:
+	return rc;
+}
 
-	// It seems searching backwards is a little faster than
-	// searching forwards. Merging the two loops into one
-	// made the total slower, presumably due to cache issues.
-	from_connpt_o = -1;
-	for (i = tile->num_conn_point_names-1; i >= 0; i--) {
-		if (tile->conn_point_names[i*2+1] == from_idx) {
-			from_connpt_o = i;
-			break;
-		}
-	}
-	to_connpt_o = -1;
-	for (i = tile->num_conn_point_names-1; i >= 0; i--) {
-		if (tile->conn_point_names[i*2+1] == to_idx) {
-			to_connpt_o = i;
-			break;
-		}
-	}
+static int add_switch_i(struct fpga_model* model, int y, int x,
+	str16_t from_idx, str16_t to_idx, int is_bidirectional)
+{
+	struct fpga_tile* tile = YX_TILE(model, y, x);
+	int from_connpt_o, to_connpt_o;
+#ifdef CHECK_DUPLICATES
+	int i;
+#endif
+	uint32_t new_switch;
+
+	from_connpt_o = connpt_lookup(tile, from_idx);
+	to_connpt_o = connpt_lookup(tile, to_idx);
 #ifdef DBG_ALLOW_ADDPOINTS
 	if (from_connpt_o == -1) {
 		from_connpt_o = tile->num_conn_point_names;
@@ -483,7 +743,9 @@ int add_switch(struct fpga_model* model, int y, int x, const char* from,
 #endif
 	if (from_connpt_o == -1 || to_connpt_o == -1) {
 		fprintf(stderr, "No conn point for switch from %s (%i/%i) or %s (%i/%i).\n",
-			from, from_idx, from_connpt_o, to, to_idx, to_connpt_o);
+			strarray_lookup(&model->str, from_idx), from_idx,
+			from_connpt_o, strarray_lookup(&model->str, to_idx),
+			to_idx, to_connpt_o);
 		return -1;
 	}
 	if (from_connpt_o > SWITCH_MAX_CONNPT_O
@@ -500,11 +762,17 @@ int add_switch(struct fpga_model* model, int y, int x, const char* from,
 	for (i = 0; i < tile->num_switches; i++) {
 		if ((tile->switches[i] & 0x3FFFFFFF) == (new_switch & 0x3FFFFFFF)) {
 			fprintf(stderr, "Internal error in %s:%i duplicate switch from %s to %s\n",
-				__FILE__, __LINE__, from, to);
+				__FILE__, __LINE__,
+				strarray_lookup(&model->str, from_idx),
+				strarray_lookup(&model->str, to_idx));
 			return -1;
 		}
 	}
 #endif
+	if (tile_unshare_switches(tile)) {
+		fprintf(stderr, "Out of memory %s:%i\n", __FILE__, __LINE__);
+		return -1;
+	}
 	if (!(tile->num_switches % SWITCH_ALLOC_INCREMENT)) {
 		uint32_t* new_ptr = realloc(tile->switches,
 			(tile->num_switches+SWITCH_ALLOC_INCREMENT)*sizeof(*tile->switches));
@@ -515,9 +783,8 @@ int add_switch(struct fpga_model* model, int y, int x, const char* from,
 		tile->switches = new_ptr;
 	}
 	tile->switches[tile->num_switches++] = new_switch;
+	tile->sw_index = 0;
 	return 0;
-xout:
-	return rc;
 }
 
 int add_switch_set(struct fpga_model* model, int y, int x, const char* prefix,
@@ -552,6 +819,772 @@ xout:
 	return rc;
 }
 
+//
+// build queue
+//
+
+#define BUILD_OPS_INCREMENT	256
+
+struct build_op
+{
+	uint8_t type; // BQ_CONNPT, BQ_CONN or BQ_SWITCH
+	uint8_t flag; // warn_if_duplicate or is_bidirectional
+	uint8_t job_str; // JOB_STR_FROM and JOB_STR_TO
+	str16_t from;
+	uint16_t to_y, to_x;
+	str16_t to;
+	uint16_t connpt; // BQ_CONN: connpt of from, set when flushing
+};
+
+// The ops of one build_queue_jobs() job, in the order they were
+// added, with the tile of each. Names that were not in model->str
+// yet are in str, and marked in job_str of the op.
+struct build_job
+{
+	int num_ops;
+	struct build_op* ops;
+	int* tile_i;
+	struct hashed_strarray str;
+	int rc;
+};
+
+#define JOB_STR_FROM	0x01
+#define JOB_STR_TO	0x02
+
+struct build_queue
+{
+	int num_threads;
+	int next_x; // next column to be taken by a worker
+	// pending ops per tile, in the order they were added
+	int* num_ops;
+	struct build_op** ops;
+	// only set in the model view of a build_queue_jobs() worker,
+	// which adds all its ops here
+	struct build_job* job;
+};
+
+// Jobs running in parallel only read model->str. A string that is
+// not there yet is added to the strings of the job, and returned
+// with STR_JOB_LOCAL. build_queue_jobs() adds them to model->str
+// when it queues the ops of the job.
+static int model_str_add(struct fpga_model* model, const char* str, int* idx)
+{
+	struct build_job* job;
+	int rc;
+
+	RC_CHECK(model);
+	if (model->build_q && model->build_q->job) {
+		*idx = strarray_find(&model->str, str);
+		if (*idx != STRIDX_NO_ENTRY)
+			return 0;
+		job = model->build_q->job;
+		if (!job->str.str_off && strarray_init(&job->str, STRIDX_GROW))
+			RC_FAIL(model, ENOMEM);
+		rc = strarray_add(&job->str, str, idx);
+		if (rc) RC_FAIL(model, rc);
+		*idx |= STR_JOB_LOCAL;
+		return 0;
+	}
+	rc = strarray_add(&model->str, str, idx);
+	if (rc) RC_FAIL(model, rc);
+	RC_ASSERT(model, !OUT_OF_U16(*idx));
+	RC_RETURN(model);
+}
+
+int build_queue_start(struct fpga_model* model, int num_threads)
+{
+	struct build_queue* q;
+
+	RC_CHECK(model);
+	RC_ASSERT(model, !model->build_q);
+	q = calloc(1, sizeof(*q));
+	if (!q) RC_FAIL(model, ENOMEM);
+	q->num_threads = num_threads < 1 ? 1 : num_threads;
+	q->num_ops = calloc(model->x_width*model->y_height, sizeof(*q->num_ops));
+	q->ops = calloc(model->x_width*model->y_height, sizeof(*q->ops));
+	if (!q->num_ops || !q->ops) {
+		free(q->num_ops);
+		free(q->ops);
+		free(q);
+		RC_FAIL(model, ENOMEM);
+	}
+	model->build_q = q;
+	RC_RETURN(model);
+}
+
+static int build_queue_add(struct fpga_model* model, int type, int y, int x,
+	int from, int flag, int to_y, int to_x, int to)
+{
+	struct build_queue* q = model->build_q;
+	struct build_op* op;
+	int tile_i;
+
+	RC_CHECK(model);
+	tile_i = y*model->x_width + x;
+	if (q->job) {
+		struct build_job* job = q->job;
+
+		if (!(job->num_ops % BUILD_OPS_INCREMENT)) {
+			void* new_ptr = realloc(job->ops,
+				(job->num_ops+BUILD_OPS_INCREMENT)*sizeof(*job->ops));
+			if (!new_ptr) RC_FAIL(model, ENOMEM);
+			job->ops = new_ptr;
+			new_ptr = realloc(job->tile_i,
+				(job->num_ops+BUILD_OPS_INCREMENT)*sizeof(*job->tile_i));
+			if (!new_ptr) RC_FAIL(model, ENOMEM);
+			job->tile_i = new_ptr;
+		}
+		job->tile_i[job->num_ops] = tile_i;
+		op = &job->ops[job->num_ops++];
+		op->type = type;
+		op->flag = flag;
+		op->job_str = ((from & STR_JOB_LOCAL) ? JOB_STR_FROM : 0)
+			| ((to & STR_JOB_LOCAL) ? JOB_STR_TO : 0);
+		op->from = from & ~STR_JOB_LOCAL;
+		op->to_y = to_y;
+		op->to_x = to_x;
+		op->to = to & ~STR_JOB_LOCAL;
+		return 0;
+	}
+	if (!(q->num_ops[tile_i] % BUILD_OPS_INCREMENT)) {
+		void* new_ptr = realloc(q->ops[tile_i],
+			(q->num_ops[tile_i]+BUILD_OPS_INCREMENT)*sizeof(*q->ops[tile_i]));
+		if (!new_ptr) RC_FAIL(model, ENOMEM);
+		q->ops[tile_i] = new_ptr;
+	}
+	op = &q->ops[tile_i][q->num_ops[tile_i]++];
+	op->type = type;
+	op->flag = flag;
+	op->job_str = 0;
+	op->from = from;
+	op->to_y = to_y;
+	op->to_x = to_x;
+	op->to = to;
+	return 0;
+}
+
+// Merges the queued connections into conn_point_dests of a tile with
+// one allocation, instead of inserting them one by one. The dests of
+// each connpt keep their order - existing ones first, then the queued
+// ones in the order they were added - so the result is the same as
+// calling apply_conn_uni_i() for each of them.
+static int build_tile_dests(struct fpga_model* model, int y, int x,
+	const struct build_op* ops, int num_ops)
+{
+	struct fpga_tile* tile = YX_TILE(model, y, x);
+	str16_t from_name;
+	uint16_t* dests;
+	int* start, *fill, num_names, i, j, connpt, old_end, num_dests;
+
+	RC_CHECK(model);
+	num_names = tile->num_conn_point_names;
+	start = calloc(num_names+1, sizeof(*start));
+	fill = calloc(num_names, sizeof(*fill));
+	dests = 0;
+	if (!start || !fill) goto fail_nomem;
+
+	// first pass: count the dests per connpt
+	for (i = 0; i < num_names; i++) {
+		old_end = (i < num_names-1) ? tile->conn_point_names[(i+1)*2]
+			: tile->num_conn_point_dests;
+		start[i+1] = old_end - tile->conn_point_names[i*2];
+	}
+	for (i = 0; i < num_ops; i++) {
+		if (ops[i].type == BQ_CONN)
+			start[ops[i].connpt+1]++;
+	}
+	for (i = 0; i < num_names; i++)
+		start[i+1] += start[i];
+	// round up so that apply_conn_uni_i() can keep appending
+	dests = malloc(((start[num_names]/CONNS_INCREMENT)+1)
+		*CONNS_INCREMENT*3*sizeof(*dests));
+	if (!dests) goto fail_nomem;
+
+	// second pass: existing dests, then the queued ones
+	for (i = 0; i < num_names; i++) {
+		old_end = (i < num_names-1) ? tile->conn_point_names[(i+1)*2]
+			: tile->num_conn_point_dests;
+		num_dests = old_end - tile->conn_point_names[i*2];
+		memcpy(&dests[start[i]*3],
+			&tile->conn_point_dests[tile->conn_point_names[i*2]*3],
+			num_dests*3*sizeof(*dests));
+		fill[i] = start[i] + num_dests;
+	}
+	for (i = 0; i < num_ops; i++) {
+		if (ops[i].type != BQ_CONN)
+			continue;
+		connpt = ops[i].connpt;
+		for (j = start[connpt]; j < fill[connpt]; j++) {
+			if (dests[j*3] == ops[i].to_x
+			    && dests[j*3+1] == ops[i].to_y
+			    && dests[j*3+2] == ops[i].to)
+				break;
+		}
+		if (j < fill[connpt]) {
+			from_name = tile->conn_point_names[connpt*2+1];
+			fprintf(stderr, "Duplicate conn (num_conn_point_dests %i): y%i x%i %s - y%i x%i %s.\n",
+				fill[connpt]-start[connpt],
+				y, x, strarray_lookup(&model->str, from_name),
+				ops[i].to_y, ops[i].to_x,
+				strarray_lookup(&model->str, ops[i].to));
+			continue;
+		}
+		dests[j*3] = ops[i].to_x;
+		dests[j*3+1] = ops[i].to_y;
+		dests[j*3+2] = ops[i].to;
+		fill[connpt]++;
+	}
+
+	// close the gaps left by duplicates and set the offsets
+	if (tile_unshare_connpts(tile)) goto fail_nomem;
+	num_dests = 0;
+	for (i = 0; i < num_names; i++) {
+		if (num_dests != start[i])
+			memmove(&dests[num_dests*3], &dests[start[i]*3],
+				(fill[i]-start[i])*3*sizeof(*dests));
+		tile->conn_point_names[i*2] = num_dests;
+		num_dests += fill[i]-start[i];
+	}
+	if (!(tile->flags & TF_SHARED_DESTS))
+		free(tile->conn_point_dests);
+	tile->flags &= ~TF_SHARED_DESTS;
+	tile->conn_point_dests = dests;
+	tile->num_conn_point_dests = num_dests;
+	free(start);
+	free(fill);
+	return 0;
+fail_nomem:
+	free(dests);
+	free(start);
+	free(fill);
+	RC_FAIL(model, ENOMEM);
+}
+
+// build_queue_flush_tile() only touches the one tile and reads
+// model->str, so workers can flush different tiles concurrently.
+void build_queue_flush_tile(struct fpga_model* model, int y, int x)
+{
+	struct build_queue* q = model->build_q;
+	struct build_op* op;
+	int tile_i, i, num_conns, connpt_o, connpt_o_from;
+
+	// A job cannot see the ops of the jobs before it, so it is
+	// run again on the model.
+	if (q->job) {
+		if (!model->rc) model->rc = EAGAIN;
+		return;
+	}
+	tile_i = y*model->x_width + x;
+	if (!q->num_ops[tile_i])
+		return;
+	// Names and switches are added in queue order, connections
+	// are only assigned to their connpt and then merged into
+	// conn_point_dests at the end.
+	num_conns = 0;
+	connpt_o = -1;
+	connpt_o_from = STRIDX_NO_ENTRY;
+	for (i = 0; i < q->num_ops[tile_i]; i++) {
+		op = &q->ops[tile_i][i];
+		if (op->type == BQ_CONNPT)
+			add_connpt_name_i(model, y, x, op->from, op->flag,
+				/*conn_point_o*/ 0);
+		else if (op->type == BQ_CONN) {
+			// connpt names are only appended, so the offset
+			// stays valid for consecutive ops
+			if (op->from != connpt_o_from) {
+				add_connpt_name_i(model, y, x, op->from,
+					/*warn_dup*/ 0, &connpt_o);
+				connpt_o_from = op->from;
+			}
+			op->connpt = connpt_o;
+			num_conns++;
+		} else if (add_switch_i(model, y, x, op->from, op->to, op->flag))
+			RC_SET(model, EINVAL);
+	}
+	if (num_conns)
+		build_tile_dests(model, y, x, q->ops[tile_i], q->num_ops[tile_i]);
+	free(q->ops[tile_i]);
+	q->ops[tile_i] = 0;
+	q->num_ops[tile_i] = 0;
+}
+
+// Each worker flushes into a view of the model with its own rc,
+// which is returned and merged into model->rc after the join.
+static void* build_queue_worker(void* arg)
+{
+	struct fpga_model view = *(struct fpga_model*) arg;
+	int x, y;
+
+	view.rc = 0;
+	while ((x = __sync_fetch_and_add(&view.build_q->next_x, 1))
+			< view.x_width) {
+		for (y = 0; y < view.y_height; y++)
+			build_queue_flush_tile(&view, y, x);
+	}
+	return (void*) (intptr_t) view.rc;
+}
+
+int build_queue_flush(struct fpga_model* model)
+{
+	struct build_queue* q = model->build_q;
+	pthread_t threads[MAX_BUILD_THREADS];
+	void* worker_rc;
+	int num_started, i;
+
+	RC_CHECK(model);
+	RC_ASSERT(model, q);
+	q->next_x = 0;
+	num_started = 0;
+	for (i = 1; i < q->num_threads && i < MAX_BUILD_THREADS; i++) {
+		if (pthread_create(&threads[num_started], /*attr*/ 0,
+				build_queue_worker, model))
+			break; // the remaining workers pick up the slack
+		num_started++;
+	}
+	worker_rc = build_queue_worker(model);
+	if (worker_rc && !model->rc)
+		model->rc = (intptr_t) worker_rc;
+	for (i = 0; i < num_started; i++) {
+		pthread_join(threads[i], &worker_rc);
+		if (worker_rc && !model->rc)
+			model->rc = (intptr_t) worker_rc;
+	}
+	RC_RETURN(model);
+}
+
+struct build_jobs
+{
+	struct fpga_model* model;
+	build_job_f job_f;
+	void* arg;
+	int num_jobs, next_job;
+	struct build_job* jobs;
+};
+
+// The view shares the tiles and strings of the model, which do not
+// change while jobs run, and has its own rc, tmp_str and queue.
+static void* build_jobs_worker(void* arg)
+{
+	struct build_jobs* b = arg;
+	struct fpga_model view = *b->model;
+	struct build_queue q;
+	int i;
+
+	view.tmp_str = malloc((view.x_width > view.y_height
+		? view.x_width : view.y_height) * sizeof(*view.tmp_str));
+	if (!view.tmp_str) // the jobs are left to the others
+		return 0;
+	memset(&q, 0, sizeof(q));
+	view.build_q = &q;
+	while ((i = __sync_fetch_and_add(&b->next_job, 1)) < b->num_jobs) {
+		q.job = &b->jobs[i];
+		view.rc = 0;
+		(*b->job_f)(&view, i, b->arg);
+		q.job->rc = view.rc;
+	}
+	free(view.tmp_str);
+	return 0;
+}
+
+int build_queue_jobs(struct fpga_model* model, build_job_f job_f,
+	int num_jobs, void* arg)
+{
+	struct build_queue* q = model->build_q;
+	struct build_jobs b;
+	struct build_job* job;
+	struct build_op* op;
+	pthread_t threads[MAX_BUILD_THREADS];
+	const char* str;
+	int num_started, i, j, k, from, to, * job_str;
+
+	RC_CHECK(model);
+	if (!q || q->num_threads < 2 || num_jobs < 2) {
+		for (i = 0; i < num_jobs; i++)
+			(*job_f)(model, i, arg);
+		RC_RETURN(model);
+	}
+	b.model = model;
+	b.job_f = job_f;
+	b.arg = arg;
+	b.num_jobs = num_jobs;
+	b.next_job = 0;
+	b.jobs = calloc(num_jobs, sizeof(*b.jobs));
+	if (!b.jobs) RC_FAIL(model, ENOMEM);
+	for (i = 0; i < num_jobs; i++)
+		b.jobs[i].rc = EAGAIN; // until a worker has run it
+	num_started = 0;
+	for (i = 1; i < q->num_threads && i < MAX_BUILD_THREADS; i++) {
+		if (pthread_create(&threads[num_started], /*attr*/ 0,
+				build_jobs_worker, &b))
+			break;
+		num_started++;
+	}
+	build_jobs_worker(&b);
+	for (i = 0; i < num_started; i++)
+		pthread_join(threads[i], /*retval*/ 0);
+
+	// The strings and ops are added in job order, so model->str
+	// and every tile get them in the order a serial run would have.
+	job_str = 0;
+	for (i = 0; i < num_jobs && !model->rc; i++) {
+		job = &b.jobs[i];
+		if (job->rc == EAGAIN) {
+			(*job_f)(model, i, arg);
+			continue;
+		}
+		if (job->rc) {
+			RC_SET(model, job->rc);
+			break;
+		}
+		if (job->str.str_off) {
+			free(job_str);
+			job_str = malloc((job->str.next_index+1)*sizeof(*job_str));
+			if (!job_str) {
+				RC_SET(model, ENOMEM);
+				break;
+			}
+			// STRIDX_GROW issues the indices in order
+			for (k = 1; k <= job->str.next_index; k++) {
+				str = strarray_lookup(&job->str, k);
+				if (str)
+					model_str_add(model, str, &job_str[k]);
+			}
+		}
+		for (j = 0; j < job->num_ops && !model->rc; j++) {
+			op = &job->ops[j];
+			from = (op->job_str & JOB_STR_FROM)
+				? job_str[op->from] : op->from;
+			to = (op->job_str & JOB_STR_TO)
+				? job_str[op->to] : op->to;
+			build_queue_add(model, op->type,
+				job->tile_i[j] / model->x_width,
+				job->tile_i[j] % model->x_width,
+				from, op->flag, op->to_y, op->to_x, to);
+		}
+	}
+	free(job_str);
+	for (i = 0; i < num_jobs; i++) {
+		free(b.jobs[i].ops);
+		free(b.jobs[i].tile_i);
+		if (b.jobs[i].str.str_off)
+			strarray_free(&b.jobs[i].str);
+	}
+	free(b.jobs);
+	RC_RETURN(model);
+}
+
+int build_queue_stop(struct fpga_model* model)
+{
+	if (!model->build_q) RC_RETURN(model);
+	build_queue_flush(model);
+	build_queue_free(model);
+	RC_RETURN(model);
+}
+
+void build_queue_free(struct fpga_model* model)
+{
+	struct build_queue* q = model->build_q;
+	int i;
+
+	if (!q) return;
+	for (i = 0; i < model->x_width*model->y_height; i++)
+		free(q->ops[i]);
+	free(q->ops);
+	free(q->num_ops);
+	free(q);
+	model->build_q = 0;
+}
+
+//
+// switchbox templates
+//
+
+#define SWBOX_TEMPLATES_INCREMENT	64
+
+static const int s_swbox_flag[SWBOX_NUM_KINDS] =
+	{ [SWBOX_SWITCHES] = TF_SHARED_SWITCHES,
+	  [SWBOX_CONNPTS] = TF_SHARED_CONNPTS };
+
+static void* swbox_data(const struct fpga_tile* tile, int kind,
+	int* num, int* size)
+{
+	if (kind == SWBOX_SWITCHES) {
+		*num = tile->num_switches;
+		*size = tile->num_switches*sizeof(*tile->switches);
+		return tile->switches;
+	}
+	*num = tile->num_conn_point_names;
+	*size = tile->num_conn_point_names*2*sizeof(*tile->conn_point_names);
+	return tile->conn_point_names;
+}
+
+static uint32_t swbox_hash(const void* data, int size)
+{
+	const uint8_t* p = data;
+	uint32_t hash;
+	int i;
+
+	// FNV-1a
+	hash = 2166136261U;
+	for (i = 0; i < size; i++)
+		hash = (hash ^ p[i]) * 16777619U;
+	return hash;
+}
+
+// Arrays that live in a snapshot mapping are not freed.
+static void free_swbox_data(struct fpga_model* model, void* data)
+{
+	if (model->snapshot && (char*) data >= (char*) model->snapshot
+	    && (char*) data < (char*) model->snapshot + model->snapshot_len)
+		return;
+	if (model->table
+	    && (((uint16_t*) data >= model->table->u16
+	         && (uint16_t*) data < model->table->u16 + model->table->num_u16)
+	        || ((uint32_t*) data >= model->table->u32
+	            && (uint32_t*) data < model->table->u32 + model->table->num_u32)))
+		return;
+	free(data);
+}
+
+// The tile hands its array to a new template.
+static struct swbox_template* add_swbox_template(struct fpga_model* model,
+	int kind, struct fpga_tile* tile)
+{
+	struct swbox_template* tmpl;
+	int num, size;
+
+	if (!(model->num_swbox_templates[kind] % SWBOX_TEMPLATES_INCREMENT)) {
+		void* new_ptr = realloc(model->swbox_templates[kind],
+			(model->num_swbox_templates[kind]+SWBOX_TEMPLATES_INCREMENT)
+			  *sizeof(*model->swbox_templates[kind]));
+		if (!new_ptr) return 0;
+		model->swbox_templates[kind] = new_ptr;
+	}
+	if (kind == SWBOX_CONNPTS && !tile->connpt_hash_size
+	    && connpt_index_build(tile))
+		return 0;
+	tmpl = &model->swbox_templates[kind][model->num_swbox_templates[kind]++];
+	tmpl->num_tiles = 0;
+	tmpl->data = swbox_data(tile, kind, &num, &size);
+	tmpl->num = num;
+	tmpl->connpt_hash_size = 0;
+	tmpl->connpt_hash = 0;
+	if (kind == SWBOX_CONNPTS) {
+		tmpl->connpt_hash_size = tile->connpt_hash_size;
+		tmpl->connpt_hash = tile->connpt_hash;
+	}
+	return tmpl;
+}
+
+static int share_kind(struct fpga_model* model, int kind)
+{
+	struct swbox_template* tmpl;
+	struct fpga_tile* tile;
+	uint32_t* hashes, hash;
+	int* first_tile;
+	int i, j, num, size, tmpl_size, num_tiles;
+	void* data;
+
+	hashes = 0;
+	first_tile = 0;
+	num_tiles = model->x_width * model->y_height;
+	for (i = 0; i < num_tiles; i++) {
+		tile = &model->tiles[i];
+		if (tile->flags & s_swbox_flag[kind])
+			continue;
+		data = swbox_data(tile, kind, &num, &size);
+		if (!num)
+			continue;
+
+		// Snapshot tiles already point to the same arrays,
+		// which is a lot cheaper to find than a content hash.
+		hash = 0;
+		for (j = 0; j < model->num_swbox_templates[kind]; j++) {
+			if (model->swbox_templates[kind][j].data == data)
+				break;
+		}
+		if (j >= model->num_swbox_templates[kind]) {
+			hash = swbox_hash(data, size);
+			for (j = 0; j < model->num_swbox_templates[kind]; j++) {
+				tmpl = &model->swbox_templates[kind][j];
+				if (hashes[j] == hash && tmpl->num == num
+				    && !memcmp(tmpl->data, data, size))
+					break;
+			}
+		}
+		if (j >= model->num_swbox_templates[kind]) {
+			if (!(model->num_swbox_templates[kind] % SWBOX_TEMPLATES_INCREMENT)) {
+				void* new_ptr;
+
+				tmpl_size = model->num_swbox_templates[kind]
+					+ SWBOX_TEMPLATES_INCREMENT;
+				new_ptr = realloc(hashes, tmpl_size*sizeof(*hashes));
+				if (!new_ptr) goto fail_nomem;
+				hashes = new_ptr;
+				new_ptr = realloc(first_tile, tmpl_size*sizeof(*first_tile));
+				if (!new_ptr) goto fail_nomem;
+				first_tile = new_ptr;
+			}
+			hashes[model->num_swbox_templates[kind]] = hash;
+			first_tile[model->num_swbox_templates[kind]] = i;
+			tmpl = add_swbox_template(model, kind, tile);
+			if (!tmpl) goto fail_nomem;
+		} else {
+			tmpl = &model->swbox_templates[kind][j];
+			if (data != tmpl->data)
+				free_swbox_data(model, data);
+			if (kind == SWBOX_SWITCHES)
+				tile->switches = tmpl->data;
+			else {
+				connpt_index_free(tile);
+				tile->conn_point_names = tmpl->data;
+				tile->connpt_hash_size = tmpl->connpt_hash_size;
+				tile->connpt_hash = tmpl->connpt_hash;
+			}
+		}
+		tmpl->num_tiles++;
+		tile->flags |= s_swbox_flag[kind];
+	}
+	// templates used by a single tile go back to that tile
+	for (i = j = 0; i < model->num_swbox_templates[kind]; i++) {
+		if (model->swbox_templates[kind][i].num_tiles < 2) {
+			model->tiles[first_tile[i]].flags &= ~s_swbox_flag[kind];
+			continue;
+		}
+		model->swbox_templates[kind][j++] = model->swbox_templates[kind][i];
+	}
+	model->num_swbox_templates[kind] = j;
+	free(hashes);
+	free(first_tile);
+	return 0;
+fail_nomem:
+	free(hashes);
+	free(first_tile);
+	RC_FAIL(model, ENOMEM);
+}
+
+int share_swboxes(struct fpga_model* model)
+{
+	RC_CHECK(model);
+	share_kind(model, SWBOX_SWITCHES);
+	share_kind(model, SWBOX_CONNPTS);
+	RC_RETURN(model);
+}
+
+int lend_swboxes(struct fpga_model* model)
+{
+	struct swbox_template* tmpl;
+	struct fpga_tile* tile;
+	int kind, i, num, size;
+
+	RC_CHECK(model);
+	for (kind = 0; kind < SWBOX_NUM_KINDS; kind++) {
+		for (i = 0; i < model->x_width * model->y_height; i++) {
+			tile = &model->tiles[i];
+			if (tile->flags & s_swbox_flag[kind])
+				continue;
+			swbox_data(tile, kind, &num, &size);
+			if (!num)
+				continue;
+			tmpl = add_swbox_template(model, kind, tile);
+			if (!tmpl) RC_FAIL(model, ENOMEM);
+			tmpl->num_tiles = 1;
+			tile->flags |= s_swbox_flag[kind];
+		}
+	}
+	RC_RETURN(model);
+}
+
+int tile_unshare_switches(struct fpga_tile* tile)
+{
+	uint32_t* switches;
+
+	if (!(tile->flags & TF_SHARED_SWITCHES))
+		return 0;
+	// allocate to the next increment so that appending works
+	switches = malloc(((tile->num_switches/SWITCH_ALLOC_INCREMENT)+1)*SWITCH_ALLOC_INCREMENT*sizeof(*switches));
+	if (!switches) return ENOMEM;
+	memcpy(switches, tile->switches, tile->num_switches*sizeof(*switches));
+	tile->switches = switches;
+	tile->flags &= ~TF_SHARED_SWITCHES;
+	return 0;
+}
+
+int tile_unshare_connpts(struct fpga_tile* tile)
+{
+	uint16_t* names, *hash;
+
+	if (!(tile->flags & TF_SHARED_CONNPTS))
+		return 0;
+	names = malloc(((tile->num_conn_point_names/CONN_NAMES_INCREMENT)+1)*CONN_NAMES_INCREMENT*2*sizeof(*names));
+	hash = !tile->connpt_hash_size ? 0
+		: malloc(tile->connpt_hash_size*sizeof(*hash));
+	if (!names || (tile->connpt_hash_size && !hash)) {
+		free(names);
+		free(hash);
+		return ENOMEM;
+	}
+	memcpy(names, tile->conn_point_names, tile->num_conn_point_names*2*sizeof(*names));
+	if (hash)
+		memcpy(hash, tile->connpt_hash, tile->connpt_hash_size*sizeof(*hash));
+	tile->conn_point_names = names;
+	tile->connpt_hash = hash;
+	tile->flags &= ~TF_SHARED_CONNPTS;
+	return 0;
+}
+
+int tile_unshare_dests(struct fpga_tile* tile)
+{
+	uint16_t* dests;
+
+	if (!(tile->flags & TF_SHARED_DESTS))
+		return 0;
+	dests = malloc(((tile->num_conn_point_dests/CONNS_INCREMENT)+1)*CONNS_INCREMENT*3*sizeof(*dests));
+	if (!dests) return ENOMEM;
+	memcpy(dests, tile->conn_point_dests, tile->num_conn_point_dests*3*sizeof(*dests));
+	tile->conn_point_dests = dests;
+	tile->flags &= ~TF_SHARED_DESTS;
+	return 0;
+}
+
+void free_tile_swboxes(struct fpga_model* model)
+{
+	struct fpga_tile* tile;
+	int i;
+
+	if (!model->tiles)
+		return;
+	for (i = 0; i < model->x_width * model->y_height; i++) {
+		tile = &model->tiles[i];
+		if (!(tile->flags & TF_SHARED_SWITCHES))
+			free_swbox_data(model, tile->switches);
+		if (!(tile->flags & TF_SHARED_CONNPTS))
+			free_swbox_data(model, tile->conn_point_names);
+		// The first model only lends its dests to clones, which
+		// are all freed by now.
+		if (!(tile->flags & TF_SHARED_DESTS) || !model->clone_of)
+			free_swbox_data(model, tile->conn_point_dests);
+		tile->switches = 0;
+		tile->conn_point_names = 0;
+		tile->conn_point_dests = 0;
+	}
+}
+
+void free_swbox_templates(struct fpga_model* model)
+{
+	int kind, i;
+
+	for (kind = 0; kind < SWBOX_NUM_KINDS; kind++) {
+		for (i = 0; i < model->num_swbox_templates[kind]; i++) {
+			free_swbox_data(model, model->swbox_templates[kind][i].data);
+			free(model->swbox_templates[kind][i].connpt_hash);
+		}
+		free(model->swbox_templates[kind]);
+		model->swbox_templates[kind] = 0;
+		model->num_swbox_templates[kind] = 0;
+	}
+}
+
 int replicate_switches_and_names(struct fpga_model* model,
 	int y_from, int x_from, int y_to, int x_to)
 {
@@ -572,11 +1605,18 @@ int replicate_switches_and_names(struct fpga_model* model,
 	if (!to_tile->conn_point_names) EXIT(ENOMEM);
 	memcpy(to_tile->conn_point_names, from_tile->conn_point_names, from_tile->num_conn_point_names*2*sizeof(uint16_t));
 	to_tile->num_conn_point_names = from_tile->num_conn_point_names;
+	if (from_tile->connpt_hash_size) {
+		to_tile->connpt_hash = malloc(from_tile->connpt_hash_size*sizeof(*to_tile->connpt_hash));
+		if (!to_tile->connpt_hash) EXIT(ENOMEM);
+		memcpy(to_tile->connpt_hash, from_tile->connpt_hash, from_tile->connpt_hash_size*sizeof(*to_tile->connpt_hash));
+		to_tile->connpt_hash_size = from_tile->connpt_hash_size;
+	}
 
 	to_tile->switches = malloc(((from_tile->num_switches/SWITCH_ALLOC_INCREMENT)+1)*SWITCH_ALLOC_INCREMENT*sizeof(*from_tile->switches));
 	if (!to_tile->switches) EXIT(ENOMEM);
 	memcpy(to_tile->switches, from_tile->switches, from_tile->num_switches*sizeof(*from_tile->switches));
 	to_tile->num_switches = from_tile->num_switches;
+	to_tile->sw_index = 0;
 	return 0;
 fail:
 	return rc;
@@ -933,8 +1973,8 @@ const char *fpga_connpt_str(struct fpga_model *model, enum extra_wires wire,
 	int y, int x, int dest_y, int dest_x)
 {
  	enum { NUM_BUFS = 8, BUF_SIZE = MAX_WIRENAME_LEN };
-	static char buf[NUM_BUFS][BUF_SIZE];
-	static int last_buf = 0;
+	static __thread char buf[NUM_BUFS][BUF_SIZE];
+	static __thread int last_buf = 0;
 	const char *wstr;
 	int i, wnum, wchar;
 
@@ -1714,11 +2754,11 @@ str16_t fpga_iologic_wire2str_yx(struct fpga_model *model,
 	return STRIDX_NO_ENTRY;
 }
 
-const char *fpga_wire2str(enum extra_wires wire)
+static const char* wire2str_build(enum extra_wires wire)
 {
  	enum { NUM_BUFS = 8, BUF_SIZE = MAX_WIRENAME_LEN };
-	static char buf[NUM_BUFS][BUF_SIZE];
-	static int last_buf = 0;
+	static __thread char buf[NUM_BUFS][BUF_SIZE];
+	static __thread int last_buf = 0;
 	int flags;
 
 	switch (wire) {
@@ -1919,7 +2959,7 @@ str16_t fpga_wire2str_i(struct fpga_model* model, enum extra_wires wire)
 	return strarray_find(&model->str, fpga_wire2str(wire));
 }
 
-enum extra_wires fpga_str2wire(const char* str)
+static enum extra_wires str2wire_parse(const char* str)
 {
 	const char* _str;
 	enum wire_type wtype;
@@ -2094,6 +3134,245 @@ enum extra_wires fpga_str2wire(const char* str)
 	return NO_WIRE;
 }
 
+//
+// wire table
+//
+
+// Build with -DNO_WIRE_TABLE to build and parse all wire names.
+
+// FNV-1a, the upper half picks the bucket, the lower half
+// mixed with the displacement of the bucket picks the slot.
+static uint64_t wire_hash(const char* str, int* len)
+{
+	const unsigned char* s = (const unsigned char*) str;
+	uint64_t hash = 0xCBF29CE484222325ULL;
+
+	while (*s)
+		hash = (hash ^ *s++) * 0x100000001B3ULL;
+	*len = s - (const unsigned char*) str;
+	return hash;
+}
+
+static int wire_slot(uint64_t hash, uint32_t disp, int num_names)
+{
+	uint32_t h = (uint32_t) hash ^ disp;
+
+	// murmur3 finalizer
+	h ^= h >> 16;
+	h *= 0x85EBCA6B;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35;
+	h ^= h >> 16;
+	return h % num_names;
+}
+
+const char *fpga_wire2str(enum extra_wires wire)
+{
+#ifndef NO_WIRE_TABLE
+	if (&xc6_wire_table
+	    && (unsigned) wire < xc6_wire_table.num_wire_str
+	    && xc6_wire_table.wire_str[wire])
+		return xc6_wire_table.wire_str[wire];
+#endif
+	return wire2str_build(wire);
+}
+
+enum extra_wires fpga_str2wire(const char* str)
+{
+#ifndef NO_WIRE_TABLE
+	const struct xc6_wire_table* t = &xc6_wire_table;
+	uint64_t hash;
+	int len, slot;
+
+	if (t && t->num_names) {
+		hash = wire_hash(str, &len);
+		slot = wire_slot(hash, t->disp[(hash >> 32) % t->num_buckets],
+			t->num_names);
+		if (t->name_len[slot] == len
+		    && !memcmp(t->names[slot], str, len))
+			return t->wires[slot];
+	}
+#endif
+	// aliases like INT_IOI_ or _BRK are not in the table
+	return str2wire_parse(str);
+}
+
+static const enum extra_wires s_named_wires[] = {
+	GFAN0, GFAN1, CLK0, CLK1, SR0, SR1, GND_WIRE, VCC_WIRE, FAN_B,
+	LOGICIN20, LOGICIN21, LOGICIN44, LOGICIN52,
+	LOGICIN_N21, LOGICIN_N28, LOGICIN_N52, LOGICIN_N60,
+	LOGICIN_S20, LOGICIN_S36, LOGICIN_S44, LOGICIN_S62 };
+
+struct wire_key
+{
+	char name[MAX_WIRENAME_LEN];
+	enum extra_wires wire;
+	uint64_t hash;
+	int len, bucket, slot;
+};
+
+static int add_wire_key(struct wire_key* keys, int* num_keys,
+	const char* name)
+{
+	struct wire_key* key = &keys[*num_keys];
+
+	if (strlen(name) >= sizeof(key->name)) {
+		HERE();
+		return -1;
+	}
+	strcpy(key->name, name);
+	key->wire = str2wire_parse(name);
+	// the table must return what the parser returns
+	if (key->wire == NO_WIRE) {
+		HERE();
+		return -1;
+	}
+	key->hash = wire_hash(name, &key->len);
+	(*num_keys)++;
+	return 0;
+}
+
+static int cmp_bucket_size(const void* a, const void* b)
+{
+	const int* _a = a, *_b = b;
+	return _b[1] - _a[1] ? _b[1] - _a[1] : _a[0] - _b[0];
+}
+
+int fpga_write_wire_table(FILE* f)
+{
+	enum { MAX_KEYS = 1024, MAX_DISP = 0x10000 };
+	static const char* dir_sfx[] = { "0", "1", "2", "3", "_S0", "_N3" };
+	struct wire_key* keys;
+	const char* rev[MW_LAST+1];
+	char name[MAX_WIRENAME_LEN];
+	int (*buckets)[2], *slot_key, *disp;
+	int num_keys, num_buckets, b, i, j, k, wtype, rc;
+	uint32_t d;
+
+	memset(rev, 0, sizeof(rev));
+	keys = calloc(MAX_KEYS, sizeof(*keys));
+	buckets = 0;
+	slot_key = disp = 0;
+	if (!keys) FAIL(ENOMEM);
+
+	// every name str2wire_parse() understands without alias
+	num_keys = 0;
+	for (i = 0; i < sizeof(s_named_wires)/sizeof(*s_named_wires); i++) {
+		if (add_wire_key(keys, &num_keys,
+			wire2str_build(s_named_wires[i]))) FAIL(EINVAL);
+	}
+	for (i = 0; i <= 15; i++) {
+		snprintf(name, sizeof(name), "GCLK%i", i);
+		if (add_wire_key(keys, &num_keys, name)) FAIL(EINVAL);
+	}
+	for (i = 0; i <= LOGICIN_HIGHEST; i++) {
+		snprintf(name, sizeof(name), "LOGICIN_B%i", i);
+		if (add_wire_key(keys, &num_keys, name)) FAIL(EINVAL);
+	}
+	for (i = 0; i <= LOGICOUT_HIGHEST; i++) {
+		snprintf(name, sizeof(name), "LOGICOUT%i", i);
+		if (add_wire_key(keys, &num_keys, name)) FAIL(EINVAL);
+	}
+	for (wtype = FIRST_LEN1; wtype <= LAST_LEN4; wtype++) {
+		for (i = 0; i < 2; i++) {
+			for (j = 0; j < sizeof(dir_sfx)/sizeof(*dir_sfx); j++) {
+				if (num_keys >= MAX_KEYS) FAIL(EINVAL);
+				snprintf(name, sizeof(name), "%s%c%s",
+					wire_base(wtype), i ? 'B' : 'E', dir_sfx[j]);
+				if (add_wire_key(keys, &num_keys, name))
+					FAIL(EINVAL);
+			}
+		}
+	}
+
+	// The reverse table has the names fpga_wire2str() built so
+	// far, for the fixed wires and for everything in the hash.
+	for (i = FAN_B; i <= LOGICIN_B0+LOGICIN_HIGHEST; i++)
+		rev[i] = strdup(wire2str_build(i));
+	for (i = 0; i < num_keys; i++) {
+		if (!rev[keys[i].wire])
+			rev[keys[i].wire] = strdup(wire2str_build(keys[i].wire));
+	}
+
+	// Hash and displace: the largest buckets pick their
+	// displacement first, while most slots are still free.
+	num_buckets = num_keys/2 + 1;
+	buckets = calloc(num_buckets, sizeof(*buckets));
+	disp = calloc(num_buckets, sizeof(*disp));
+	slot_key = malloc(num_keys * sizeof(*slot_key));
+	if (!buckets || !disp || !slot_key) FAIL(ENOMEM);
+	for (i = 0; i < num_buckets; i++)
+		buckets[i][0] = i;
+	for (i = 0; i < num_keys; i++) {
+		keys[i].bucket = (keys[i].hash >> 32) % num_buckets;
+		buckets[keys[i].bucket][1]++;
+	}
+	qsort(buckets, num_buckets, sizeof(*buckets), cmp_bucket_size);
+	for (i = 0; i < num_keys; i++)
+		slot_key[i] = -1;
+	for (b = 0; b < num_buckets && buckets[b][1]; b++) {
+		for (d = 0; d < MAX_DISP; d++) {
+			for (i = 0; i < num_keys; i++) {
+				if (keys[i].bucket != buckets[b][0])
+					continue;
+				keys[i].slot = wire_slot(keys[i].hash, d, num_keys);
+				if (slot_key[keys[i].slot] != -1)
+					break;
+				// mark the slot until the bucket is complete
+				slot_key[keys[i].slot] = i;
+			}
+			if (i >= num_keys)
+				break;
+			// undo the slots of this bucket
+			for (j = 0; j < i; j++) {
+				if (keys[j].bucket == buckets[b][0]
+				    && slot_key[keys[j].slot] == j)
+					slot_key[keys[j].slot] = -1;
+			}
+		}
+		if (d >= MAX_DISP) FAIL(EINVAL);
+		disp[buckets[b][0]] = d;
+	}
+
+	fprintf(f, "static const uint16_t s_wire_disp[] = {\n");
+	for (i = 0; i < num_buckets; i++)
+		fprintf(f, "%i,%s", disp[i], (i+1) % 16 ? "" : "\n");
+	fprintf(f, "};\n\nstatic const char* const s_wire_names[] = {\n");
+	for (i = 0; i < num_keys; i++)
+		fprintf(f, "\t\"%s\",\n", keys[slot_key[i]].name);
+	fprintf(f, "};\n\nstatic const uint8_t s_wire_name_len[] = {\n");
+	for (i = 0; i < num_keys; i++)
+		fprintf(f, "%i,%s", keys[slot_key[i]].len, (i+1) % 16 ? "" : "\n");
+	fprintf(f, "};\n\nstatic const uint16_t s_wire_wires[] = {\n");
+	for (i = 0; i < num_keys; i++)
+		fprintf(f, "%i,%s", keys[slot_key[i]].wire, (i+1) % 16 ? "" : "\n");
+	fprintf(f, "};\n\nstatic const char* const s_wire_str[] = {\n");
+	for (i = 0; i <= MW_LAST; i++) {
+		if (rev[i])
+			fprintf(f, "\t[%i] = \"%s\",\n", i, rev[i]);
+	}
+	fprintf(f, "};\n\n"
+		"const struct xc6_wire_table xc6_wire_table = {\n"
+		"\t.num_names = %i,\n"
+		"\t.num_buckets = %i,\n"
+		"\t.disp = s_wire_disp,\n"
+		"\t.names = s_wire_names,\n"
+		"\t.name_len = s_wire_name_len,\n"
+		"\t.wires = s_wire_wires,\n"
+		"\t.num_wire_str = sizeof(s_wire_str)/sizeof(*s_wire_str),\n"
+		"\t.wire_str = s_wire_str,\n"
+		"};\n", num_keys, num_buckets);
+	rc = ferror(f) ? EIO : 0;
+fail:
+	for (k = 0; k <= MW_LAST; k++)
+		free((void*) rev[k]);
+	free(keys);
+	free(buckets);
+	free(disp);
+	free(slot_key);
+	return rc;
+}
+
 int fdev_logic_inbit(pinw_idx_t idx)
 {
 	if (idx & LD1) {
@@ -6,12 +6,109 @@
 //
 
 #include <stdarg.h>
+#include <sys/mman.h>
 #include "model.h"
+#include "control.h"
 
 static int s_high_speed_replicate = 1;
+static int s_build_threads = 0;
+static int s_lazy_build = 0;
+
+void fpga_set_build_threads(int num_threads)
+{
+	s_build_threads = num_threads;
+}
+
+void fpga_set_lazy_build(int on)
+{
+	s_lazy_build = on;
+}
+
+int fpga_materialize(struct fpga_model* model, int y1, int x1,
+	int y2, int x2)
+{
+	int y, x;
+
+	RC_CHECK(model);
+	if (!model->build_q)
+		RC_RETURN(model);
+	if (y2 == -1) y2 = model->y_height-1;
+	if (x2 == -1) x2 = model->x_width-1;
+	if (!y1 && !x1 && y2 == model->y_height-1 && x2 == model->x_width-1) {
+		// the whole model, same as a full build
+		build_queue_stop(model);
+		share_swboxes(model);
+		RC_RETURN(model);
+	}
+	RC_ASSERT(model, y1 >= 0 && x1 >= 0 && y2 < model->y_height
+		&& x2 < model->x_width);
+	for (y = y1; y <= y2; y++) {
+		for (x = x1; x <= x2; x++)
+			build_queue_flush_tile(model, y, x);
+	}
+	RC_RETURN(model);
+}
+
+static int build_model(struct fpga_model* model, int idcode, enum xc6_pkg pkg);
+
+static const struct xc6_model_table* find_table(int idcode)
+{
+	const struct xc_die* die;
+	const char* env;
+	int i;
+
+	// libfpga-tables is optional
+	if (!xc6_model_tables)
+		return 0;
+	env = getenv(FPGA_MODEL_TABLES_ENV);
+	if (env && !strcmp(env, "0"))
+		return 0;
+	// build threads and lazy builds only exist for the
+	// procedural build, asking for them selects it
+	if (s_build_threads || s_lazy_build)
+		return 0;
+	die = xc_die_info(idcode);
+	if (!die)
+		return 0;
+	for (i = 0; xc6_model_tables[i]; i++) {
+		if (xc6_model_tables[i]->idcode == die->idcode)
+			return xc6_model_tables[i];
+	}
+	return 0;
+}
 
 int fpga_build_model(struct fpga_model* model, int idcode, enum xc6_pkg pkg)
 {
+	const char* cache_dir;
+	char path[1024];
+
+	// A snapshot maps in a little faster than the tables
+	// are applied, so the cache is used with tables too.
+	cache_dir = getenv(FPGA_MODEL_CACHE_ENV);
+	if (!cache_dir || !*cache_dir)
+		return build_model(model, idcode, pkg);
+
+	snprintf(path, sizeof(path), "%s/xc6_%08x_%i.snap",
+		cache_dir, idcode, pkg);
+	if (!fpga_load_snapshot(model, idcode, pkg, path))
+		return 0;
+	// missing or stale snapshot, rebuild and refresh it
+	build_model(model, idcode, pkg);
+	RC_CHECK(model);
+	if (model->build_q)
+		return 0; // lazy
+	if (fpga_write_snapshot(model, path)) {
+		// the model is fine, only the cache failed
+		fprintf(stderr, "#W %s:%i cannot write snapshot %s\n",
+			__FILE__, __LINE__, path);
+		model->rc = 0;
+	}
+	return 0;
+}
+
+static int build_model(struct fpga_model* model, int idcode, enum xc6_pkg pkg)
+{
+	const struct xc6_model_table* table;
 	int rc;
 
 	memset(model, 0, sizeof(*model));
@@ -22,6 +119,17 @@ int fpga_build_model(struct fpga_model* model, int idcode, enum xc6_pkg pkg)
 	rc = get_xc6_routing_bitpos(&model->sw_bitpos, &model->num_bitpos);
 	if (rc) RC_FAIL(model, rc);
 
+	table = find_table(idcode);
+	if (table) {
+		// With the strings loaded first, tiles and devices
+		// find all their names already interned.
+		fpga_table_strings(model, table);
+		init_tiles(model);
+		init_devices(model);
+		fpga_table_tiles(model, table);
+		RC_RETURN(model);
+	}
+
 	// The order of tiles, then devices, then ports, then
 	// connections and finally switches is important so
 	// that the codes can build upon each other.
@@ -30,30 +138,134 @@ int fpga_build_model(struct fpga_model* model, int idcode, enum xc6_pkg pkg)
 	init_devices(model);
 	if (s_high_speed_replicate)
 		replicate_routing_switches(model);
+	// Ports, conns and switches are queued per tile, which lets
+	// the conns of a tile be built in one go.
+	build_queue_start(model, s_build_threads);
 	// todo: compare.ports only works if other switches and conns
 	//       are disabled, as long as not all connections are supported
 	init_ports(model, /*dup_warn*/ !s_high_speed_replicate);
 	init_conns(model);
 	init_switches(model, /*routing_sw*/ !s_high_speed_replicate);
+	if (s_lazy_build)
+		RC_RETURN(model);
+	build_queue_stop(model);
+	share_swboxes(model);
 
 	RC_RETURN(model);
 }
 
 int fpga_free_model(struct fpga_model* model)
 {
-	int rc;
+	int i, rc;
 
 	if (!model) return 0;
+	if (model->num_clones) {
+		fprintf(stderr, "#E %s:%i model freed before its %i clones\n",
+			__FILE__, __LINE__, model->num_clones);
+		return EBUSY;
+	}
 	rc = model->rc;
+	build_queue_free(model);
 	free_devices(model);
+	fnet_free_all(model);
+	fpga_journal_free(model);
 	free(model->tmp_str);
-	strarray_free(&model->str);
+	if (model->tiles) {
+		for (i = 0; i < model->x_width * model->y_height; i++)
+			connpt_index_free(&model->tiles[i]);
+	}
+	free_tile_swboxes(model);
+	free_swbox_templates(model);
+	free_sw_indices(model);
 	free(model->tiles);
-	free_xc6_routing_bitpos(model->sw_bitpos);
+	if (model->clone_of) {
+		// the last clone gone, the strings can grow again
+		if (!--model->clone_of->num_clones
+		    && !model->clone_of->clone_of)
+			model->clone_of->str.read_only = 0;
+	} else {
+		strarray_free(&model->str);
+		free_xc6_routing_bitpos(model->sw_bitpos);
+	}
+	if (model->snapshot)
+		munmap(model->snapshot, model->snapshot_len);
 	memset(model, 0, sizeof(*model));
 	return rc;
 }
 
+int fpga_clone_model(struct fpga_model* clone, struct fpga_model* model)
+{
+	struct fpga_tile* tile;
+	int i, num_tiles;
+
+	memset(clone, 0, sizeof(*clone));
+	RC_CHECK(model);
+	MATERIALIZE_ALL(model);
+	// After lending, every switch and connpt array belongs to a
+	// template of model, and every dests array is marked shared,
+	// so whichever model writes first makes its own copy.
+	lend_swboxes(model);
+	RC_CHECK(model);
+	num_tiles = model->x_width * model->y_height;
+	for (i = 0; i < num_tiles; i++) {
+		tile = &model->tiles[i];
+		if (tile->num_conn_point_dests)
+			tile->flags |= TF_SHARED_DESTS;
+	}
+
+	// Only the geometry and what is shared are copied, the tiles
+	// keep pointing at the templates, indices, snapshot or table
+	// of model. Both copies of str point at the same arrays, so
+	// neither may add strings until the last clone is freed.
+	model->str.read_only = 1;
+	clone->die = model->die;
+	clone->pkg = model->pkg;
+	clone->x_width = model->x_width;
+	clone->y_height = model->y_height;
+	clone->center_x = model->center_x;
+	clone->center_y = model->center_y;
+	clone->left_gclk_sep_x = model->left_gclk_sep_x;
+	clone->right_gclk_sep_x = model->right_gclk_sep_x;
+	memcpy(clone->x_major, model->x_major, sizeof(clone->x_major));
+	clone->sw_bitpos = model->sw_bitpos;
+	clone->num_bitpos = model->num_bitpos;
+	clone->str = model->str;
+	clone->table = model->table;
+	clone->clone_of = model;
+	model->num_clones++;
+
+	clone->tmp_str = malloc((model->x_width > model->y_height
+		? model->x_width : model->y_height) * sizeof(*clone->tmp_str));
+	clone->tiles = malloc(num_tiles * sizeof(*clone->tiles));
+	if (!clone->tmp_str || !clone->tiles) {
+		free(clone->tiles);
+		clone->tiles = 0;
+		RC_FAIL(clone, ENOMEM);
+	}
+	memcpy(clone->tiles, model->tiles, num_tiles * sizeof(*clone->tiles));
+	for (i = 0; i < num_tiles; i++) {
+		tile = &clone->tiles[i];
+		// empty arrays are not lent, the clone starts without
+		// them so that it only frees what it allocated itself
+		if (tile->num_switches)
+			tile->flags |= TF_SHARED_SWITCHES;
+		else
+			tile->switches = 0;
+		if (tile->num_conn_point_names)
+			tile->flags |= TF_SHARED_CONNPTS;
+		else {
+			tile->conn_point_names = 0;
+			tile->connpt_hash = 0;
+			tile->connpt_hash_size = 0;
+		}
+		if (!tile->num_conn_point_dests)
+			tile->conn_point_dests = 0;
+	}
+	copy_devices(clone);
+	fnet_copy_all(clone, model);
+	RC_RETURN(clone);
+}
+
 static const char* fpga_ttstr[] = // tile type strings
 {
 	[NA] = "NA",
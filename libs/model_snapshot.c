@@ -0,0 +1,582 @@
+//
+// Author: Wolfgang Spraul
+//
+// This is free and unencumbered software released into the public domain.
+// For details see the UNLICENSE file at the root of the source tree.
+//
+
+#include <sys/mman.h>
+#include "model.h"
+
+//
+// A snapshot is one file that can be mapped in as a whole. All
+// references inside the file are byte offsets from the start of
+// the file, so the mapping can land at any address. Every
+// section starts 8-byte aligned.
+//
+// The raw struct fpga_model, struct fpga_tile and struct
+// fpga_device are stored as they are in memory, with all
+// pointers invalid. The loader only takes the scalar members
+// from them and fixes up every pointer.
+//
+// Bump SNAPSHOT_VERSION whenever the file layout or the
+// model construction changes.
+//
+
+#define SNAPSHOT_MAGIC		"FPGASNAP"
+#define SNAPSHOT_VERSION	5
+#ifndef LIBS_VERSION
+  #define LIBS_VERSION		"unknown"
+#endif
+
+struct snapshot_hdr
+{
+	char magic[8];
+	uint32_t version;
+	char libs_version[16];
+	uint32_t sizeof_model, sizeof_tile, sizeof_device;
+	int32_t idcode;
+	int32_t pkg;
+	uint64_t file_len;
+
+	uint64_t model_o; // struct fpga_model
+	int32_t num_bitpos;
+	uint64_t bitpos_o; // num_bitpos * struct xc6_routing_bitpos
+	int32_t str_highest_index;
+	int32_t str_len;
+	uint64_t str_o; // str_len bytes of string arena
+	uint64_t tiles_o; // x_width*y_height * struct snapshot_tile
+};
+
+struct snapshot_tile
+{
+	struct fpga_tile tile;
+	uint64_t devs_o; // num_devs * struct fpga_device
+	uint64_t pinw_o; // num_devs * uint64_t offsets to pinw arrays
+	uint64_t conn_point_names_o;
+	uint64_t conn_point_dests_o;
+	uint64_t switches_o;
+};
+
+static int s_write_at(FILE* f, uint64_t* o, const void* data, size_t len)
+{
+	static const char zero[8];
+	long pos;
+
+	pos = ftell(f);
+	if (pos < 0) return -1;
+	if (pos % 8) {
+		if (fwrite(zero, 8 - pos%8, 1, f) != 1)
+			return -1;
+		pos += 8 - pos%8;
+	}
+	if (o) *o = pos;
+	if (len && fwrite(data, len, 1, f) != 1)
+		return -1;
+	return 0;
+}
+
+int fpga_write_snapshot(struct fpga_model* model, const char* path)
+{
+	struct snapshot_hdr hdr;
+	struct snapshot_tile* tiles;
+	struct fpga_tile* tile;
+	struct swbox_template* tmpl;
+	uint64_t* pinw_o, *swbox_o[SWBOX_NUM_KINDS];
+	const char* str_data;
+	char tmp_path[1024];
+	FILE* f;
+	int num_tiles, str_len, i, j, rc;
+
+	RC_CHECK(model);
+	MATERIALIZE_ALL(model);
+	tiles = 0;
+	pinw_o = 0;
+	swbox_o[SWBOX_SWITCHES] = swbox_o[SWBOX_CONNPTS] = 0;
+	f = 0;
+
+	num_tiles = model->x_width * model->y_height;
+	tiles = calloc(num_tiles, sizeof(*tiles));
+	for (i = 0; i < SWBOX_NUM_KINDS; i++) {
+		swbox_o[i] = calloc(model->num_swbox_templates[i]+1,
+			sizeof(*swbox_o[i]));
+		if (!swbox_o[i]) FAIL(ENOMEM);
+	}
+	if (!tiles) FAIL(ENOMEM);
+
+	// write to a temporary file first so that concurrent
+	// readers never see a partial snapshot
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%i", path, (int) getpid());
+	f = fopen(tmp_path, "w");
+	if (!f) FAIL(errno);
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic));
+	hdr.version = SNAPSHOT_VERSION;
+	strncpy(hdr.libs_version, LIBS_VERSION, sizeof(hdr.libs_version)-1);
+	hdr.sizeof_model = sizeof(struct fpga_model);
+	hdr.sizeof_tile = sizeof(struct fpga_tile);
+	hdr.sizeof_device = sizeof(struct fpga_device);
+	hdr.idcode = model->die->idcode;
+	hdr.pkg = model->pkg->pkg;
+	if (s_write_at(f, 0, &hdr, sizeof(hdr))) FAIL(EIO);
+
+	if (s_write_at(f, &hdr.model_o, model, sizeof(*model))) FAIL(EIO);
+	hdr.num_bitpos = model->num_bitpos;
+	if (s_write_at(f, &hdr.bitpos_o, model->sw_bitpos,
+		model->num_bitpos * sizeof(*model->sw_bitpos))) FAIL(EIO);
+
+	hdr.str_highest_index = model->str.highest_index;
+	str_data = strarray_data(&model->str, &str_len);
+	hdr.str_len = str_len;
+	if (s_write_at(f, &hdr.str_o, str_data, str_len)) FAIL(EIO);
+
+	// shared arrays are written once, the tiles
+	// point at the same offsets
+	for (i = 0; i < model->num_swbox_templates[SWBOX_SWITCHES]; i++) {
+		tmpl = &model->swbox_templates[SWBOX_SWITCHES][i];
+		if (s_write_at(f, &swbox_o[SWBOX_SWITCHES][i], tmpl->data,
+			tmpl->num * sizeof(*tile->switches)))
+			FAIL(EIO);
+	}
+	for (i = 0; i < model->num_swbox_templates[SWBOX_CONNPTS]; i++) {
+		tmpl = &model->swbox_templates[SWBOX_CONNPTS][i];
+		if (s_write_at(f, &swbox_o[SWBOX_CONNPTS][i], tmpl->data,
+			tmpl->num * 2*sizeof(*tile->conn_point_names)))
+			FAIL(EIO);
+	}
+	for (i = 0; i < num_tiles; i++) {
+		tile = &model->tiles[i];
+		tiles[i].tile = *tile;
+		if (s_write_at(f, &tiles[i].conn_point_dests_o,
+			tile->conn_point_dests, tile->num_conn_point_dests
+			  * 3*sizeof(*tile->conn_point_dests)))
+			FAIL(EIO);
+		j = model->num_swbox_templates[SWBOX_SWITCHES];
+		if (tile->flags & TF_SHARED_SWITCHES) {
+			for (j = 0; j < model->num_swbox_templates[SWBOX_SWITCHES]; j++) {
+				if (model->swbox_templates[SWBOX_SWITCHES][j].data == tile->switches)
+					break;
+			}
+		}
+		// a clone shares arrays it has no templates for
+		if (j < model->num_swbox_templates[SWBOX_SWITCHES])
+			tiles[i].switches_o = swbox_o[SWBOX_SWITCHES][j];
+		else if (s_write_at(f, &tiles[i].switches_o,
+			tile->switches, tile->num_switches
+			  * sizeof(*tile->switches)))
+			FAIL(EIO);
+		j = model->num_swbox_templates[SWBOX_CONNPTS];
+		if (tile->flags & TF_SHARED_CONNPTS) {
+			for (j = 0; j < model->num_swbox_templates[SWBOX_CONNPTS]; j++) {
+				if (model->swbox_templates[SWBOX_CONNPTS][j].data == tile->conn_point_names)
+					break;
+			}
+		}
+		// a clone shares arrays it has no templates for
+		if (j < model->num_swbox_templates[SWBOX_CONNPTS])
+			tiles[i].conn_point_names_o = swbox_o[SWBOX_CONNPTS][j];
+		else if (s_write_at(f, &tiles[i].conn_point_names_o,
+			tile->conn_point_names, tile->num_conn_point_names
+			  * 2*sizeof(*tile->conn_point_names)))
+			FAIL(EIO);
+		if (!tile->num_devs)
+			continue;
+		pinw_o = calloc(tile->num_devs, sizeof(*pinw_o));
+		if (!pinw_o) FAIL(ENOMEM);
+		for (j = 0; j < tile->num_devs; j++) {
+			if (!tile->devs[j].num_pinw_total)
+				continue;
+			if (s_write_at(f, &pinw_o[j], tile->devs[j].pinw,
+				tile->devs[j].num_pinw_total
+				  * sizeof(*tile->devs[j].pinw)))
+				FAIL(EIO);
+		}
+		if (s_write_at(f, &tiles[i].pinw_o, pinw_o,
+			tile->num_devs * sizeof(*pinw_o))
+		    || s_write_at(f, &tiles[i].devs_o, tile->devs,
+			tile->num_devs * sizeof(*tile->devs)))
+			FAIL(EIO);
+		free(pinw_o);
+		pinw_o = 0;
+	}
+	if (s_write_at(f, &hdr.tiles_o, tiles, num_tiles * sizeof(*tiles)))
+		FAIL(EIO);
+
+	hdr.file_len = ftell(f);
+	if (fseek(f, 0, SEEK_SET)
+	    || fwrite(&hdr, sizeof(hdr), 1, f) != 1)
+		FAIL(EIO);
+	if (fclose(f)) {
+		f = 0;
+		FAIL(EIO);
+	}
+	f = 0;
+	if (rename(tmp_path, path)) FAIL(errno);
+
+	free(swbox_o[SWBOX_SWITCHES]);
+	free(swbox_o[SWBOX_CONNPTS]);
+	free(tiles);
+	return 0;
+fail:
+	if (f) {
+		fclose(f);
+		unlink(tmp_path);
+	}
+	free(pinw_o);
+	free(swbox_o[SWBOX_SWITCHES]);
+	free(swbox_o[SWBOX_CONNPTS]);
+	free(tiles);
+	RC_SET(model, rc);
+	RC_RETURN(model);
+}
+
+// s_snap() returns a pointer into the mapping, or 0 if the
+// range is outside the file.
+static void* s_snap(struct fpga_model* model, uint64_t o, uint64_t len)
+{
+	if (o > model->snapshot_len || len > model->snapshot_len - o) {
+		HERE();
+		return 0;
+	}
+	return (uint8_t*) model->snapshot + o;
+}
+
+int fpga_load_snapshot(struct fpga_model* model, int idcode,
+	enum xc6_pkg pkg, const char* path)
+{
+	struct snapshot_hdr* hdr;
+	struct snapshot_tile* tiles;
+	struct fpga_model* snap_model;
+	struct fpga_tile* tile;
+	uint64_t* pinw_o;
+	const char* bin_data;
+	struct stat st;
+	int fd, num_tiles, max_wh, i, j;
+
+	memset(model, 0, sizeof(*model));
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return -1;
+	if (fstat(fd, &st) || st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return -1;
+	}
+	model->snapshot_len = st.st_size;
+	// MAP_PRIVATE lets switch changes land in private pages
+	// without ever touching the file.
+	model->snapshot = mmap(0, model->snapshot_len, PROT_READ|PROT_WRITE,
+		MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (model->snapshot == MAP_FAILED) {
+		model->snapshot = 0;
+		goto mismatch;
+	}
+	hdr = model->snapshot;
+	if (memcmp(hdr->magic, SNAPSHOT_MAGIC, sizeof(hdr->magic))
+	    || hdr->version != SNAPSHOT_VERSION
+	    || strncmp(hdr->libs_version, LIBS_VERSION, sizeof(hdr->libs_version))
+	    || hdr->sizeof_model != sizeof(struct fpga_model)
+	    || hdr->sizeof_tile != sizeof(struct fpga_tile)
+	    || hdr->sizeof_device != sizeof(struct fpga_device)
+	    || !xc_die_info(idcode) || hdr->idcode != xc_die_info(idcode)->idcode
+	    || hdr->pkg != pkg || hdr->file_len != model->snapshot_len)
+		goto mismatch;
+
+	snap_model = s_snap(model, hdr->model_o, sizeof(*snap_model));
+	if (!snap_model) goto mismatch;
+	model->x_width = snap_model->x_width;
+	model->y_height = snap_model->y_height;
+	model->center_x = snap_model->center_x;
+	model->center_y = snap_model->center_y;
+	model->left_gclk_sep_x = snap_model->left_gclk_sep_x;
+	model->right_gclk_sep_x = snap_model->right_gclk_sep_x;
+	memcpy(model->x_major, snap_model->x_major, sizeof(model->x_major));
+	model->die = xc_die_info(idcode);
+	model->pkg = xc6_pkg_info(pkg);
+	if (!model->die || !model->pkg) goto mismatch;
+	num_tiles = model->x_width * model->y_height;
+
+	// The small arrays that have their own free function are
+	// copied to the heap, only the per-tile arrays stay mapped.
+	model->sw_bitpos = malloc(hdr->num_bitpos * sizeof(*model->sw_bitpos));
+	if (!model->sw_bitpos) goto mismatch;
+	bin_data = s_snap(model, hdr->bitpos_o,
+		hdr->num_bitpos * sizeof(*model->sw_bitpos));
+	if (!bin_data) goto mismatch;
+	memcpy(model->sw_bitpos, bin_data,
+		hdr->num_bitpos * sizeof(*model->sw_bitpos));
+	model->num_bitpos = hdr->num_bitpos;
+
+	if (strarray_init(&model->str, hdr->str_highest_index))
+		goto mismatch;
+	bin_data = s_snap(model, hdr->str_o, hdr->str_len);
+	if (!bin_data
+	    || strarray_load(&model->str, bin_data, hdr->str_len))
+		goto mismatch;
+
+	max_wh = model->x_width > model->y_height
+		? model->x_width : model->y_height;
+	model->tmp_str = malloc(max_wh * sizeof(*model->tmp_str));
+	model->tiles = calloc(num_tiles, sizeof(*model->tiles));
+	if (!model->tmp_str || !model->tiles) goto mismatch;
+	tiles = s_snap(model, hdr->tiles_o, num_tiles * sizeof(*tiles));
+	if (!tiles) goto mismatch;
+	for (i = 0; i < num_tiles; i++) {
+		tile = &model->tiles[i];
+		tile->type = tiles[i].tile.type;
+		// share_swboxes() below sets the shared flags again
+		tile->flags = tiles[i].tile.flags & ~TF_SHARED_MASK;
+		tile->num_conn_point_names = tiles[i].tile.num_conn_point_names;
+		tile->num_conn_point_dests = tiles[i].tile.num_conn_point_dests;
+		tile->num_switches = tiles[i].tile.num_switches;
+		tile->conn_point_names = s_snap(model,
+			tiles[i].conn_point_names_o,
+			tile->num_conn_point_names*2*sizeof(*tile->conn_point_names));
+		tile->conn_point_dests = s_snap(model,
+			tiles[i].conn_point_dests_o,
+			tile->num_conn_point_dests*3*sizeof(*tile->conn_point_dests));
+		tile->switches = s_snap(model, tiles[i].switches_o,
+			tile->num_switches*sizeof(*tile->switches));
+		if (!tile->conn_point_names || !tile->conn_point_dests
+		    || !tile->switches)
+			goto mismatch;
+		if (!tiles[i].tile.num_devs)
+			continue;
+
+		// devs is freed by free_devices(), so it needs its
+		// own allocation
+		tile->devs = malloc(tiles[i].tile.num_devs * sizeof(*tile->devs));
+		if (!tile->devs) goto mismatch;
+		bin_data = s_snap(model, tiles[i].devs_o,
+			tiles[i].tile.num_devs * sizeof(*tile->devs));
+		pinw_o = s_snap(model, tiles[i].pinw_o,
+			tiles[i].tile.num_devs * sizeof(*pinw_o));
+		if (!bin_data || !pinw_o) {
+			free(tile->devs);
+			tile->devs = 0;
+			goto mismatch;
+		}
+		memcpy(tile->devs, bin_data,
+			tiles[i].tile.num_devs * sizeof(*tile->devs));
+		tile->num_devs = tiles[i].tile.num_devs;
+		for (j = 0; j < tile->num_devs; j++) {
+			tile->devs[j].pinw_req_for_cfg = 0;
+			tile->devs[j].pinw = !tile->devs[j].num_pinw_total ? 0
+			  : s_snap(model, pinw_o[j], tile->devs[j].num_pinw_total
+				* sizeof(*tile->devs[j].pinw));
+			if (tile->devs[j].num_pinw_total && !tile->devs[j].pinw)
+				goto mismatch;
+		}
+	}
+	if (share_swboxes(model))
+		goto mismatch;
+	for (i = 0; i < num_tiles; i++) {
+		tile = &model->tiles[i];
+		if (!(tile->flags & TF_SHARED_CONNPTS)
+		    && !tile->connpt_hash_size
+		    && connpt_index_build(tile))
+			goto mismatch;
+	}
+	return 0;
+mismatch:
+	if (!model->tiles) {
+		// keep free_devices() from walking a missing tile array
+		model->x_width = 0;
+		model->y_height = 0;
+	}
+	fpga_free_model(model);
+	return -1;
+}
+
+//
+// Static tables hold the per-tile arrays of a snapshot as C source,
+// so that they can be linked into the library. All uint16_t arrays
+// go into one pool and all uint32_t arrays into another, arrays that
+// are shared between tiles appear only once.
+//
+
+#define TABLE_NUMS_PER_LINE	16
+
+struct table_pool
+{
+	int size; // 2 or 4
+	int num;
+	// shared arrays already in the pool
+	const void** shared;
+	int* shared_o;
+	int num_shared;
+};
+
+// Returns the offset of data in the pool, or -1 for out of memory.
+static int table_pool_add(FILE* f, struct table_pool* pool,
+	const void* data, int num, int shared)
+{
+	void* new_ptr;
+	int i, o;
+
+	if (!num)
+		return 0;
+	if (shared) {
+		for (i = 0; i < pool->num_shared; i++) {
+			if (pool->shared[i] == data)
+				return pool->shared_o[i];
+		}
+		new_ptr = realloc(pool->shared,
+			(pool->num_shared+1)*sizeof(*pool->shared));
+		if (!new_ptr) return -1;
+		pool->shared = new_ptr;
+		new_ptr = realloc(pool->shared_o,
+			(pool->num_shared+1)*sizeof(*pool->shared_o));
+		if (!new_ptr) return -1;
+		pool->shared_o = new_ptr;
+		pool->shared[pool->num_shared] = data;
+		pool->shared_o[pool->num_shared++] = pool->num;
+	}
+	o = pool->num;
+	for (i = 0; i < num; i++) {
+		fprintf(f, "%u,", pool->size == 2 ? ((const uint16_t*) data)[i]
+			: ((const uint32_t*) data)[i]);
+		if (!(++pool->num % TABLE_NUMS_PER_LINE))
+			fprintf(f, "\n");
+	}
+	return o;
+}
+
+int fpga_write_table(FILE* f, struct fpga_model* model, const char* name)
+{
+	struct table_pool u16 = { 2 }, u32 = { 4 };
+	struct fpga_tile* tile;
+	int (*tile_o)[3];
+	const char* str_data;
+	int num_tiles, str_len, i, j, rc;
+
+	RC_CHECK(model);
+	num_tiles = model->x_width * model->y_height;
+	tile_o = calloc(num_tiles, sizeof(*tile_o));
+	if (!tile_o) FAIL(ENOMEM);
+
+	fprintf(f, "static const uint16_t s_%s_u16[] = {\n", name);
+	for (i = 0; i < num_tiles; i++) {
+		tile = &model->tiles[i];
+		tile_o[i][0] = table_pool_add(f, &u16, tile->conn_point_names,
+			tile->num_conn_point_names*2,
+			tile->flags & TF_SHARED_CONNPTS);
+		tile_o[i][1] = table_pool_add(f, &u16, tile->conn_point_dests,
+			tile->num_conn_point_dests*3, /*shared*/ 0);
+		if (tile_o[i][0] == -1) FAIL(ENOMEM);
+	}
+	fprintf(f, "};\n\nstatic const uint32_t s_%s_u32[] = {\n", name);
+	for (i = 0; i < num_tiles; i++) {
+		tile = &model->tiles[i];
+		tile_o[i][2] = table_pool_add(f, &u32, tile->switches,
+			tile->num_switches, tile->flags & TF_SHARED_SWITCHES);
+		if (tile_o[i][2] == -1) FAIL(ENOMEM);
+	}
+	fprintf(f, "};\n\nstatic const struct xc6_table_tile s_%s_tiles[] = {\n", name);
+	for (i = 0; i < num_tiles; i++) {
+		tile = &model->tiles[i];
+		fprintf(f, "\t{ %i, %i, %i, %i, %i, %i, %i },\n",
+			tile->flags & ~TF_SHARED_MASK,
+			tile->num_conn_point_names, tile->num_conn_point_dests,
+			tile->num_switches, tile_o[i][0], tile_o[i][1], tile_o[i][2]);
+	}
+	fprintf(f, "};\n\n");
+
+	// The arena holds binary string headers, every byte
+	// is printed in octal so that no escape can run on.
+	str_data = strarray_data(&model->str, &str_len);
+	fprintf(f, "static const char s_%s_str[] =", name);
+	for (j = 0; j < str_len; j++) {
+		if (!(j % TABLE_NUMS_PER_LINE))
+			fprintf(f, "\n\t\"");
+		fprintf(f, "\\%03o", (uint8_t) str_data[j]);
+		if (j == str_len-1 || !((j+1) % TABLE_NUMS_PER_LINE))
+			fprintf(f, "\"");
+	}
+	fprintf(f, "%s;\n\n", str_len ? "" : " \"\"");
+
+	fprintf(f, "const struct xc6_model_table xc6_table_%s = {\n"
+		"\t.idcode = 0x%08x,\n"
+		"\t.x_width = %i,\n"
+		"\t.y_height = %i,\n"
+		"\t.str_highest_index = %i,\n"
+		"\t.str_used_slots = %i,\n"
+		"\t.str_len = %i,\n"
+		"\t.str = s_%s_str,\n"
+		"\t.num_u16 = %i,\n"
+		"\t.num_u32 = %i,\n"
+		"\t.u16 = s_%s_u16,\n"
+		"\t.u32 = s_%s_u32,\n"
+		"\t.tiles = s_%s_tiles,\n"
+		"};\n", name, model->die->idcode, model->x_width,
+		model->y_height, model->str.highest_index,
+		strarray_used_slots(&model->str), str_len,
+		name, u16.num, u32.num, name, name, name);
+	rc = ferror(f) ? EIO : 0;
+	free(tile_o);
+	free(u16.shared);
+	free(u16.shared_o);
+	free(u32.shared);
+	free(u32.shared_o);
+	return rc;
+fail:
+	free(tile_o);
+	free(u16.shared);
+	free(u16.shared_o);
+	free(u32.shared);
+	free(u32.shared_o);
+	return rc;
+}
+
+int fpga_table_strings(struct fpga_model* model,
+	const struct xc6_model_table* table)
+{
+	RC_CHECK(model);
+	RC_ASSERT(model, model->str.highest_index == table->str_highest_index);
+	if (strarray_load(&model->str, table->str, table->str_len))
+		RC_FAIL(model, EINVAL);
+	RC_RETURN(model);
+}
+
+int fpga_table_tiles(struct fpga_model* model,
+	const struct xc6_model_table* table)
+{
+	const struct xc6_table_tile* t;
+	struct fpga_tile* tile;
+	int i;
+
+	RC_CHECK(model);
+	RC_ASSERT(model, model->x_width == table->x_width
+		&& model->y_height == table->y_height);
+	// tiles and devices must not have needed any new string
+	RC_ASSERT(model, strarray_used_slots(&model->str)
+		== table->str_used_slots);
+	for (i = 0; i < model->x_width * model->y_height; i++) {
+		tile = &model->tiles[i];
+		t = &table->tiles[i];
+		RC_ASSERT(model, t->conn_point_names_o + t->num_conn_point_names*2 <= table->num_u16
+			&& t->conn_point_dests_o + t->num_conn_point_dests*3 <= table->num_u16
+			&& t->switches_o + t->num_switches <= table->num_u32);
+		// init_devices() added the pinwire connpts already,
+		// the table has them too
+		connpt_index_free(tile);
+		free(tile->conn_point_names);
+		free(tile->conn_point_dests);
+		free(tile->switches);
+		tile->flags = t->flags;
+		tile->num_conn_point_names = t->num_conn_point_names;
+		tile->num_conn_point_dests = t->num_conn_point_dests;
+		tile->num_switches = t->num_switches;
+		// The table is read-only. Every array is marked shared so
+		// that the first write to a tile copies it.
+		tile->conn_point_names = (uint16_t*) &table->u16[t->conn_point_names_o];
+		tile->conn_point_dests = (uint16_t*) &table->u16[t->conn_point_dests_o];
+		tile->switches = (uint32_t*) &table->u32[t->switches_o];
+		if (tile->num_conn_point_dests)
+			tile->flags |= TF_SHARED_DESTS;
+	}
+	model->table = table;
+	share_swboxes(model);
+	lend_swboxes(model);
+	RC_RETURN(model);
+}
@@ -0,0 +1,1274 @@
+//
+// Author: Wolfgang Spraul
+//
+// This is free and unencumbered software released into the public domain.
+// For details see the UNLICENSE file at the root of the source tree.
+//
+
+#include <time.h>
+#include <pthread.h>
+#include "model.h"
+#include "control.h"
+#include "rr_graph.h"
+#include "lookahead.h"
+#include "router.h"
+
+// node flags
+#define RN_BLOCKED	0x01 // driven by a switch that was on before
+#define RN_PIN		0x02 // device pin, can only end a path
+// route sessions only
+#define RN_FIXED	0x04 // driven by a switch outside any net
+#define RN_DEV_PIN	0x08 // pin of an endpoint device, not only of a net
+
+// PathFinder cost of a node: (1 + hist) * (1 + pres_fac * occ)
+#define PRES_FAC_FIRST	0.5
+#define PRES_FAC_MULT	1.8
+#define HIST_FAC	0.3
+// A* estimate per tile of distance without a lookahead. Nodes span up
+// to 6 tiles, so a guess below the cost of a node per tile. 0.5 expands
+// 3.5x fewer nodes than 0.25 for about 2% more switches.
+#define ASTAR_FAC	0.5
+// A* estimate per node of the lookahead. Taking the larger of both
+// halves the nodes expanded for 1% more switches, 0.8 and 1.3 are
+// slower.
+#define LA_FAC		1.0
+// Tiles between the bounding boxes of nets in a wave. For 2000 nets on
+// the xc6slx9, 0 gives waves of 13 nets on average and requeues 2 nets,
+// 3 gives waves of 6 and requeues none.
+#define BBOX_MARGIN	0
+#define NO_OWNER	0xFFFFFFFF
+
+static int s_route_threads = 0;
+static int s_route_lookahead = 1;
+
+void fnet_set_route_threads(int num_threads)
+{
+	s_route_threads = num_threads < 0 ? 0
+		: (num_threads > ROUTE_MAX_THREADS ? ROUTE_MAX_THREADS
+		: num_threads);
+}
+
+void fnet_set_route_lookahead(int on)
+{
+	s_route_lookahead = on;
+}
+
+struct rt_net
+{
+	net_idx_t net_i;
+	rrg_node_t source;
+	int num_sinks;
+	rrg_node_t* sinks;
+	int y1, x1, y2, x2; // bounding box of the pins
+	// the routed tree, edges[i] drives nodes[i], the source has
+	// RRG_NO_EDGE
+	int num_nodes, nodes_size;
+	rrg_node_t* nodes;
+	rrg_edge_t* edges;
+};
+
+struct heap_el
+{
+	float f, g;
+	rrg_node_t node;
+};
+
+// search state, one per thread
+struct rt_search
+{
+	struct router* router;
+	// A* state of a node is valid if its stamp is cur_stamp,
+	// nodes in the tree of the net being routed have tree set
+	// to cur_tree.
+	uint32_t cur_stamp, cur_tree;
+	uint32_t* stamp, *tree;
+	float* cost;
+	rrg_node_t* prev_node;
+	rrg_edge_t* prev_edge;
+	int heap_len, heap_size;
+	struct heap_el* heap;
+
+	int net_routes;
+	long nodes_expanded;
+};
+
+struct router
+{
+	struct fpga_model* model;
+	struct rr_graph rrg;
+	struct route_stats stats;
+
+	int num_nets;
+	struct rt_net* nets;
+
+	uint8_t* node_flags;
+	uint16_t* node_y, *node_x;
+	const struct lookahead* la; // 0 without
+	int* node_type; // lookahead type of each node
+	uint16_t* occ;
+	float* hist;
+	float pres_fac;
+	uint32_t cur_hist;
+	uint32_t* hist_stamp;
+
+	int num_threads; // 0 routes one net after the other
+	struct rt_search* searches; // num_threads, at least 1
+
+	// Waves, see route_waves(). owner is the lowest wave position
+	// of a net that used the node in the current wave.
+	uint32_t* owner;
+	uint32_t* tile_wave; // last wave that took the tile
+	uint32_t cur_wave;
+	int* queue; // nets still to be routed in this iteration
+	int* wave;
+	int* wave_rc;
+	int wave_len;
+	int next_pos; // next wave position to be taken by a worker
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//
+// heap
+//
+
+// ties are broken by node so that routing is deterministic
+static int heap_less(const struct heap_el* a, const struct heap_el* b)
+{
+	return a->f < b->f || (a->f == b->f && a->node < b->node);
+}
+
+static int heap_push(struct rt_search* s, float f, float g, rrg_node_t node)
+{
+	struct heap_el el;
+	void* new_ptr;
+	int i;
+
+	if (s->heap_len >= s->heap_size) {
+		new_ptr = realloc(s->heap, (s->heap_size ? s->heap_size*2
+			: 1024) * sizeof(*s->heap));
+		if (!new_ptr) return ENOMEM;
+		s->heap = new_ptr;
+		s->heap_size = s->heap_size ? s->heap_size*2 : 1024;
+	}
+	el.f = f;
+	el.g = g;
+	el.node = node;
+	for (i = s->heap_len++; i && heap_less(&el, &s->heap[(i-1)/2]);
+	     i = (i-1)/2)
+		s->heap[i] = s->heap[(i-1)/2];
+	s->heap[i] = el;
+	return 0;
+}
+
+static struct heap_el heap_pop(struct rt_search* s)
+{
+	struct heap_el top, last;
+	int i, child;
+
+	top = s->heap[0];
+	last = s->heap[--s->heap_len];
+	for (i = 0; (child = 2*i+1) < s->heap_len; i = child) {
+		if (child+1 < s->heap_len
+		    && heap_less(&s->heap[child+1], &s->heap[child]))
+			child++;
+		if (!heap_less(&s->heap[child], &last))
+			break;
+		s->heap[i] = s->heap[child];
+	}
+	s->heap[i] = last;
+	return top;
+}
+
+//
+// search
+//
+
+static float node_cost(const struct router* r, rrg_node_t node)
+{
+	return (1 + r->hist[node]) * (1 + r->pres_fac * r->occ[node]);
+}
+
+static float estimate(const struct router* r, rrg_node_t node,
+	rrg_node_t target)
+{
+	float distance, la;
+
+	distance = ASTAR_FAC * (abs(r->node_y[node] - r->node_y[target])
+		+ abs(r->node_x[node] - r->node_x[target]));
+	if (!r->la)
+		return distance;
+	la = LA_FAC * la_estimate(r->la, r->node_type[node],
+		r->node_y[target] - r->node_y[node],
+		r->node_x[target] - r->node_x[node]);
+	return la > distance ? la : distance;
+}
+
+// The nodes of a tree only count as used once the net is committed,
+// until then other searches do not see them.
+static int tree_add(struct rt_search* s, struct rt_net* net,
+	rrg_node_t node, rrg_edge_t edge)
+{
+	void* new_ptr;
+	int new_size;
+
+	if (net->num_nodes >= net->nodes_size) {
+		// nodes_size only grows once both arrays have the room
+		new_size = net->nodes_size ? net->nodes_size*2 : 32;
+		new_ptr = realloc(net->nodes, new_size*sizeof(*net->nodes));
+		if (!new_ptr) return ENOMEM;
+		net->nodes = new_ptr;
+		new_ptr = realloc(net->edges, new_size*sizeof(*net->edges));
+		if (!new_ptr) return ENOMEM;
+		net->edges = new_ptr;
+		net->nodes_size = new_size;
+	}
+	net->nodes[net->num_nodes] = node;
+	net->edges[net->num_nodes++] = edge;
+	s->tree[node] = s->cur_tree;
+	return 0;
+}
+
+static void commit(struct router* r, const struct rt_net* net)
+{
+	int i;
+
+	for (i = 0; i < net->num_nodes; i++)
+		r->occ[net->nodes[i]]++;
+}
+
+static void rip_up(struct router* r, struct rt_net* net)
+{
+	int i;
+
+	for (i = 0; i < net->num_nodes; i++)
+		r->occ[net->nodes[i]]--;
+	net->num_nodes = 0;
+}
+
+// Searches the cheapest path from the tree of net to target and adds
+// it to the tree. Returns ENOSPC if there is no path.
+static int route_sink(const struct router* r, struct rt_search* s,
+	struct rt_net* net, rrg_node_t target)
+{
+	const struct rr_graph* rrg = &r->rrg;
+	struct heap_el el;
+	rrg_node_t node, to;
+	rrg_edge_t e;
+	float g;
+	int i, rc;
+
+	if (s->tree[target] == s->cur_tree)
+		return 0;
+	s->cur_stamp++;
+	s->heap_len = 0;
+	for (i = 0; i < net->num_nodes; i++) {
+		node = net->nodes[i];
+		s->stamp[node] = s->cur_stamp;
+		s->cost[node] = 0;
+		if ((rc = heap_push(s, estimate(r, node, target), 0, node)))
+			return rc;
+	}
+	while (s->heap_len) {
+		el = heap_pop(s);
+		node = el.node;
+		if (el.g > s->cost[node])
+			continue; // stale
+		if (node == target)
+			break;
+		s->nodes_expanded++;
+		// device pins only end a path, except for the source
+		if ((r->node_flags[node] & RN_PIN) && node != net->source)
+			continue;
+		for (e = rrg->edge_start[node]; e < rrg->edge_start[node+1]; e++) {
+			to = rrg->edge_to[e];
+			if (s->tree[to] == s->cur_tree
+			    || (r->node_flags[to] & RN_BLOCKED)
+			    || ((r->node_flags[to] & RN_PIN) && to != target))
+				continue;
+			g = el.g + node_cost(r, to);
+			if (s->stamp[to] == s->cur_stamp && s->cost[to] <= g)
+				continue;
+			s->stamp[to] = s->cur_stamp;
+			s->cost[to] = g;
+			s->prev_node[to] = node;
+			s->prev_edge[to] = e;
+			if ((rc = heap_push(s, g + estimate(r, to, target), g, to)))
+				return rc;
+		}
+	}
+	if (s->stamp[target] != s->cur_stamp)
+		return ENOSPC;
+	for (node = target; s->tree[node] != s->cur_tree;
+	     node = s->prev_node[node]) {
+		if ((rc = tree_add(s, net, node, s->prev_edge[node])))
+			return rc;
+	}
+	return 0;
+}
+
+// Routes a ripped-up net without committing it.
+static int route_net(const struct router* r, struct rt_search* s,
+	struct rt_net* net)
+{
+	int i, rc;
+
+	s->cur_tree++;
+	if ((rc = tree_add(s, net, net->source, RRG_NO_EDGE)))
+		return rc;
+	for (i = 0; i < net->num_sinks; i++) {
+		if ((rc = route_sink(r, s, net, net->sinks[i])))
+			return rc;
+	}
+	s->net_routes++;
+	return 0;
+}
+
+static int net_overused(const struct router* r, const struct rt_net* net)
+{
+	int i;
+
+	for (i = 0; i < net->num_nodes; i++) {
+		if (r->occ[net->nodes[i]] > 1)
+			return 1;
+	}
+	return 0;
+}
+
+// Adds history cost to the shared nodes of all nets and returns their
+// number.
+static int update_history(struct router* r)
+{
+	struct rt_net* net;
+	rrg_node_t node;
+	int i, j, num_overused;
+
+	// a shared node is in several nets but counted once
+	r->cur_hist++;
+	num_overused = 0;
+	for (i = 0; i < r->num_nets; i++) {
+		net = &r->nets[i];
+		for (j = 0; j < net->num_nodes; j++) {
+			node = net->nodes[j];
+			if (r->occ[node] < 2 || r->hist_stamp[node] == r->cur_hist)
+				continue;
+			r->hist_stamp[node] = r->cur_hist;
+			r->hist[node] += HIST_FAC * (r->occ[node] - 1);
+			num_overused++;
+		}
+	}
+	return num_overused;
+}
+
+//
+// waves
+//
+
+// Takes the tiles of the net's bounding box plus BBOX_MARGIN for the
+// current wave, unless another net of the wave has some of them.
+static int take_bbox(struct router* r, const struct rt_net* net)
+{
+	int y, x, y1, x1, y2, x2, x_width;
+
+	x_width = r->model->x_width;
+	y1 = net->y1 < BBOX_MARGIN ? 0 : net->y1 - BBOX_MARGIN;
+	x1 = net->x1 < BBOX_MARGIN ? 0 : net->x1 - BBOX_MARGIN;
+	y2 = net->y2 + BBOX_MARGIN >= r->model->y_height
+		? r->model->y_height-1 : net->y2 + BBOX_MARGIN;
+	x2 = net->x2 + BBOX_MARGIN >= x_width ? x_width-1 : net->x2 + BBOX_MARGIN;
+	for (y = y1; y <= y2; y++) {
+		for (x = x1; x <= x2; x++) {
+			if (r->tile_wave[y*x_width+x] == r->cur_wave)
+				return 0;
+		}
+	}
+	for (y = y1; y <= y2; y++) {
+		for (x = x1; x <= x2; x++)
+			r->tile_wave[y*x_width+x] = r->cur_wave;
+	}
+	return 1;
+}
+
+// Lowers the owner of node to pos. The result does not depend on
+// the order in which threads get here.
+static void claim_node(struct router* r, rrg_node_t node, uint32_t pos)
+{
+	uint32_t cur;
+
+	while ((cur = __atomic_load_n(&r->owner[node], __ATOMIC_RELAXED)) > pos
+	       && !__sync_bool_compare_and_swap(&r->owner[node], cur, pos));
+}
+
+static void* wave_worker(void* arg)
+{
+	struct rt_search* s = arg;
+	struct router* r;
+	struct rt_net* net;
+	int pos, i;
+
+	r = s->router;
+	while ((pos = __sync_fetch_and_add(&r->next_pos, 1)) < r->wave_len) {
+		net = &r->nets[r->wave[pos]];
+		r->wave_rc[pos] = route_net(r, s, net);
+		if (r->wave_rc[pos])
+			continue;
+		for (i = 0; i < net->num_nodes; i++)
+			claim_node(r, net->nodes[i], pos);
+	}
+	return 0;
+}
+
+// Routes the first queue_len nets of r->queue in waves. A wave takes
+// the queued nets whose bounding boxes do not overlap, in queue order,
+// and routes them on all threads against the occupancy from before the
+// wave. Afterwards the nets are committed in wave order; a net that
+// shares a node with a net earlier in the wave is put back at the
+// front of the queue instead, to be routed again in the next wave
+// when it can see the other net. The first net of a wave is always
+// committed. Since a net is routed only against committed nets, the
+// result is the same for any number of threads.
+static int route_waves(struct router* r, int queue_len)
+{
+	pthread_t threads[ROUTE_MAX_THREADS];
+	struct rt_net* net;
+	int num_started, rest_len, num_requeued, conflict, i, j;
+
+	while (queue_len) {
+		r->cur_wave++;
+		r->wave_len = rest_len = 0;
+		for (i = 0; i < queue_len; i++) {
+			if (take_bbox(r, &r->nets[r->queue[i]]))
+				r->wave[r->wave_len++] = r->queue[i];
+			else
+				r->queue[rest_len++] = r->queue[i];
+		}
+		for (i = 0; i < r->wave_len; i++)
+			rip_up(r, &r->nets[r->wave[i]]);
+
+		r->next_pos = 0;
+		num_started = 0;
+		for (i = 1; i < r->num_threads && i < r->wave_len; i++) {
+			if (pthread_create(&threads[num_started], /*attr*/ 0,
+					wave_worker, &r->searches[i]))
+				break; // the remaining workers pick up the slack
+			num_started++;
+		}
+		wave_worker(&r->searches[0]);
+		for (i = 0; i < num_started; i++)
+			pthread_join(threads[i], /*retval*/ 0);
+
+		num_requeued = 0;
+		for (i = 0; i < r->wave_len; i++) {
+			net = &r->nets[r->wave[i]];
+			if (r->wave_rc[i]) {
+				fprintf(stderr, "#E %s:%i cannot route net %i\n",
+					__FILE__, __LINE__, net->net_i);
+				return r->wave_rc[i];
+			}
+			// releasing the nodes right away is safe, later
+			// nets sharing one conflict either way
+			conflict = 0;
+			for (j = 0; j < net->num_nodes; j++) {
+				if (r->owner[net->nodes[j]] != i)
+					conflict = 1;
+				r->owner[net->nodes[j]] = NO_OWNER;
+			}
+			if (conflict) {
+				net->num_nodes = 0;
+				r->wave[num_requeued++] = r->wave[i];
+			} else
+				commit(r, net);
+		}
+		memmove(&r->queue[num_requeued], r->queue,
+			rest_len*sizeof(*r->queue));
+		memcpy(r->queue, r->wave, num_requeued*sizeof(*r->queue));
+		queue_len = num_requeued + rest_len;
+		r->stats.waves++;
+		r->stats.requeued += num_requeued;
+	}
+	return 0;
+}
+
+//
+// setup
+//
+
+static rrg_node_t pin_node(struct router* r, const struct net_el* el)
+{
+	struct fpga_device* dev;
+
+	dev = FPGA_DEV(r->model, el->y, el->x, el->dev_idx);
+	return rrg_node_str(&r->rrg, r->model, el->y, el->x,
+		dev->pinw[el->idx & NET_IDX_MASK]);
+}
+
+// Marks the nodes of switches that are on as blocked, and the pins
+// of logic, iob and other endpoint devices as well as all pins used
+// in nets as path ends. Ilogic, ologic and the clock buffers are
+// routed through by their switches.
+static void mark_nodes(struct router* r)
+{
+	struct fpga_model* model = r->model;
+	struct fpga_tile* tile;
+	struct fpga_device* dev;
+	struct fpga_net* net;
+	rrg_node_t node;
+	int y, x, i, j;
+
+	for (y = 0; y < model->y_height; y++) {
+		for (x = 0; x < model->x_width; x++) {
+			tile = YX_TILE(model, y, x);
+			for (i = 0; i < tile->num_switches; i++) {
+				if (!(tile->switches[i] & SWITCH_USED))
+					continue;
+				r->node_flags[rrg_node(&r->rrg, y, x,
+					SW_FROM_I(tile->switches[i]))] |= RN_BLOCKED;
+				r->node_flags[rrg_node(&r->rrg, y, x,
+					SW_TO_I(tile->switches[i]))] |= RN_BLOCKED;
+			}
+			for (i = 0; i < tile->num_devs; i++) {
+				dev = &tile->devs[i];
+				if (dev->type != DEV_LOGIC && dev->type != DEV_IOB
+				    && dev->type != DEV_TIEOFF && dev->type != DEV_MACC
+				    && dev->type != DEV_BRAM)
+					continue;
+				for (j = 0; j < dev->num_pinw_total; j++) {
+					if (dev->pinw[j] == STRIDX_NO_ENTRY)
+						continue;
+					node = rrg_node_str(&r->rrg, model,
+						y, x, dev->pinw[j]);
+					if (node != RRG_NO_NODE)
+						r->node_flags[node] |= RN_PIN|RN_DEV_PIN;
+				}
+			}
+		}
+	}
+	for (i = 0; i < model->highest_used_net; i++) {
+		net = &model->nets[i];
+		for (j = 0; j < net->len; j++) {
+			if (!(net->el[j].idx & NET_IDX_IS_PINW))
+				continue;
+			node = pin_node(r, &net->el[j]);
+			if (node != RRG_NO_NODE)
+				r->node_flags[node] |= RN_PIN;
+		}
+	}
+}
+
+// Sets up rt for net_i if the net has one out pin, in pins and, unless
+// with_sw is set, no switches. Otherwise rt->num_sinks stays 0.
+static int load_net(struct router* r, struct rt_net* rt, net_idx_t net_i,
+	int with_sw)
+{
+	struct fpga_model* model = r->model;
+	struct fpga_net* net;
+	struct fpga_device* dev;
+	int j, num_out, num_in, num_sw;
+
+	net = &model->nets[net_i-1];
+	num_out = num_in = num_sw = 0;
+	for (j = 0; j < net->len; j++) {
+		if (!(net->el[j].idx & NET_IDX_IS_PINW)) {
+			num_sw++;
+			continue;
+		}
+		dev = FPGA_DEV(model, net->el[j].y, net->el[j].x,
+			net->el[j].dev_idx);
+		if ((net->el[j].idx & NET_IDX_MASK) < dev->num_pinw_in)
+			num_in++;
+		else
+			num_out++;
+	}
+	if ((num_sw && !with_sw) || num_out != 1 || !num_in)
+		return 0;
+	rt->net_i = net_i;
+	rt->sinks = malloc(num_in * sizeof(*rt->sinks));
+	if (!rt->sinks) return ENOMEM;
+	for (j = 0; j < net->len; j++) {
+		if (!(net->el[j].idx & NET_IDX_IS_PINW))
+			continue;
+		dev = FPGA_DEV(model, net->el[j].y, net->el[j].x,
+			net->el[j].dev_idx);
+		if ((net->el[j].idx & NET_IDX_MASK) < dev->num_pinw_in)
+			rt->sinks[rt->num_sinks++] = pin_node(r, &net->el[j]);
+		else
+			rt->source = pin_node(r, &net->el[j]);
+	}
+	for (j = 0; j < rt->num_sinks; j++) {
+		if (rt->sinks[j] == RRG_NO_NODE)
+			break;
+	}
+	if (rt->source == RRG_NO_NODE || j < rt->num_sinks) {
+		fprintf(stderr, "#E %s:%i net %i pin without connpt\n",
+			__FILE__, __LINE__, rt->net_i);
+		free(rt->sinks);
+		rt->sinks = 0;
+		rt->num_sinks = 0;
+		return EINVAL;
+	}
+	rt->y1 = rt->y2 = r->node_y[rt->source];
+	rt->x1 = rt->x2 = r->node_x[rt->source];
+	for (j = 0; j < rt->num_sinks; j++) {
+		if (r->node_y[rt->sinks[j]] < rt->y1)
+			rt->y1 = r->node_y[rt->sinks[j]];
+		if (r->node_y[rt->sinks[j]] > rt->y2)
+			rt->y2 = r->node_y[rt->sinks[j]];
+		if (r->node_x[rt->sinks[j]] < rt->x1)
+			rt->x1 = r->node_x[rt->sinks[j]];
+		if (r->node_x[rt->sinks[j]] > rt->x2)
+			rt->x2 = r->node_x[rt->sinks[j]];
+	}
+	r->stats.num_sinks += rt->num_sinks;
+	return 0;
+}
+
+// Collects the nets with one out pin, in pins and no switches.
+static int find_nets(struct router* r)
+{
+	int i, rc;
+
+	r->nets = calloc(r->model->highest_used_net
+		? r->model->highest_used_net : 1, sizeof(*r->nets));
+	if (!r->nets) return ENOMEM;
+	for (i = 0; i < r->model->highest_used_net; i++) {
+		if ((rc = load_net(r, &r->nets[r->num_nets], i+1,
+				/*with_sw*/ 0)))
+			return rc;
+		if (r->nets[r->num_nets].num_sinks)
+			r->num_nets++;
+	}
+	r->stats.num_nets = r->num_nets;
+	return 0;
+}
+
+static int init_lookahead(struct router* r)
+{
+	int* str_type;
+	str16_t name_i;
+	int i, y, x, connpt_o;
+
+	// without tables, route by the tile distance
+	// rather than build them for seconds
+	r->la = la_find(r->model);
+	if (!r->la) return r->model->rc;
+	r->node_type = malloc(r->rrg.num_nodes * sizeof(*r->node_type));
+	// many nodes share a name
+	str_type = malloc((STRIDX_64K+1) * sizeof(*str_type));
+	if (!r->node_type || !str_type) {
+		free(str_type);
+		return ENOMEM;
+	}
+	for (i = 0; i <= STRIDX_64K; i++)
+		str_type[i] = LA_NO_TYPE-1;
+	for (i = 0; i < r->rrg.num_nodes; i++) {
+		rrg_node_yx(&r->rrg, i, &y, &x, &connpt_o);
+		name_i = YX_TILE(r->model, y, x)->conn_point_names[connpt_o*2+1];
+		if (str_type[name_i] == LA_NO_TYPE-1)
+			str_type[name_i] = la_type(r->la, r->model, name_i);
+		r->node_type[i] = str_type[name_i];
+	}
+	free(str_type);
+	return 0;
+}
+
+static int search_init(struct router* r, struct rt_search* s)
+{
+	int num_nodes = r->rrg.num_nodes;
+
+	s->router = r;
+	s->stamp = calloc(num_nodes, sizeof(*s->stamp));
+	s->tree = calloc(num_nodes, sizeof(*s->tree));
+	s->cost = malloc(num_nodes * sizeof(*s->cost));
+	s->prev_node = malloc(num_nodes * sizeof(*s->prev_node));
+	s->prev_edge = malloc(num_nodes * sizeof(*s->prev_edge));
+	if (!s->stamp || !s->tree || !s->cost || !s->prev_node
+	    || !s->prev_edge)
+		return ENOMEM;
+	return 0;
+}
+
+static void search_free(struct rt_search* s)
+{
+	free(s->stamp);
+	free(s->tree);
+	free(s->cost);
+	free(s->prev_node);
+	free(s->prev_edge);
+	free(s->heap);
+}
+
+static int router_init(struct router* r, int num_threads)
+{
+	int num_nodes, i, y, x, connpt_o, rc;
+
+	num_nodes = r->rrg.num_nodes;
+	r->node_flags = calloc(num_nodes, sizeof(*r->node_flags));
+	r->node_y = malloc(num_nodes * sizeof(*r->node_y));
+	r->node_x = malloc(num_nodes * sizeof(*r->node_x));
+	r->occ = calloc(num_nodes, sizeof(*r->occ));
+	r->hist = calloc(num_nodes, sizeof(*r->hist));
+	r->hist_stamp = calloc(num_nodes, sizeof(*r->hist_stamp));
+	if (!r->node_flags || !r->node_y || !r->node_x || !r->occ
+	    || !r->hist || !r->hist_stamp)
+		return ENOMEM;
+	for (i = 0; i < num_nodes; i++) {
+		rrg_node_yx(&r->rrg, i, &y, &x, &connpt_o);
+		r->node_y[i] = y;
+		r->node_x[i] = x;
+	}
+	if (s_route_lookahead && (rc = init_lookahead(r)))
+		return rc;
+
+	r->num_threads = num_threads;
+	r->searches = calloc(num_threads ? num_threads : 1,
+		sizeof(*r->searches));
+	if (!r->searches) return ENOMEM;
+	for (i = 0; i < (num_threads ? num_threads : 1); i++) {
+		if ((rc = search_init(r, &r->searches[i])))
+			return rc;
+	}
+	if (!num_threads)
+		return 0;
+	r->owner = malloc(num_nodes * sizeof(*r->owner));
+	r->tile_wave = calloc(r->model->x_width * r->model->y_height,
+		sizeof(*r->tile_wave));
+	if (!r->owner || !r->tile_wave)
+		return ENOMEM;
+	for (i = 0; i < num_nodes; i++)
+		r->owner[i] = NO_OWNER;
+	return 0;
+}
+
+// Sizes the wave arrays for r->num_nets.
+static int waves_alloc(struct router* r)
+{
+	void* new_ptr;
+	int size;
+
+	size = r->num_nets ? r->num_nets : 1;
+	if (!(new_ptr = realloc(r->queue, size*sizeof(*r->queue))))
+		return ENOMEM;
+	r->queue = new_ptr;
+	if (!(new_ptr = realloc(r->wave, size*sizeof(*r->wave))))
+		return ENOMEM;
+	r->wave = new_ptr;
+	if (!(new_ptr = realloc(r->wave_rc, size*sizeof(*r->wave_rc))))
+		return ENOMEM;
+	r->wave_rc = new_ptr;
+	return 0;
+}
+
+static void free_nets(struct router* r)
+{
+	int i;
+
+	for (i = 0; i < r->num_nets; i++) {
+		free(r->nets[i].sinks);
+		free(r->nets[i].nodes);
+		free(r->nets[i].edges);
+	}
+	free(r->nets);
+	r->nets = 0;
+	r->num_nets = 0;
+}
+
+static void router_free(struct router* r)
+{
+	int i;
+
+	free_nets(r);
+	free(r->node_flags);
+	free(r->node_y);
+	free(r->node_x);
+	free(r->node_type);
+	free(r->occ);
+	free(r->hist);
+	free(r->hist_stamp);
+	if (r->searches) {
+		for (i = 0; i < (r->num_threads ? r->num_threads : 1); i++)
+			search_free(&r->searches[i]);
+		free(r->searches);
+	}
+	free(r->owner);
+	free(r->tile_wave);
+	free(r->queue);
+	free(r->wave);
+	free(r->wave_rc);
+	rrg_free(&r->rrg);
+}
+
+static int write_back(struct router* r)
+{
+	struct fpga_model* model = r->model;
+	struct rt_net* net;
+	swidx_t sw;
+	int i, j, y, x;
+
+	for (i = 0; i < r->num_nets; i++) {
+		net = &r->nets[i];
+		for (j = 0; j < net->num_nodes; j++) {
+			if (net->edges[j] == RRG_NO_EDGE)
+				continue;
+			rrg_edge_sw(&r->rrg, net->edges[j], &y, &x, &sw);
+			fnet_add_sw(model, net->net_i, y, x, &sw, /*num_sw*/ 1);
+			r->stats.num_switches++;
+		}
+	}
+	return model->rc;
+}
+
+// Routes all nets in the first iteration, later only the nets
+// through shared nodes.
+static int route_iteration(struct router* r)
+{
+	int queue_len, i, rc;
+
+	if (r->num_threads) {
+		queue_len = 0;
+		for (i = 0; i < r->num_nets; i++) {
+			if (r->stats.iterations == 1
+			    || net_overused(r, &r->nets[i]))
+				r->queue[queue_len++] = i;
+		}
+		return route_waves(r, queue_len);
+	}
+	for (i = 0; i < r->num_nets; i++) {
+		if (r->stats.iterations > 1 && !net_overused(r, &r->nets[i]))
+			continue;
+		rip_up(r, &r->nets[i]);
+		if ((rc = route_net(r, &r->searches[0], &r->nets[i]))) {
+			fprintf(stderr, "#E %s:%i cannot route net %i\n",
+				__FILE__, __LINE__, r->nets[i].net_i);
+			return rc;
+		}
+		commit(r, &r->nets[i]);
+	}
+	return 0;
+}
+
+// Routes r->nets until no node is shared.
+static int negotiate(struct router* r)
+{
+	int num_overused, rc;
+
+	if (r->num_threads && (rc = waves_alloc(r)))
+		return rc;
+	r->pres_fac = PRES_FAC_FIRST;
+	num_overused = 0;
+	for (r->stats.iterations = 1; r->stats.iterations <= ROUTE_MAX_ITERATIONS;
+	     r->stats.iterations++) {
+		if ((rc = route_iteration(r)))
+			return rc;
+		num_overused = update_history(r);
+		if (!num_overused)
+			break;
+		r->pres_fac *= PRES_FAC_MULT;
+	}
+	r->stats.num_overused = num_overused;
+	if (num_overused) {
+		r->stats.iterations = ROUTE_MAX_ITERATIONS;
+		return ENOSPC;
+	}
+	return 0;
+}
+
+static void finish_stats(struct router* r, double start,
+	struct route_stats* stats)
+{
+	int i;
+
+	r->stats.num_threads = r->num_threads;
+	if (r->searches) {
+		for (i = 0; i < (r->num_threads ? r->num_threads : 1); i++) {
+			r->stats.net_routes += r->searches[i].net_routes;
+			r->stats.nodes_expanded += r->searches[i].nodes_expanded;
+		}
+	}
+	r->stats.seconds = now() - start;
+	if (stats)
+		*stats = r->stats;
+}
+
+int fnet_route_all(struct fpga_model* model, struct route_stats* stats)
+{
+	struct router r;
+	double start;
+	int rc;
+
+	start = now();
+	memset(&r, 0, sizeof(r));
+	if (stats)
+		memset(stats, 0, sizeof(*stats));
+	RC_CHECK(model);
+	r.model = model;
+	rrg_build(&r.rrg, model);
+	RC_CHECK(model);
+	if ((rc = router_init(&r, s_route_threads))) goto fail;
+	mark_nodes(&r);
+	if ((rc = find_nets(&r))) goto fail;
+	if ((rc = negotiate(&r))) goto fail;
+	if ((rc = write_back(&r))) goto fail;
+	finish_stats(&r, start, stats);
+	router_free(&r);
+	RC_RETURN(model);
+fail:
+	finish_stats(&r, start, stats);
+	router_free(&r);
+	RC_FAIL(model, rc);
+}
+
+//
+// sessions
+//
+
+struct sess_net
+{
+	int dirty;
+	// nodes of the net as of route_open() or its last routing
+	int num_nodes, nodes_size;
+	rrg_node_t* nodes;
+};
+
+struct route_session
+{
+	struct router r;
+	// Net of each node, or NO_NET. Nodes of nets are blocked, except
+	// during route_dirty() for the dirty nets.
+	net_idx_t* node_net;
+	int nets_size;
+	struct sess_net* nets; // by net_i-1
+	int num_dirty, dirty_size;
+	net_idx_t* dirty;
+};
+
+static int sess_grow(struct route_session* sess, net_idx_t net_i)
+{
+	void* new_ptr;
+	int new_size;
+
+	if (net_i <= sess->nets_size)
+		return 0;
+	new_size = sess->nets_size ? sess->nets_size : 64;
+	while (new_size < net_i)
+		new_size *= 2;
+	new_ptr = realloc(sess->nets, new_size*sizeof(*sess->nets));
+	if (!new_ptr) return ENOMEM;
+	sess->nets = new_ptr;
+	memset(&sess->nets[sess->nets_size], 0,
+		(new_size-sess->nets_size)*sizeof(*sess->nets));
+	sess->nets_size = new_size;
+	return 0;
+}
+
+static int sess_own(struct route_session* sess, net_idx_t net_i,
+	rrg_node_t node)
+{
+	struct sess_net* net = &sess->nets[net_i-1];
+	void* new_ptr;
+
+	if (node == RRG_NO_NODE || sess->node_net[node] == net_i)
+		return 0;
+	if (net->num_nodes >= net->nodes_size) {
+		new_ptr = realloc(net->nodes, (net->nodes_size ? net->nodes_size*2
+			: 16) * sizeof(*net->nodes));
+		if (!new_ptr) return ENOMEM;
+		net->nodes = new_ptr;
+		net->nodes_size = net->nodes_size ? net->nodes_size*2 : 16;
+	}
+	net->nodes[net->num_nodes++] = node;
+	sess->node_net[node] = net_i;
+	sess->r.node_flags[node] |= RN_BLOCKED;
+	return 0;
+}
+
+// Nodes that a switch outside any net drives stay blocked, and
+// device pins stay path ends.
+static void sess_release(struct route_session* sess, net_idx_t net_i)
+{
+	struct sess_net* net = &sess->nets[net_i-1];
+	uint8_t* flags;
+	int i;
+
+	for (i = 0; i < net->num_nodes; i++) {
+		if (sess->node_net[net->nodes[i]] != net_i)
+			continue;
+		sess->node_net[net->nodes[i]] = NO_NET;
+		flags = &sess->r.node_flags[net->nodes[i]];
+		if (!(*flags & RN_FIXED))
+			*flags &= ~RN_BLOCKED;
+		if (!(*flags & RN_DEV_PIN))
+			*flags &= ~RN_PIN;
+	}
+	net->num_nodes = 0;
+}
+
+// Makes the pins and the nodes of the switches of a net in the model
+// the net's.
+static int sess_own_net(struct route_session* sess, net_idx_t net_i)
+{
+	struct fpga_model* model = sess->r.model;
+	struct fpga_net* net;
+	struct fpga_tile* tile;
+	rrg_node_t node;
+	uint32_t sw;
+	int i, rc;
+
+	net = &model->nets[net_i-1];
+	for (i = 0; i < net->len; i++) {
+		if (net->el[i].idx & NET_IDX_IS_PINW) {
+			node = pin_node(&sess->r, &net->el[i]);
+			if ((rc = sess_own(sess, net_i, node)))
+				return rc;
+			if (node != RRG_NO_NODE)
+				sess->r.node_flags[node] |= RN_PIN;
+			continue;
+		}
+		tile = YX_TILE(model, net->el[i].y, net->el[i].x);
+		sw = tile->switches[net->el[i].idx];
+		if ((rc = sess_own(sess, net_i, rrg_node(&sess->r.rrg,
+				net->el[i].y, net->el[i].x, SW_FROM_I(sw)))))
+			return rc;
+		if ((rc = sess_own(sess, net_i, rrg_node(&sess->r.rrg,
+				net->el[i].y, net->el[i].x, SW_TO_I(sw)))))
+			return rc;
+	}
+	return 0;
+}
+
+// Sets RN_FIXED on the nodes of switches that are on but in no net,
+// by counting the switches that are on at each node and taking off
+// those of nets.
+static int mark_fixed(struct router* r)
+{
+	struct fpga_model* model = r->model;
+	struct fpga_tile* tile;
+	struct fpga_net* net;
+	int* num_sw;
+	uint32_t sw;
+	int y, x, i, j;
+
+	num_sw = calloc(r->rrg.num_nodes, sizeof(*num_sw));
+	if (!num_sw) return ENOMEM;
+	for (y = 0; y < model->y_height; y++) {
+		for (x = 0; x < model->x_width; x++) {
+			tile = YX_TILE(model, y, x);
+			for (i = 0; i < tile->num_switches; i++) {
+				sw = tile->switches[i];
+				if (!(sw & SWITCH_USED))
+					continue;
+				num_sw[rrg_node(&r->rrg, y, x, SW_FROM_I(sw))]++;
+				num_sw[rrg_node(&r->rrg, y, x, SW_TO_I(sw))]++;
+			}
+		}
+	}
+	for (i = 0; i < model->highest_used_net; i++) {
+		net = &model->nets[i];
+		for (j = 0; j < net->len; j++) {
+			if (net->el[j].idx & NET_IDX_IS_PINW)
+				continue;
+			tile = YX_TILE(model, net->el[j].y, net->el[j].x);
+			sw = tile->switches[net->el[j].idx];
+			num_sw[rrg_node(&r->rrg, net->el[j].y, net->el[j].x,
+				SW_FROM_I(sw))]--;
+			num_sw[rrg_node(&r->rrg, net->el[j].y, net->el[j].x,
+				SW_TO_I(sw))]--;
+		}
+	}
+	for (i = 0; i < r->rrg.num_nodes; i++) {
+		if (num_sw[i] > 0)
+			r->node_flags[i] |= RN_FIXED;
+	}
+	free(num_sw);
+	return 0;
+}
+
+int route_open(struct route_session** sess_p, struct fpga_model* model)
+{
+	struct route_session* sess;
+	int i, rc;
+
+	*sess_p = 0;
+	RC_CHECK(model);
+	sess = calloc(1, sizeof(*sess));
+	if (!sess) RC_FAIL(model, ENOMEM);
+	sess->r.model = model;
+	rrg_build(&sess->r.rrg, model);
+	if (model->rc) {
+		free(sess);
+		RC_RETURN(model);
+	}
+	if ((rc = router_init(&sess->r, s_route_threads))) goto fail;
+	mark_nodes(&sess->r);
+	if ((rc = mark_fixed(&sess->r))) goto fail;
+	sess->node_net = calloc(sess->r.rrg.num_nodes, sizeof(*sess->node_net));
+	if (!sess->node_net) { rc = ENOMEM; goto fail; }
+	if ((rc = sess_grow(sess, model->highest_used_net))) goto fail;
+	for (i = 0; i < model->highest_used_net; i++) {
+		if ((rc = sess_own_net(sess, i+1))) goto fail;
+	}
+	*sess_p = sess;
+	RC_RETURN(model);
+fail:
+	route_close(sess);
+	RC_FAIL(model, rc);
+}
+
+void route_close(struct route_session* sess)
+{
+	int i;
+
+	if (!sess) return;
+	router_free(&sess->r);
+	free(sess->node_net);
+	for (i = 0; i < sess->nets_size; i++)
+		free(sess->nets[i].nodes);
+	free(sess->nets);
+	free(sess->dirty);
+	free(sess);
+}
+
+int route_dirty_net(struct route_session* sess, net_idx_t net_i)
+{
+	struct fpga_model* model = sess->r.model;
+	void* new_ptr;
+	int rc;
+
+	RC_CHECK(model);
+	RC_ASSERT(model, net_i > 0);
+	if ((rc = sess_grow(sess, net_i))) RC_FAIL(model, rc);
+	if (sess->nets[net_i-1].dirty)
+		RC_RETURN(model);
+	if (sess->num_dirty >= sess->dirty_size) {
+		new_ptr = realloc(sess->dirty, (sess->dirty_size
+			? sess->dirty_size*2 : 64) * sizeof(*sess->dirty));
+		if (!new_ptr) RC_FAIL(model, ENOMEM);
+		sess->dirty = new_ptr;
+		sess->dirty_size = sess->dirty_size ? sess->dirty_size*2 : 64;
+	}
+	sess->dirty[sess->num_dirty++] = net_i;
+	sess->nets[net_i-1].dirty = 1;
+	RC_RETURN(model);
+}
+
+int route_dirty_dev(struct route_session* sess, int y, int x,
+	enum fpgadev_type type, dev_type_idx_t type_idx)
+{
+	struct fpga_model* model = sess->r.model;
+	struct fpga_device* dev;
+	rrg_node_t node;
+	int i;
+
+	RC_CHECK(model);
+	dev = fdev_p(model, y, x, type, type_idx);
+	RC_ASSERT(model, dev);
+	for (i = 0; i < dev->num_pinw_total; i++) {
+		if (dev->pinw[i] == STRIDX_NO_ENTRY)
+			continue;
+		node = rrg_node_str(&sess->r.rrg, model, y, x, dev->pinw[i]);
+		if (node != RRG_NO_NODE && sess->node_net[node] != NO_NET)
+			route_dirty_net(sess, sess->node_net[node]);
+	}
+	RC_RETURN(model);
+}
+
+static int cmp_net(const void* a, const void* b)
+{
+	return *(const net_idx_t*) a - *(const net_idx_t*) b;
+}
+
+int route_dirty(struct route_session* sess, struct route_stats* stats)
+{
+	struct router* r = &sess->r;
+	struct fpga_model* model = r->model;
+	struct fpga_net* net;
+	net_idx_t net_i;
+	double start;
+	int i, j, rc;
+
+	start = now();
+	memset(&r->stats, 0, sizeof(r->stats));
+	for (i = 0; i < (r->num_threads ? r->num_threads : 1); i++) {
+		r->searches[i].net_routes = 0;
+		r->searches[i].nodes_expanded = 0;
+	}
+	if (stats)
+		memset(stats, 0, sizeof(*stats));
+	RC_CHECK(model);
+	// in net order, so that the result does not depend on the
+	// order of marking
+	qsort(sess->dirty, sess->num_dirty, sizeof(*sess->dirty), cmp_net);
+	r->nets = calloc(sess->num_dirty ? sess->num_dirty : 1,
+		sizeof(*r->nets));
+	if (!r->nets) { rc = ENOMEM; goto fail; }
+
+	// Rip up the nets fnet_route_all() would route, the others keep
+	// their switches. All pins
+	// are marked before routing so that no net runs through the
+	// new pins of another.
+	for (i = 0; i < sess->num_dirty; i++) {
+		net_i = sess->dirty[i];
+		if (net_i > model->highest_used_net) {
+			sess_release(sess, net_i);
+			continue;
+		}
+		if ((rc = load_net(r, &r->nets[r->num_nets], net_i,
+				/*with_sw*/ 1)))
+			goto fail;
+		net = &model->nets[net_i-1];
+		if (!r->nets[r->num_nets].num_sinks) {
+			// pick up changed ports
+			sess_release(sess, net_i);
+			if ((rc = sess_own_net(sess, net_i))) goto fail;
+			continue;
+		}
+		r->num_nets++;
+		sess_release(sess, net_i);
+		fnet_remove_all_sw(model, net_i);
+		if ((rc = model->rc)) goto fail;
+		for (j = 0; j < net->len; j++) {
+			if (pin_node(r, &net->el[j]) != RRG_NO_NODE)
+				r->node_flags[pin_node(r, &net->el[j])] |= RN_PIN;
+		}
+	}
+	r->stats.num_nets = r->num_nets;
+	if ((rc = negotiate(r))) goto fail;
+	if ((rc = write_back(r))) goto fail;
+
+	// the new routes are blocked for the next call
+	for (i = 0; i < r->num_nets; i++) {
+		rip_up(r, &r->nets[i]);
+		if ((rc = sess_own_net(sess, r->nets[i].net_i)))
+			goto fail;
+	}
+	for (i = 0; i < sess->num_dirty; i++)
+		sess->nets[sess->dirty[i]-1].dirty = 0;
+	sess->num_dirty = 0;
+	finish_stats(r, start, stats);
+	free_nets(r);
+	RC_RETURN(model);
+fail:
+	finish_stats(r, start, stats);
+	free_nets(r);
+	RC_FAIL(model, rc);
+}
+
+void route_print_stats(FILE* f, const struct route_stats* stats)
+{
+	fprintf(f, "routed %i nets with %i sinks in %.3fs, %i iterations, "
+		"%i net routes, %li nodes expanded, %i switches",
+		stats->num_nets, stats->num_sinks, stats->seconds,
+		stats->iterations, stats->net_routes, stats->nodes_expanded,
+		stats->num_switches);
+	if (stats->num_threads)
+		fprintf(f, ", %i threads, %i waves, %i requeued",
+			stats->num_threads, stats->waves, stats->requeued);
+	if (stats->num_overused)
+		fprintf(f, ", %i nodes overused", stats->num_overused);
+	fprintf(f, "\n");
+}
@@ -0,0 +1,82 @@
+//
+// Author: Wolfgang Spraul
+//
+// This is free and unencumbered software released into the public domain.
+// For details see the UNLICENSE file at the root of the source tree.
+//
+
+//
+// fnet_route_all() routes every net of the model that has one out pin,
+// at least one in pin and no switches yet. It searches the routing
+// graph (rr_graph.h) with A* and negotiates congestion the PathFinder
+// way: nets may share nodes at first, shared nodes get more expensive
+// with every iteration and nets through them are ripped up and routed
+// again until no node is used twice. Nodes of switches that are on
+// before the call and device pins of other nets are never used.
+//
+// Only a complete routing is written back, through fnet_add_sw(). If
+// a net cannot be routed, or nodes are still shared after
+// ROUTE_MAX_ITERATIONS, the model fails with ENOSPC.
+//
+
+#define ROUTE_MAX_ITERATIONS	50
+
+// fnet_set_route_threads(n) with n >= 1 makes fnet_route_all() route
+// nets with non-overlapping bounding boxes in parallel waves on n
+// threads. The routing is the same for any n, but differs from the
+// default 0, which routes one net after the other.
+#define ROUTE_MAX_THREADS	64
+void fnet_set_route_threads(int num_threads);
+
+// With fnet_set_route_lookahead(1), the default, the A* search
+// estimates the remaining cost with the lookahead tables of the die
+// (lookahead.h) where they promise more than the tile distance. Dies
+// without static or cached tables use the tile distance, unless
+// la_get() built their tables before.
+void fnet_set_route_lookahead(int on);
+
+struct route_stats
+{
+	int num_nets, num_sinks;
+	int iterations;
+	// nets routed over all iterations, including rip-ups
+	int net_routes;
+	long nodes_expanded;
+	int num_overused; // nodes still shared after the last iteration
+	int num_switches; // switches written back
+	int num_threads;
+	// waves routed and nets put back into the queue because they
+	// shared a node with an earlier net of their wave
+	int waves, requeued;
+	double seconds;
+};
+
+// stats can be 0
+int fnet_route_all(struct fpga_model* model, struct route_stats* stats);
+void route_print_stats(FILE* f, const struct route_stats* stats);
+
+//
+// A route session keeps the routing graph and which net uses which
+// node between calls, so that after a small change only the nets
+// touching it need to be routed again. route_open() takes the nets
+// and switches of the model as they are. route_dirty_dev() marks all
+// nets with a pin on a device, route_dirty_net() a single net, e.g.
+// a new one. route_dirty() then removes the switches of the marked
+// nets and routes them again, around the nodes of all other nets.
+// Marked nets that fnet_route_all() would not route keep their
+// switches.
+//
+// Work is in proportion to the marked nets, except for route_open().
+// Switches must not be changed outside of the session while it is
+// open, devices and the ports of nets can.
+//
+
+struct route_session;
+
+int route_open(struct route_session** sess, struct fpga_model* model);
+void route_close(struct route_session* sess);
+int route_dirty_dev(struct route_session* sess, int y, int x,
+	enum fpgadev_type type, dev_type_idx_t type_idx);
+int route_dirty_net(struct route_session* sess, net_idx_t net_i);
+// stats can be 0
+int route_dirty(struct route_session* sess, struct route_stats* stats);
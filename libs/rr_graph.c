@@ -0,0 +1,313 @@
+//
+// Author: Wolfgang Spraul
+//
+// This is free and unencumbered software released into the public domain.
+// For details see the UNLICENSE file at the root of the source tree.
+//
+
+#include "model.h"
+#include "control.h"
+#include "rr_graph.h"
+
+// Union-find over global connpt ids. The root is always the lowest
+// id of its set, so parent[i] <= i and a single ascending pass can
+// compress all paths.
+static uint32_t uf_find(uint32_t* parent, uint32_t i)
+{
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+static void uf_union(uint32_t* parent, uint32_t a, uint32_t b)
+{
+	a = uf_find(parent, a);
+	b = uf_find(parent, b);
+	if (a < b)
+		parent[b] = a;
+	else if (b < a)
+		parent[a] = b;
+}
+
+// Joins every connpt with the connpts its conns lead to.
+static int join_conns(struct rr_graph* rrg, struct fpga_model* model)
+{
+	struct fpga_tile* tile, *dest_tile;
+	int i, connpt_o, dest_o, dests_end, dest_connpt_o;
+	uint16_t* dest;
+
+	RC_CHECK(model);
+	for (i = 0; i < rrg->num_tiles; i++) {
+		tile = &model->tiles[i];
+		for (connpt_o = 0; connpt_o < tile->num_conn_point_names; connpt_o++) {
+			dests_end = (connpt_o < tile->num_conn_point_names-1)
+				? tile->conn_point_names[(connpt_o+1)*2]
+				: tile->num_conn_point_dests;
+			for (dest_o = tile->conn_point_names[connpt_o*2];
+			     dest_o < dests_end; dest_o++) {
+				dest = &tile->conn_point_dests[dest_o*3];
+				dest_tile = YX_TILE(model, dest[1], dest[0]);
+				dest_connpt_o = connpt_lookup(dest_tile, dest[2]);
+				if (dest_connpt_o == NO_CONN) {
+					fprintf(stderr, "#E %s:%i y%i x%i conn to "
+						"y%i x%i %s without connpt\n",
+						__FILE__, __LINE__, i / rrg->x_width,
+						i % rrg->x_width, dest[1], dest[0],
+						strarray_lookup(&model->str, dest[2]));
+					continue;
+				}
+				uf_union(rrg->connpt_node,
+					rrg->connpt_base[i] + connpt_o,
+					rrg->connpt_base[dest[1]*rrg->x_width + dest[0]]
+					  + dest_connpt_o);
+			}
+		}
+	}
+	RC_RETURN(model);
+}
+
+// Turns the union-find parents in connpt_node into node ids, numbered
+// in the order of the first connpt of each node.
+static int number_nodes(struct rr_graph* rrg, struct fpga_model* model)
+{
+	uint32_t* parent = rrg->connpt_node;
+	void* new_ptr;
+	int i;
+
+	RC_CHECK(model);
+	for (i = 0; i < rrg->num_connpts; i++)
+		parent[i] = parent[parent[i]];
+	rrg->node_connpt = malloc(rrg->num_connpts * sizeof(*rrg->node_connpt));
+	if (!rrg->node_connpt) RC_FAIL(model, ENOMEM);
+	rrg->num_nodes = 0;
+	for (i = 0; i < rrg->num_connpts; i++) {
+		// parents are below i and already numbered
+		if (parent[i] == i) {
+			rrg->node_connpt[rrg->num_nodes] = i;
+			rrg->connpt_node[i] = rrg->num_nodes++;
+		} else
+			rrg->connpt_node[i] = rrg->connpt_node[parent[i]];
+	}
+	new_ptr = realloc(rrg->node_connpt,
+		rrg->num_nodes * sizeof(*rrg->node_connpt));
+	if (new_ptr || !rrg->num_nodes)
+		rrg->node_connpt = new_ptr;
+	RC_RETURN(model);
+}
+
+// Adds an edge per switch, and a reverse one for bidirectional
+// switches. The first pass counts the edges of each node into
+// edge_start, the second fills them in.
+static int add_edges(struct rr_graph* rrg, struct fpga_model* model)
+{
+	struct fpga_tile* tile;
+	rrg_node_t from, to;
+	uint32_t sw_i;
+	int pass, i, j;
+
+	RC_CHECK(model);
+	rrg->edge_start = calloc(rrg->num_nodes+1, sizeof(*rrg->edge_start));
+	if (!rrg->edge_start) RC_FAIL(model, ENOMEM);
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < rrg->num_tiles; i++) {
+			tile = &model->tiles[i];
+			for (j = 0; j < tile->num_switches; j++) {
+				from = rrg->connpt_node[rrg->connpt_base[i]
+					+ SW_FROM_I(tile->switches[j])];
+				to = rrg->connpt_node[rrg->connpt_base[i]
+					+ SW_TO_I(tile->switches[j])];
+				if (!pass) {
+					rrg->edge_start[from+1]++;
+					if (tile->switches[j] & SWITCH_BIDIRECTIONAL)
+						rrg->edge_start[to+1]++;
+					continue;
+				}
+				sw_i = rrg->sw_base[i] + j;
+				rrg->edge_to[rrg->edge_start[from]] = to;
+				rrg->edge_sw[rrg->edge_start[from]++] = sw_i;
+				if (tile->switches[j] & SWITCH_BIDIRECTIONAL) {
+					rrg->edge_to[rrg->edge_start[to]] = from;
+					rrg->edge_sw[rrg->edge_start[to]++] = sw_i;
+				}
+			}
+		}
+		if (!pass) {
+			for (i = 0; i < rrg->num_nodes; i++)
+				rrg->edge_start[i+1] += rrg->edge_start[i];
+			rrg->num_edges = rrg->edge_start[rrg->num_nodes];
+			rrg->edge_to = malloc(rrg->num_edges * sizeof(*rrg->edge_to));
+			rrg->edge_sw = malloc(rrg->num_edges * sizeof(*rrg->edge_sw));
+			if (!rrg->edge_to || !rrg->edge_sw)
+				RC_FAIL(model, ENOMEM);
+		}
+	}
+	// filling moved each start to the start of the next node
+	for (i = rrg->num_nodes; i > 0; i--)
+		rrg->edge_start[i] = rrg->edge_start[i-1];
+	rrg->edge_start[0] = 0;
+	RC_RETURN(model);
+}
+
+int rrg_build(struct rr_graph* rrg, struct fpga_model* model)
+{
+	int i;
+
+	memset(rrg, 0, sizeof(*rrg));
+	RC_CHECK(model);
+	MATERIALIZE_ALL(model);
+	RC_CHECK(model);
+	rrg->x_width = model->x_width;
+	rrg->num_tiles = model->x_width * model->y_height;
+	rrg->connpt_base = malloc((rrg->num_tiles+1) * sizeof(*rrg->connpt_base));
+	rrg->sw_base = malloc((rrg->num_tiles+1) * sizeof(*rrg->sw_base));
+	if (!rrg->connpt_base || !rrg->sw_base) goto fail_nomem;
+	rrg->connpt_base[0] = 0;
+	rrg->sw_base[0] = 0;
+	for (i = 0; i < rrg->num_tiles; i++) {
+		rrg->connpt_base[i+1] = rrg->connpt_base[i]
+			+ model->tiles[i].num_conn_point_names;
+		rrg->sw_base[i+1] = rrg->sw_base[i]
+			+ model->tiles[i].num_switches;
+	}
+	rrg->num_connpts = rrg->connpt_base[rrg->num_tiles];
+
+	// connpt_node holds the union-find parents until number_nodes()
+	rrg->connpt_node = malloc(rrg->num_connpts * sizeof(*rrg->connpt_node));
+	if (!rrg->connpt_node) goto fail_nomem;
+	for (i = 0; i < rrg->num_connpts; i++)
+		rrg->connpt_node[i] = i;
+	join_conns(rrg, model);
+	number_nodes(rrg, model);
+	add_edges(rrg, model);
+	if (model->rc)
+		rrg_free(rrg);
+	RC_RETURN(model);
+fail_nomem:
+	rrg_free(rrg);
+	RC_FAIL(model, ENOMEM);
+}
+
+void rrg_free(struct rr_graph* rrg)
+{
+	free(rrg->connpt_base);
+	free(rrg->sw_base);
+	free(rrg->connpt_node);
+	free(rrg->node_connpt);
+	free(rrg->edge_start);
+	free(rrg->edge_to);
+	free(rrg->edge_sw);
+	memset(rrg, 0, sizeof(*rrg));
+}
+
+rrg_node_t rrg_node(const struct rr_graph* rrg, int y, int x, int connpt_o)
+{
+	int tile_i = y*rrg->x_width + x;
+
+	if (tile_i < 0 || tile_i >= rrg->num_tiles || connpt_o < 0
+	    || rrg->connpt_base[tile_i] + connpt_o >= rrg->connpt_base[tile_i+1])
+		return RRG_NO_NODE;
+	return rrg->connpt_node[rrg->connpt_base[tile_i] + connpt_o];
+}
+
+rrg_node_t rrg_node_str(const struct rr_graph* rrg, struct fpga_model* model,
+	int y, int x, str16_t name_i)
+{
+	int connpt_o;
+
+	connpt_o = connpt_lookup(YX_TILE(model, y, x), name_i);
+	if (connpt_o == NO_CONN)
+		return RRG_NO_NODE;
+	return rrg_node(rrg, y, x, connpt_o);
+}
+
+// Returns the tile whose range in base (num_tiles+1 entries)
+// contains the global id.
+static int find_tile(const uint32_t* base, int num_tiles, uint32_t id)
+{
+	int lo, hi, mid;
+
+	// last tile with base[tile] <= id, skipping empty tiles
+	lo = 0;
+	hi = num_tiles;
+	while (hi - lo > 1) {
+		mid = (lo+hi)/2;
+		if (base[mid] <= id)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+void rrg_node_yx(const struct rr_graph* rrg, rrg_node_t node,
+	int* y, int* x, int* connpt_o)
+{
+	uint32_t connpt;
+	int tile_i;
+
+	if (node >= rrg->num_nodes) {
+		HERE();
+		*y = *x = *connpt_o = -1;
+		return;
+	}
+	connpt = rrg->node_connpt[node];
+	tile_i = find_tile(rrg->connpt_base, rrg->num_tiles, connpt);
+	*y = tile_i / rrg->x_width;
+	*x = tile_i % rrg->x_width;
+	*connpt_o = connpt - rrg->connpt_base[tile_i];
+}
+
+void rrg_edge_sw(const struct rr_graph* rrg, rrg_edge_t edge,
+	int* y, int* x, swidx_t* sw)
+{
+	int tile_i;
+
+	if (edge >= rrg->num_edges) {
+		HERE();
+		*y = *x = -1;
+		*sw = NO_SWITCH;
+		return;
+	}
+	tile_i = find_tile(rrg->sw_base, rrg->num_tiles, rrg->edge_sw[edge]);
+	*y = tile_i / rrg->x_width;
+	*x = tile_i % rrg->x_width;
+	*sw = rrg->edge_sw[edge] - rrg->sw_base[tile_i];
+}
+
+rrg_edge_t rrg_sw_edge(const struct rr_graph* rrg, struct fpga_model* model,
+	int y, int x, swidx_t sw)
+{
+	rrg_node_t from;
+	uint32_t sw_i;
+	int tile_i;
+	rrg_edge_t i;
+
+	tile_i = y*rrg->x_width + x;
+	if (tile_i < 0 || tile_i >= rrg->num_tiles
+	    || sw < 0 || rrg->sw_base[tile_i] + sw >= rrg->sw_base[tile_i+1])
+		return RRG_NO_EDGE;
+	sw_i = rrg->sw_base[tile_i] + sw;
+	from = rrg_node(rrg, y, x, SW_FROM_I(model->tiles[tile_i].switches[sw]));
+	// the forward edge comes before a reverse one on the same node
+	for (i = rrg->edge_start[from]; i < rrg->edge_start[from+1]; i++) {
+		if (rrg->edge_sw[i] == sw_i)
+			return i;
+	}
+	return RRG_NO_EDGE;
+}
+
+void rrg_print_stats(FILE* f, const struct rr_graph* rrg)
+{
+	size_t mem;
+
+	mem = 2 * (rrg->num_tiles+1) * sizeof(uint32_t)
+		+ rrg->num_connpts * sizeof(*rrg->connpt_node)
+		+ rrg->num_nodes * sizeof(*rrg->node_connpt)
+		+ (rrg->num_nodes+1) * sizeof(*rrg->edge_start)
+		+ rrg->num_edges * (sizeof(*rrg->edge_to) + sizeof(*rrg->edge_sw));
+	fprintf(f, "routing graph: %i connpts in %i nodes, %i edges, %.1f MB\n",
+		rrg->num_connpts, rrg->num_nodes, rrg->num_edges,
+		mem / (1024.0*1024.0));
+}
@@ -0,0 +1,69 @@
+//
+// Author: Wolfgang Spraul
+//
+// This is free and unencumbered software released into the public domain.
+// For details see the UNLICENSE file at the root of the source tree.
+//
+
+//
+// The routing-resource graph is a flat view of the model for routers.
+// Every connpt of every tile belongs to exactly one node, connpts
+// joined by conns (conn_point_dests) collapse into the same node, so
+// a node is one electrically distinct wire. Every switch is an edge
+// from the node of its from connpt to the node of its to connpt,
+// bidirectional switches get an edge in each direction.
+//
+// Connpts and switches are numbered globally in tile order, tile
+// y*x_width+x starts at connpt_base[tile] and sw_base[tile]. The
+// outgoing edges of node n are edge_start[n] to edge_start[n+1]-1,
+// in tile and switch order.
+//
+// The graph is derived from the model when rrg_build() runs and does
+// not follow later changes to the switches or conns. Switching on or
+// off does not change it.
+//
+
+typedef uint32_t rrg_node_t;
+typedef uint32_t rrg_edge_t;
+#define RRG_NO_NODE	0xFFFFFFFF
+#define RRG_NO_EDGE	0xFFFFFFFF
+
+struct rr_graph
+{
+	int x_width, num_tiles;
+	// num_tiles+1 entries each
+	uint32_t* connpt_base;
+	uint32_t* sw_base;
+
+	int num_connpts;
+	rrg_node_t* connpt_node; // num_connpts
+
+	int num_nodes;
+	uint32_t* node_connpt; // num_nodes, first global connpt
+	uint32_t* edge_start; // num_nodes+1
+
+	int num_edges;
+	rrg_node_t* edge_to; // num_edges
+	uint32_t* edge_sw; // num_edges, global switch
+};
+
+// rrg_build() materializes a lazy model first.
+int rrg_build(struct rr_graph* rrg, struct fpga_model* model);
+void rrg_free(struct rr_graph* rrg);
+
+// rrg_node() returns RRG_NO_NODE if the tile has no such connpt.
+rrg_node_t rrg_node(const struct rr_graph* rrg, int y, int x, int connpt_o);
+rrg_node_t rrg_node_str(const struct rr_graph* rrg, struct fpga_model* model,
+	int y, int x, str16_t name_i);
+// rrg_node_yx() returns the first connpt of the node in tile order.
+void rrg_node_yx(const struct rr_graph* rrg, rrg_node_t node,
+	int* y, int* x, int* connpt_o);
+
+// rrg_edge_sw() returns the switch behind an edge, rrg_sw_edge() the
+// edge of a switch in its from-to direction, or RRG_NO_EDGE.
+void rrg_edge_sw(const struct rr_graph* rrg, rrg_edge_t edge,
+	int* y, int* x, swidx_t* sw);
+rrg_edge_t rrg_sw_edge(const struct rr_graph* rrg, struct fpga_model* model,
+	int y, int x, swidx_t sw);
+
+void rrg_print_stats(FILE* f, const struct rr_graph* rrg);
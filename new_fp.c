@@ -11,15 +11,18 @@
 int main(int argc, char** argv)
 {
 	struct fpga_model model;
-	int no_conns, rc;
+	int no_conns, i, rc;
 
+	no_conns = 0;
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--no-conns"))
+			no_conns = 1;
+	}
+	fpga_set_build_threads(cmdline_build_threads(argc, argv));
+	fpga_set_lazy_build(cmdline_lazy_build(argc, argv));
 	if ((rc = fpga_build_model(&model, XC6SLX9, TQG144)))
 		goto fail;
 
-	no_conns = 0;
-	if (argc > 1 && !strcmp(argv[1], "--no-conns"))
-		no_conns = 1;
-
 	printf_version(stdout);
 
 	rc = printf_tiles(stdout, &model);
@@ -44,7 +44,8 @@ static int add_entry(uint32_t** net, uint32_t new_idx)
 	return 0;
 }
 
-static int print_nets(uint32_t** nets, struct hashed_strarray* connpt_names)
+static int print_nets(uint32_t** nets, int num_nets_alloc,
+	struct hashed_strarray* connpt_names)
 {
 	int i, j, num_connpoints, num_nets, largest_net, total_net_connpoints;
 	const char* str;
@@ -54,7 +55,7 @@ static int print_nets(uint32_t** nets, struct hashed_strarray* connpt_names)
 	largest_net = 0;
 	total_net_connpoints = 0;
 
-	for (i = 0; i < STRIDX_1M; i++) {
+	for (i = 0; i < num_nets_alloc; i++) {
 		if (nets[i]) {
 			num_connpoints++;
 			if (!((uint64_t)nets[i] & 1)) {
@@ -81,6 +82,9 @@ static int print_nets(uint32_t** nets, struct hashed_strarray* connpt_names)
 }
 
 struct hashed_strarray* g_sort_connpt_names;
+// indices below g_num_sorted were loaded from a sorted names
+// file and compare like their strings
+uint32_t g_num_sorted;
 
 static int sort_net(const void* a, const void* b)
 {
@@ -89,6 +93,8 @@ static int sort_net(const void* a, const void* b)
 
 	_a = a;
 	_b = b;
+	if (*_a < g_num_sorted && *_b < g_num_sorted)
+		return (*_a > *_b) - (*_a < *_b);
 	a_str = strarray_lookup(g_sort_connpt_names, *_a);
 	b_str = strarray_lookup(g_sort_connpt_names, *_b);
 	if (!a_str || !b_str) {
@@ -99,12 +105,13 @@ static int sort_net(const void* a, const void* b)
 	return strcmp(a_str, b_str);
 }
 
-static int sort_nets(uint32_t** nets, struct hashed_strarray* connpt_names)
+static int sort_nets(uint32_t** nets, int num_nets_alloc,
+	struct hashed_strarray* connpt_names)
 {
 	int i;
 
 	g_sort_connpt_names = connpt_names;
-	for (i = 0; i < STRIDX_1M; i++) {
+	for (i = 0; i < num_nets_alloc; i++) {
 		if (nets[i] && !((uint64_t)nets[i] & 1)) {
 			qsort(&nets[i][1], *nets[i]-1, sizeof(nets[i][1]), sort_net);
 		}
@@ -112,32 +119,91 @@ static int sort_nets(uint32_t** nets, struct hashed_strarray* connpt_names)
 	return 0;
 }
 
+// Loads the names file into connpt_names and sets g_num_sorted
+// if the file was sorted.
+static int load_names(const char* path, struct hashed_strarray* connpt_names)
+{
+	const char* prev, *str;
+	FILE* fp;
+	int i, rc;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		fprintf(stderr, "Error opening %s.\n", path);
+		return -1;
+	}
+	rc = strarray_load_lines(connpt_names, fp);
+	fclose(fp);
+	if (rc) {
+		fprintf(stderr, "Out of memory in %s:%i\n", __FILE__, __LINE__);
+		return -1;
+	}
+	// next_index is 0-based, string indices are 1-based
+	prev = 0;
+	for (i = 1; i <= connpt_names->next_index; i++) {
+		str = strarray_lookup(connpt_names, i);
+		if (!str) continue;
+		if (prev && strcmp(prev, str) >= 0) {
+			fprintf(stderr, "%s is not sorted, ignored.\n", path);
+			return 0;
+		}
+		prev = str;
+	}
+	g_num_sorted = connpt_names->next_index+1;
+	return 0;
+}
+
+// Grows nets to cover all indices of connpt_names. The
+// indices are 1-based, so highest_index is a valid one.
+static int grow_nets(uint32_t*** nets, int* num_nets_alloc,
+	struct hashed_strarray* connpt_names)
+{
+	void* new_ptr;
+	int new_num;
+
+	new_num = connpt_names->highest_index+1;
+	if (new_num <= *num_nets_alloc)
+		return 0;
+	new_ptr = realloc(*nets, new_num*sizeof(**nets));
+	if (!new_ptr) {
+		fprintf(stderr, "Out of memory in %s:%i\n", __FILE__, __LINE__);
+		return -1;
+	}
+	*nets = new_ptr;
+	memset(&(*nets)[*num_nets_alloc], 0,
+		(new_num - *num_nets_alloc)*sizeof(**nets));
+	*num_nets_alloc = new_num;
+	return 0;
+}
+
 int main(int argc, char** argv)
 {
 	char line[1024], point_a[1024], point_b[1024];
 	struct hashed_strarray connpt_names;
 	FILE* fp = 0;
 	int i, rc, point_a_idx, point_b_idx, existing_net_idx, new_net_idx;
-	int net_data_idx;
+	int net_data_idx, num_nets_alloc;
 	uint32_t** nets;
 
 	if (argc < 2) {
 		fprintf(stderr,
 			"\n"
 			"pair2net - finds all pairs connected to the same net\n"
-			"Usage: %s <data_file> | '-' for stdin\n", argv[0]);
+			"Usage: %s <data_file> | '-' for stdin [names_file]\n"
+			"  names_file optionally lists all names sorted (LC_ALL=C sort -u),\n"
+			"  which makes sorting the nets faster.\n", argv[0]);
 		goto xout;
 	}
-	if (strarray_init(&connpt_names, STRIDX_1M)) {
+	if (strarray_init(&connpt_names, STRIDX_GROW)) {
 		fprintf(stderr, "Out of memory in %s:%i\n", __FILE__, __LINE__);
 		goto xout;
 	}
-
-	nets = calloc(STRIDX_1M, sizeof(*nets));
-	if (!nets) {
-		fprintf(stderr, "Out of memory in %s:%i\n", __FILE__, __LINE__);
+	if (argc > 2 && load_names(argv[2], &connpt_names))
+		goto xout;
+	nets = 0;
+	num_nets_alloc = 0;
+	if (grow_nets(&nets, &num_nets_alloc, &connpt_names))
 		goto xout;
-	}
 	if (!strcmp(argv[1], "-"))
 		fp = stdin;
 	else {
@@ -166,6 +232,8 @@ int main(int argc, char** argv)
 				__FILE__, __LINE__);
 			goto xout;
 		}
+		if (grow_nets(&nets, &num_nets_alloc, &connpt_names))
+			goto xout;
 		if (nets[point_a_idx] && nets[point_b_idx]) {
 			continue;}
 		if (nets[point_a_idx] || nets[point_b_idx]) {
@@ -193,9 +261,9 @@ int main(int argc, char** argv)
 			nets[point_b_idx] = (uint32_t*) (((uint64_t) point_a_idx << 32) | 1);
 		}
 	}
-	rc = sort_nets(nets, &connpt_names);
+	rc = sort_nets(nets, num_nets_alloc, &connpt_names);
 	if (rc) goto xout;
-	rc = print_nets(nets, &connpt_names);
+	rc = print_nets(nets, num_nets_alloc, &connpt_names);
 	if (rc) goto xout;
 	fclose(fp);
 	return EXIT_SUCCESS;
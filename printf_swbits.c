@@ -17,11 +17,14 @@ int main(int argc, char** argv)
 		if (!strcmp(argv[i], "--help")) {
 			printf( "\n%s\n\n"
 				"Usage: %s [--part=xc6slx9]\n"
+				"       %*s [--build-threads=<num>]\n"
 				"       %*s [--help]\n\n",
-				*argv, *argv, (int) strlen(*argv), "");
+				*argv, *argv, (int) strlen(*argv), "",
+				(int) strlen(*argv), "");
 			return 1;
 		}
 	}
+	fpga_set_build_threads(cmdline_build_threads(argc, argv));
 	fpga_build_model(&model, cmdline_part(argc, argv),
 		cmdline_package(argc, argv));
 	printf_swbits(&model);
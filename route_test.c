@@ -0,0 +1,337 @@
+//
+// Author: Wolfgang Spraul
+//
+// This is free and unencumbered software released into the public domain.
+// For details see the UNLICENSE file at the root of the source tree.
+//
+
+#include <unistd.h>
+#include "model.h"
+#include "floorplan.h"
+#include "control.h"
+#include "router.h"
+
+#define NUM_NETS	500
+#define NUM_CLONES	20
+#define LONG_NET_LEN	300
+
+static void check_failed(int line, const char* what)
+{
+	fprintf(stderr, "#E %s:%i %s\n", __FILE__, line, what);
+	exit(1);
+}
+
+// Adds num_nets random nets between logic devices, each from an
+// out pin to 1-4 in pins of devices up to 8 tiles away. No pin is
+// used twice.
+static void gen_design(struct fpga_model* model, int num_nets)
+{
+	struct fpga_tile* tile;
+	struct { int y, x, type_idx; uint32_t used_in; } *devs;
+	int num_devs, y, x, i, j, src, dst, num_sinks, pin, tries;
+	unsigned int seed;
+	net_idx_t net;
+
+	devs = malloc(model->x_width * model->y_height * 2 * sizeof(*devs));
+	if (!devs)
+		check_failed(__LINE__, "out of memory");
+	num_devs = 0;
+	for (y = 0; y < model->y_height; y++) {
+		for (x = 0; x < model->x_width; x++) {
+			tile = YX_TILE(model, y, x);
+			for (i = 0; i < tile->num_devs; i++) {
+				if (tile->devs[i].type != DEV_LOGIC)
+					continue;
+				devs[num_devs].y = y;
+				devs[num_devs].x = x;
+				devs[num_devs].type_idx = fdev_typeidx(model, y, x, i);
+				devs[num_devs].used_in = 0;
+				num_devs++;
+			}
+		}
+	}
+	// each device drives LO_A to LO_D once
+	if (num_nets > num_devs*4)
+		num_nets = num_devs*4;
+	seed = 1;
+	for (i = 0; i < num_nets; i++) {
+		src = (i * 7919) % num_devs;
+		fnet_new(model, &net);
+		fnet_add_port(model, net, devs[src].y, devs[src].x, DEV_LOGIC,
+			devs[src].type_idx, LO_A + (i * 7919 / num_devs) % 4);
+		num_sinks = 1 + (seed = seed*1103515245 + 12345) / 65536 % 4;
+		for (j = 0, tries = 0; j < num_sinks && tries < 1000; tries++) {
+			dst = (seed = seed*1103515245 + 12345) / 65536 % num_devs;
+			if (dst == src
+			    || abs(devs[dst].y - devs[src].y) > 8
+			    || abs(devs[dst].x - devs[src].x) > 8)
+				continue;
+			pin = (seed = seed*1103515245 + 12345) / 65536 % 24;
+			if (devs[dst].used_in & (1 << pin))
+				continue;
+			devs[dst].used_in |= 1 << pin;
+			fnet_add_port(model, net, devs[dst].y, devs[dst].x,
+				DEV_LOGIC, devs[dst].type_idx, LI_A1 + pin);
+			j++;
+		}
+	}
+	free(devs);
+}
+
+// Finds a switch outside of any net that drives the same wire as a
+// switch of net_i, other than a logic in pin. Returns -1 if there
+// is none.
+static int find_blocker(struct fpga_model* model, net_idx_t net_i,
+	int* y, int* x, swidx_t* sw)
+{
+	struct fpga_net* net;
+	struct fpga_tile* tile;
+	const char* to;
+	int i, j, to_i;
+
+	net = fnet_get(model, net_i);
+	for (i = 0; i < net->len; i++) {
+		if (net->el[i].idx & NET_IDX_IS_PINW)
+			continue;
+		tile = YX_TILE(model, net->el[i].y, net->el[i].x);
+		to_i = SW_TO_I(tile->switches[net->el[i].idx]);
+		to = strarray_lookup(&model->str,
+			tile->conn_point_names[to_i*2+1]);
+		if (!strncmp(to, "LOGICIN", 7))
+			continue;
+		for (j = 0; j < tile->num_switches; j++) {
+			if (j == net->el[i].idx
+			    || SW_TO_I(tile->switches[j]) != to_i
+			    || tile->switches[j] & SWITCH_USED)
+				continue;
+			*y = net->el[i].y;
+			*x = net->el[i].x;
+			*sw = j;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+// Routes the design with num_threads and prints its nets.
+static void route_threads(struct fpga_model* model, int num_threads)
+{
+	gen_design(model, NUM_NETS);
+	fnet_set_route_threads(num_threads);
+	if (fnet_route_all(model, /*stats*/ 0))
+		check_failed(__LINE__, "routing failed");
+	printf_nets(stdout, model);
+}
+
+// Routes a design, then routes the nets of one device at a time
+// again in a route session. Then a switch outside of any net blocks
+// a wire of some nets, which must not use it after rerouting.
+static void check_session(struct fpga_model* model)
+{
+	struct route_session* sess;
+	struct route_stats stats;
+	struct fpga_net* net;
+	struct fpga_tile* tile;
+	int i, j, y, x, num_blocked;
+	swidx_t sw;
+
+	gen_design(model, NUM_NETS);
+	if (fnet_route_all(model, &stats))
+		check_failed(__LINE__, "routing failed");
+	if (route_open(&sess, model))
+		check_failed(__LINE__, "route_open() failed");
+	for (i = 0; i < model->highest_used_net; i += 20) {
+		// the device of the first in pin
+		net = &model->nets[i];
+		if (net->len < 2 || !(net->el[1].idx & NET_IDX_IS_PINW))
+			continue;
+		route_dirty_dev(sess, net->el[1].y, net->el[1].x, DEV_LOGIC,
+			fdev_typeidx(model, net->el[1].y, net->el[1].x,
+			net->el[1].dev_idx));
+		if (route_dirty(sess, &stats))
+			check_failed(__LINE__, "rerouting failed");
+	}
+	route_close(sess);
+
+	num_blocked = 0;
+	for (i = 1; i <= model->highest_used_net && num_blocked < 20; i += 7) {
+		if (find_blocker(model, i, &y, &x, &sw))
+			continue;
+		fpga_switch_enable(model, y, x, sw);
+		if (route_open(&sess, model))
+			check_failed(__LINE__, "route_open() failed");
+		route_dirty_net(sess, i);
+		// the net may not find another way
+		if (route_dirty(sess, &stats))
+			model->rc = 0;
+		route_close(sess);
+		tile = YX_TILE(model, y, x);
+		net = fnet_get(model, i);
+		for (j = 0; j < net->len; j++) {
+			if (!(net->el[j].idx & NET_IDX_IS_PINW)
+			    && net->el[j].y == y && net->el[j].x == x
+			    && SW_TO_I(tile->switches[net->el[j].idx])
+				== SW_TO_I(tile->switches[sw]))
+				check_failed(__LINE__, "net uses a blocked wire");
+		}
+		fpga_switch_disable(model, y, x, sw);
+		num_blocked++;
+	}
+	if (!num_blocked)
+		check_failed(__LINE__, "no net to block");
+	if (model->rc)
+		check_failed(__LINE__, "model error");
+}
+
+// Returns the resident set size in kb.
+static long rss_kb(void)
+{
+	FILE* f;
+	long size, resident;
+
+	f = fopen("/proc/self/statm", "r");
+	if (!f) return 0;
+	if (fscanf(f, "%li %li", &size, &resident) != 2)
+		resident = 0;
+	fclose(f);
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Clones the model NUM_CLONES times, enables a switch in every tile
+// of the clone, so that it copies all switch arrays, and frees it
+// again. The memory must stay flat.
+static void check_clones(struct fpga_model* model)
+{
+	struct fpga_model clone;
+	long rss_first;
+	int i, j;
+
+	rss_first = 0;
+	for (i = 0; i < NUM_CLONES; i++) {
+		if (fpga_clone_model(&clone, model))
+			check_failed(__LINE__, "clone failed");
+		for (j = 0; j < clone.x_width * clone.y_height; j++) {
+			if (clone.tiles[j].num_switches
+			    && !fpga_switch_is_used(&clone, j / clone.x_width,
+					j % clone.x_width, 0))
+				fpga_switch_enable(&clone, j / clone.x_width,
+					j % clone.x_width, 0);
+		}
+		fpga_free_model(&clone);
+		// the first clones settle the heap
+		if (i == 1)
+			rss_first = rss_kb();
+	}
+	if (rss_kb() - rss_first > 4096)
+		check_failed(__LINE__, "clones leak");
+}
+
+// Checks a net with more switches than fit into the smallest pool
+// arrays, and the reuse of deleted net ids with rollbacks.
+static void check_nets(struct fpga_model* model)
+{
+	struct fpga_model clone;
+	struct net_el saved[LONG_NET_LEN];
+	swidx_t sw[LONG_NET_LEN];
+	net_idx_t long_net, mid_net, net;
+	int y, x, i, num_sw, sp;
+
+	// LONG_NET_LEN unused switches of the first tile that has them
+	y = x = num_sw = 0;
+	for (i = 0; i < model->x_width * model->y_height
+			&& num_sw < LONG_NET_LEN; i++) {
+		y = i / model->x_width;
+		x = i % model->x_width;
+		num_sw = 0;
+		for (sw[0] = 0; sw[0] < model->tiles[i].num_switches
+				&& num_sw < LONG_NET_LEN; sw[0]++) {
+			if (!fpga_switch_is_used(model, y, x, sw[0]))
+				sw[num_sw++] = sw[0];
+		}
+	}
+	if (num_sw < LONG_NET_LEN)
+		check_failed(__LINE__, "no tile for the long net");
+	if (fnet_new(model, &long_net)
+	    || fnet_add_sw(model, long_net, y, x, sw, num_sw)
+	    || fnet_get(model, long_net)->len != LONG_NET_LEN)
+		check_failed(__LINE__, "long net failed");
+	for (i = 0; i < LONG_NET_LEN; i++) {
+		if (fpga_switch_net(model, y, x, sw[i]) != long_net)
+			check_failed(__LINE__, "long net lost a switch");
+	}
+	memcpy(saved, fnet_get(model, long_net)->el, sizeof(saved));
+
+	// a clone copies the long net
+	if (fpga_clone_model(&clone, model)
+	    || fnet_get(&clone, long_net)->len != LONG_NET_LEN
+	    || memcmp(fnet_get(&clone, long_net)->el, saved, sizeof(saved)))
+		check_failed(__LINE__, "clone lost the long net");
+	fpga_free_model(&clone);
+
+	// rolling back a delete restores the net
+	fpga_journal_begin(model, &sp);
+	fnet_delete(model, long_net);
+	fpga_journal_rollback(model, sp);
+	if (fnet_get(model, long_net)->len != LONG_NET_LEN
+	    || memcmp(fnet_get(model, long_net)->el, saved, sizeof(saved))
+	    || fpga_switch_net(model, y, x, sw[0]) != long_net)
+		check_failed(__LINE__, "rollback of delete failed");
+
+	// a deleted id is reused, also after a rolled back reuse
+	if (fnet_new(model, &mid_net) || fnet_new(model, &net))
+		check_failed(__LINE__, "new net failed");
+	fnet_delete(model, mid_net);
+	fpga_journal_begin(model, &sp);
+	if (fnet_new(model, &net) || net != mid_net)
+		check_failed(__LINE__, "deleted net id not reused");
+	fpga_journal_rollback(model, sp);
+	if (fnet_new(model, &net) || net != mid_net)
+		check_failed(__LINE__, "net id lost by rollback");
+	if (model->rc)
+		check_failed(__LINE__, "model error");
+}
+
+static void printf_help(const char* argv_0)
+{
+	printf( "\n"
+		"Routes a generated design and prints its nets, or runs\n"
+		"a check that prints nothing if it passes.\n\n"
+		"Usage: %s [--route-threads=<num>]\n"
+		"       %*s [--check=session|clones|nets]\n"
+		"       %*s [--help]\n\n", argv_0, (int) strlen(argv_0), "",
+		(int) strlen(argv_0), "");
+}
+
+int main(int argc, char** argv)
+{
+	struct fpga_model model;
+	char check[64];
+	int num_threads, i;
+
+	num_threads = 0;
+	check[0] = 0;
+	for (i = 1; i < argc; i++) {
+		if (sscanf(argv[i], "--route-threads=%i", &num_threads) == 1)
+			continue;
+		if (sscanf(argv[i], "--check=%63s", check) == 1)
+			continue;
+		printf_help(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (fpga_build_model(&model, XC6SLX9, TQG144))
+		check_failed(__LINE__, "model build failed");
+	if (!check[0])
+		route_threads(&model, num_threads);
+	else if (!strcmp(check, "session"))
+		check_session(&model);
+	else if (!strcmp(check, "clones"))
+		check_clones(&model);
+	else if (!strcmp(check, "nets"))
+		check_nets(&model);
+	else {
+		printf_help(argv[0]);
+		return EXIT_FAILURE;
+	}
+	fpga_free_model(&model);
+	return EXIT_SUCCESS;
+}